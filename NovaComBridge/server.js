@@ -1,5 +1,5 @@
 const express = require('express');
-const { execFile } = require('child_process');
+const { spawn } = require('child_process');
 const path = require('path');
 const fs = require('fs');
 const cors = require('cors');
@@ -21,54 +21,178 @@ if (!fs.existsSync(DATA_DIR)) {
     fs.mkdirSync(DATA_DIR, { recursive: true });
 }
 
-app.post('/api', (req, res) => {
-    let { action, params } = req.body;
-    let tempFilePath = null;
+// RESIDENT BACKEND
+// backend.exe runs once in "serve" mode and keeps the graph loaded.
+// Requests are written to its stdin as length-prefixed frames and answered
+// in order, each response terminated by a "#END <exitCode>" line.
+// Mutations are followed by "#EVENT <topic>" lines, fanned out to the
+// browsers subscribed through /api/events.
+let backend = null;
+let pending = [];
+let outputBuffer = '';
 
-    console.log(`[Request] Action: ${action}`);
+function startBackend() {
+    const child = spawn(EXECUTABLE, ['serve'], { cwd: BACKEND_DIR });
+    backend = child;
+    pending = [];
+    outputBuffer = '';
+    let current = [];
 
-    // Image Buffering Logic
-    if ((action === 'send_dm' || action === 'send_message') && params && params.length >= 5) {
-        const mediaUrl = params[4];
-        if (mediaUrl && mediaUrl.length > 1000) {
-            const fileName = `temp_img_${Date.now()}.txt`;
-            tempFilePath = path.join(DATA_DIR, fileName);
-            try {
-                fs.writeFileSync(tempFilePath, mediaUrl);
-                params[4] = `FILE:${tempFilePath}`;
-            } catch (err) {
-                console.error("Failed to write temp file:", err);
-                return res.status(500).json({ error: "Failed to process image upload." });
+    // Fails every queued request and drops the process, so the next call
+    // starts a fresh backend instead of queueing on a dead one.
+    function stop(reason) {
+        if (backend !== child) return;
+        for (const job of pending) job.reject(new Error(reason));
+        backend = null;
+        pending = [];
+    }
+
+    child.stdout.setEncoding('utf8');
+    child.stdout.on('data', (chunk) => {
+        outputBuffer += chunk;
+        let newline;
+        while ((newline = outputBuffer.indexOf('\n')) !== -1) {
+            const line = outputBuffer.slice(0, newline).replace(/\r$/, '');
+            outputBuffer = outputBuffer.slice(newline + 1);
+            if (line === '#READY') continue;
+            if (line.startsWith('#EVENT ')) {
+                publish(line.slice(7));
+                continue;
+            }
+            if (line.startsWith('#END ')) {
+                const job = pending.shift();
+                if (job) job.resolve({ code: parseInt(line.slice(5), 10), stdout: current.join('\n') });
+                current = [];
+            } else {
+                current.push(line);
             }
         }
-    }
+    });
 
-    const args = [action, ...params.map(String)];
+    child.stdin.on('error', (err) => console.error("Backend stdin error:", err.message));
+    child.stderr.on('data', (chunk) => console.error(chunk.toString()));
 
-    execFile(EXECUTABLE, args, { cwd: BACKEND_DIR, maxBuffer: 1024 * 1024 * 50 }, (error, stdout, stderr) => {
-        // Cleanup temp file
-        if (tempFilePath && fs.existsSync(tempFilePath)) {
-            try { fs.unlinkSync(tempFilePath); } catch(e) {}
-        }
+    child.on('exit', (code) => {
+        console.error(`Backend exited with code ${code}`);
+        stop('Backend process exited');
+    });
 
-        if (error) {
-            console.error("C++ Execution Error:", stderr || error.message);
-            return res.status(500).json({ error: "Backend failed", details: stderr || error.message });
-        }
+    child.on('error', (err) => {
+        console.error("Failed to start backend:", err.message);
+        stop(`Failed to start backend: ${err.message}`);
+    });
+}
+
+function callDaemon(args) {
+    if (!backend) startBackend();
+    return new Promise((resolve, reject) => {
+        pending.push({ resolve, reject });
+        const parts = [`${args.length}\n`];
+        for (const arg of args) parts.push(`${Buffer.byteLength(arg, 'utf8')}\n${arg}\n`);
+        backend.stdin.write(parts.join(''));
+    });
+}
+
+// PUSH EVENTS (Server-Sent Events)
+// GET /api/events?topics=community:100,dm:29_36,inbox:29
+// Each event's data is the topic that changed; clients then pull the change
+// with sync_community / sync_dm / get_my_dms.
+const subscribers = new Map(); // topic -> Set of open responses
+
+function publish(topic) {
+    const listeners = subscribers.get(topic);
+    if (!listeners) return;
+    for (const res of listeners) res.write(`data: ${topic}\n\n`);
+}
+
+app.get('/api/events', (req, res) => {
+    const topics = String(req.query.topics || '').split(',').filter(Boolean);
+    res.set({ 'Content-Type': 'text/event-stream', 'Cache-Control': 'no-cache', 'Connection': 'keep-alive' });
+    res.flushHeaders();
+    res.write(': subscribed\n\n');
 
-        try {
-            if (!stdout.trim()) return res.json({ status: "success" });
-            const jsonResponse = JSON.parse(stdout.trim());
-            res.json(jsonResponse);
-        } catch (e) {
-            console.error("JSON Parse Error. Raw Output from C++:", stdout);
-            res.status(500).json({ error: "C++ returned invalid JSON", raw: stdout }); 
+    for (const topic of topics) {
+        if (!subscribers.has(topic)) subscribers.set(topic, new Set());
+        subscribers.get(topic).add(res);
+    }
+    res.on('close', () => {
+        for (const topic of topics) {
+            const listeners = subscribers.get(topic);
+            if (!listeners) continue;
+            listeners.delete(res);
+            if (listeners.size === 0) subscribers.delete(topic);
         }
     });
 });
 
+app.post('/api', async (req, res) => {
+    let { action, params } = req.body;
+
+    console.log(`[Request] Action: ${action}`);
+
+    const args = [action, ...(params || []).map(String)];
+
+    let result;
+    try {
+        result = await callDaemon(args);
+    } catch (err) {
+        console.error("C++ Execution Error:", err.message);
+        return res.status(500).json({ error: "Backend failed", details: err.message });
+    }
+
+    const stdout = result.stdout;
+    if (result.code !== 0) {
+        console.error("C++ Execution Error:", stdout);
+        return res.status(500).json({ error: "Backend failed", details: stdout });
+    }
+
+    try {
+        if (!stdout.trim()) return res.json({ status: "success" });
+        const jsonResponse = JSON.parse(stdout.trim());
+        res.json(jsonResponse);
+    } catch (e) {
+        console.error("JSON Parse Error. Raw Output from C++:", stdout);
+        res.status(500).json({ error: "C++ returned invalid JSON", raw: stdout });
+    }
+});
+
+// MEDIA BLOBS
+// Chat rows and profiles carry "blobref:<key>" instead of inline data: URIs.
+// Blobs are immutable (the key is a content hash), so browsers may cache them forever.
+// Only the image/audio types the app uploads are served as themselves; anything
+// else (text/html, image/svg+xml, ...) would run as a page on this origin.
+const MEDIA_TYPES = new Set([
+    'image/png', 'image/jpeg', 'image/gif', 'image/webp', 'image/bmp', 'image/avif',
+    'audio/webm', 'audio/ogg', 'audio/mpeg', 'audio/mp4', 'audio/wav',
+]);
+
+app.get('/api/blob/:key', async (req, res) => {
+    const key = req.params.key;
+    if (!/^[0-9a-f]{24}$/.test(key)) return res.status(400).json({ error: "Invalid blob key" });
+
+    // Read straight from data/blobs: a large media file must not sit in the
+    // daemon pipe ahead of queued chat and login requests.
+    let data;
+    try {
+        data = await fs.promises.readFile(path.join(DATA_DIR, 'blobs', key), 'utf8');
+    } catch (err) {
+        if (err.code === 'ENOENT') return res.status(404).json({ error: "Blob not found" });
+        return res.status(500).json({ error: "Blob read failed", details: err.message });
+    }
+
+    const match = /^data:([^;,]+)?(;base64)?,/.exec(data);
+    if (!match) return res.status(500).json({ error: "Unsupported blob encoding" });
+    const body = data.slice(match[0].length);
+    const type = (match[1] || '').toLowerCase();
+    res.set('Cache-Control', 'public, max-age=31536000, immutable');
+    res.set('X-Content-Type-Options', 'nosniff');
+    res.type(MEDIA_TYPES.has(type) ? type : 'application/octet-stream');
+    res.send(match[2] ? Buffer.from(body, 'base64') : decodeURIComponent(body));
+});
+
 const PORT = 4000;
 app.listen(PORT, () => {
+    startBackend();
     console.log(`NovaCom Bridge running on http://localhost:${PORT}`);
     console.log(`Executable Path: ${EXECUTABLE}`);
 }).on('error', (err) => {
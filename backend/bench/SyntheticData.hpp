@@ -0,0 +1,249 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Synthetic data/*.txt in the formats NovaGraph::loadData reads, shared by
+// datagen and e2e_bench. Friendships follow a Chung-Lu power law, community
+// sizes a Zipf law, and messages mix text with image, audio and poll rows.
+struct SyntheticConfig
+{
+    int users = 2000;
+    double avgFriends = 12;
+    double gamma = 2.3;            // degree exponent; lower means bigger hubs
+    int communities = 0;           // 0 = one per 100 users, at least 10
+    double zipf = 1.0;             // community size exponent
+    double largestCommunity = 0.3; // share of users in the biggest community
+    int messagesPerUser = 20;
+    int dmsPerUser = 5;
+    double imageShare = 0.08;
+    double audioShare = 0.04;
+    double pollShare = 0.02;
+    int mediaBytes = 2048;         // base64 payload per distinct media item
+    unsigned seed = 42;
+};
+
+// What the generator wrote, so a driver can pick arguments that hit real rows.
+struct SyntheticSummary
+{
+    vector<vector<int>> friends;    // by user id - 1, ids are 1..users
+    vector<int> communityIds;
+    vector<vector<int>> members;    // by community position, owner first
+    vector<int> messageCount;       // message ids run 1..count
+    vector<vector<int>> pollIds;
+    vector<pair<int, int>> dmPairs; // (a, b) with a < b
+    vector<int> dmCount;
+    size_t edges = 0;
+    size_t messages = 0;
+    size_t dms = 0;
+    uintmax_t bytes = 0;
+};
+
+const vector<string> SYNTHETIC_TAGS = {"Gaming", "Music", "Anime", "Movies", "Tech", "Sports", "Art", "Student"};
+const vector<string> SYNTHETIC_WORDS = {"hello", "graph", "music", "match", "tonight", "exam", "movie", "level",
+                                        "coffee", "project", "deadline", "anime", "guitar", "server", "photo", "trip"};
+
+inline string syntheticTime(mt19937 &rng)
+{
+    int minutes = rng() % (24 * 60);
+    string h = to_string(minutes / 60), m = to_string(minutes % 60);
+    return (h.size() < 2 ? "0" + h : h) + ":" + (m.size() < 2 ? "0" + m : m);
+}
+
+inline string syntheticText(mt19937 &rng)
+{
+    string text;
+    for (int w = 0, words = 3 + rng() % 10; w < words; w++)
+        text += (w ? " " : "") + SYNTHETIC_WORDS[rng() % SYNTHETIC_WORDS.size()];
+    return text;
+}
+
+// A few distinct payloads per kind, so the blob store sees realistic reuse.
+inline vector<string> syntheticMedia(mt19937 &rng, const string &mime, int bytes)
+{
+    const string BASE64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    vector<string> pool;
+    for (int i = 0; i < 8; i++)
+    {
+        string url = "data:" + mime + ";base64,";
+        for (int b = 0; b < bytes; b++)
+            url += BASE64[rng() % 64];
+        pool.push_back(url);
+    }
+    return pool;
+}
+
+// Marks a data directory as generated, so a later run may replace it.
+const string SYNTHETIC_MARKER = ".synthetic";
+
+// Writes dir/data/{users,graph,communities,chats,dms}.txt. An existing data
+// directory is only replaced if it is empty or was written here before;
+// anything else (the real data/, blob store and WAL included) is refused.
+inline SyntheticSummary writeSyntheticData(const filesystem::path &dir, const SyntheticConfig &cfg)
+{
+    filesystem::path data = dir / "data";
+    if (filesystem::exists(data) && !filesystem::is_empty(data) && !filesystem::exists(data / SYNTHETIC_MARKER))
+        throw runtime_error(data.string() + " holds data not written by the generator; pick another directory");
+    filesystem::remove_all(data);
+    filesystem::create_directories(data);
+    ofstream(data / SYNTHETIC_MARKER).close();
+    mt19937 rng(cfg.seed);
+    SyntheticSummary s;
+    int n = cfg.users;
+
+    // Chung-Lu: both endpoints drawn with probability proportional to a
+    // weight (i + 1)^(-1 / (gamma - 1)), which gives a power-law degree tail.
+    vector<double> cumulative(n);
+    double total = 0;
+    for (int i = 0; i < n; i++)
+        cumulative[i] = total += pow(i + 1.0, -1.0 / (cfg.gamma - 1.0));
+    uniform_real_distribution<double> unit(0.0, total);
+    vector<int> shuffled(n);
+    for (int i = 0; i < n; i++)
+        shuffled[i] = i;
+    shuffle(shuffled.begin(), shuffled.end(), rng);
+    auto pick = [&]()
+    { return shuffled[lower_bound(cumulative.begin(), cumulative.end(), unit(rng)) - cumulative.begin()]; };
+
+    vector<set<int>> adjacency(n);
+    for (long long e = 0; e < (long long)(n * cfg.avgFriends / 2); e++)
+    {
+        int a = pick(), b = pick();
+        if (a != b && adjacency[a].insert(b + 1).second)
+        {
+            adjacency[b].insert(a + 1);
+            s.edges++;
+        }
+    }
+    s.friends.resize(n);
+    for (int i = 0; i < n; i++)
+        s.friends[i].assign(adjacency[i].begin(), adjacency[i].end());
+
+    {
+        ofstream users(dir / "data/users.txt");
+        ofstream graph(dir / "data/graph.txt");
+        for (int id = 1; id <= n; id++)
+        {
+            users << id << "|user" << id << "|user" << id << "@nova.com|pw" << id << "|NULL|";
+            for (int t = 0, tags = 1 + rng() % 3; t < tags; t++)
+                users << (t ? "," : "") << SYNTHETIC_TAGS[rng() % SYNTHETIC_TAGS.size()];
+            users << "|" << rng() % 100 << "|0\n";
+            graph << id;
+            for (int f : s.friends[id - 1])
+                graph << "," << f;
+            graph << "\n";
+        }
+    }
+
+    int communities = cfg.communities > 0 ? cfg.communities : max(10, n / 100);
+    vector<double> share(communities);
+    double shareTotal = 0;
+    {
+        ofstream comms(dir / "data/communities.txt");
+        for (int c = 0; c < communities; c++)
+        {
+            int size = max(2, min(n, int(n * cfg.largestCommunity / pow(c + 1.0, cfg.zipf))));
+            set<int> chosen;
+            vector<int> members;
+            while ((int)members.size() < size)
+            {
+                int id = 1 + rng() % n;
+                if (chosen.insert(id).second)
+                    members.push_back(id);
+            }
+            int id = 100 + c;
+            s.communityIds.push_back(id);
+            comms << id << "|Community " << c << "|" << syntheticText(rng) << "|NULL|"
+                  << SYNTHETIC_TAGS[c % SYNTHETIC_TAGS.size()] << "|";
+            for (size_t m = 0; m < members.size(); m++)
+                comms << (m ? "," : "") << members[m];
+            comms << "|" << members[0] << "|NULL|NULL\n";
+            s.members.push_back(members);
+            share[c] = members.size();
+            shareTotal += share[c];
+        }
+    }
+
+    vector<string> images = syntheticMedia(rng, "image/png", cfg.mediaBytes);
+    vector<string> audio = syntheticMedia(rng, "audio/webm", cfg.mediaBytes);
+    s.messageCount.assign(communities, 0);
+    s.pollIds.resize(communities);
+    {
+        ofstream chats(dir / "data/chats.txt");
+        uniform_real_distribution<double> kind(0.0, 1.0);
+        for (int c = 0; c < communities; c++)
+        {
+            const vector<int> &members = s.members[c];
+            long long count = llround((double)n * cfg.messagesPerUser * share[c] / shareTotal);
+            for (int msg = 1; msg <= count; msg++)
+            {
+                int sender = members[rng() % members.size()];
+                chats << s.communityIds[c] << "|" << msg << "|" << sender << "|user" << sender << "|"
+                      << syntheticTime(rng) << "|";
+                int votes = rng() % 8 == 0 ? 1 + rng() % 3 : 0;
+                for (int v = 0; v < votes; v++)
+                    chats << (v ? "," : "") << members[rng() % members.size()];
+                chats << (votes ? "" : "0") << "|0|" << (msg > 1 && rng() % 6 == 0 ? 1 + (int)(rng() % (msg - 1)) : -1) << "|";
+                double k = kind(rng);
+                if (k < cfg.pollShare)
+                {
+                    chats << "poll|NONE|" << syntheticText(rng) << "?|0|1~Yes~" << sender << "^2~No~0";
+                    s.pollIds[c].push_back(msg);
+                }
+                else if (k < cfg.pollShare + cfg.imageShare)
+                    chats << "image|" << images[rng() % images.size()] << "|" << syntheticText(rng);
+                else if (k < cfg.pollShare + cfg.imageShare + cfg.audioShare)
+                    chats << "audio|" << audio[rng() % audio.size()] << "|voice note";
+                else
+                    chats << "text|NONE|" << syntheticText(rng);
+                chats << "\n";
+            }
+            s.messageCount[c] = count;
+            s.messages += count;
+        }
+    }
+
+    {
+        ofstream dms(dir / "data/dms.txt");
+        set<pair<int, int>> pairs;
+        for (int i = 0; i < n; i++)
+            for (int k = 0; k < 2 && !s.friends[i].empty(); k++)
+            {
+                int a = i + 1, b = s.friends[i][rng() % s.friends[i].size()];
+                pairs.insert({min(a, b), max(a, b)});
+            }
+        s.dmPairs.assign(pairs.begin(), pairs.end());
+        long long remaining = (long long)n * cfg.dmsPerUser;
+        for (size_t p = 0; p < s.dmPairs.size(); p++)
+        {
+            auto [a, b] = s.dmPairs[p];
+            int count = max(1LL, remaining / (long long)(s.dmPairs.size() - p));
+            count = min<long long>(count, remaining);
+            remaining -= count;
+            for (int msg = 1; msg <= count; msg++)
+            {
+                dms << a << "_" << b << "|" << msg << "|" << (rng() % 2 ? a : b) << "|" << syntheticTime(rng) << "|-1|NONE|1|";
+                if (rng() % 20 == 0)
+                    dms << "image|" << images[rng() % images.size()] << "|" << syntheticText(rng);
+                else
+                    dms << "text|NONE|" << syntheticText(rng);
+                dms << "\n";
+            }
+            s.dmCount.push_back(count);
+            s.dms += count;
+        }
+    }
+
+    for (auto name : {"users.txt", "graph.txt", "communities.txt", "chats.txt", "dms.txt"})
+        s.bytes += filesystem::file_size(dir / "data" / name);
+    return s;
+}
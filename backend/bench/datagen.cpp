@@ -0,0 +1,42 @@
+// Writes a synthetic dataset for manual runs of the backend:
+//   bench/run.sh datagen -- <dir> [users] [messagesPerUser] [seed]
+// then start the backend from <dir> (it reads <dir>/data). An existing
+// <dir>/data is only replaced if an earlier datagen run wrote it.
+#include "SyntheticData.hpp"
+#include <iostream>
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        cerr << "usage: datagen <dir> [users] [messagesPerUser] [seed]" << endl;
+        return 1;
+    }
+    SyntheticConfig cfg;
+    if (argc > 2)
+        cfg.users = stoi(argv[2]);
+    if (argc > 3)
+        cfg.messagesPerUser = stoi(argv[3]);
+    if (argc > 4)
+        cfg.seed = stoul(argv[4]);
+
+    SyntheticSummary s;
+    try
+    {
+        s = writeSyntheticData(argv[1], cfg);
+    }
+    catch (const exception &e)
+    {
+        cerr << "datagen: " << e.what() << endl;
+        return 1;
+    }
+    size_t maxDegree = 0;
+    for (const vector<int> &f : s.friends)
+        maxDegree = max(maxDegree, f.size());
+    cout << "users,edges,max_degree,communities,largest_community,messages,dms,bytes" << endl;
+    cout << cfg.users << "," << s.edges << "," << maxDegree << "," << s.communityIds.size() << ","
+         << (s.members.empty() ? 0 : s.members[0].size()) << "," << s.messages << "," << s.dms << "," << s.bytes << endl;
+    return 0;
+}
@@ -0,0 +1,313 @@
+// End-to-end benchmark: generates a synthetic dataset, loads it the way serve
+// mode does and drives every command through runCommand, draining events
+// after each like the serve loop.
+// Reports load time and memory per scale, then per-command p50/p99 latency,
+// response size and bytes written (wchar from /proc/self/io, so Linux only).
+// Exits non-zero if any command fails or answers with an error.
+// Build and run with bench/run.sh e2e_bench [-- users ...]
+#include "../include/Commands.hpp"
+#include "SyntheticData.hpp"
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+using namespace std;
+
+const int CALLS = 200;
+
+// "key: value" from /proc/self/<file>; -1 where there is no procfs.
+long long procValue(const string &file, const string &key)
+{
+    ifstream in("/proc/self/" + file);
+    string line;
+    while (getline(in, line))
+        if (line.compare(0, key.size() + 1, key + ":") == 0)
+            return stoll(line.substr(key.size() + 1));
+    return -1;
+}
+
+double mb(long long kb)
+{
+    return kb < 0 ? 0 : kb / 1024.0;
+}
+
+uintmax_t directoryBytes(const filesystem::path &dir)
+{
+    uintmax_t bytes = 0;
+    for (auto &entry : filesystem::recursive_directory_iterator(dir))
+        if (entry.is_regular_file())
+            bytes += entry.file_size();
+    return bytes;
+}
+
+// Value of the first "key":"..." in a response, enough for sync tokens.
+string stringField(const string &json, const string &key)
+{
+    string needle = "\"" + key + "\":\"";
+    size_t at = json.find(needle);
+    if (at == string::npos)
+        return "";
+    at += needle.size();
+    return json.substr(at, json.find('"', at) - at);
+}
+
+struct CommandStats
+{
+    vector<double> micros;
+    size_t responseBytes = 0;
+    long long written = 0;
+    int failures = 0;
+};
+
+class Driver
+{
+private:
+    NovaGraph &graph;
+
+public:
+    map<string, CommandStats> stats;
+    int failures = 0;
+
+    Driver(NovaGraph &g) : graph(g) {}
+
+    string call(vector<string> args)
+    {
+        args.insert(args.begin(), "e2e_bench");
+        ostringstream out;
+        long long before = procValue("io", "wchar");
+        auto start = chrono::steady_clock::now();
+        int code;
+        try
+        {
+            code = runCommand(graph, args, out);
+        }
+        catch (const exception &e)
+        {
+            out << "{ \"error\": \"" << e.what() << "\" }";
+            code = 1;
+        }
+        graph.takeEvents();
+        double micros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        long long after = procValue("io", "wchar");
+
+        string response = out.str();
+        CommandStats &s = stats[args[1]];
+        s.micros.push_back(micros);
+        s.responseBytes += response.size();
+        s.written += after - before;
+        if (code != 0 || response.find("\"error\"") != string::npos)
+        {
+            if (s.failures++ == 0)
+                cerr << args[1] << " failed: " << response.substr(0, 200) << endl;
+            failures++;
+        }
+        return response;
+    }
+};
+
+double percentile(vector<double> v, double p)
+{
+    sort(v.begin(), v.end());
+    return v.empty() ? 0 : v[min(v.size() - 1, size_t(p * v.size()))];
+}
+
+// One pass over every command in Commands.cpp with arguments that hit real
+// rows: reads first, then writes, then the whole-graph jobs and the commands
+// that change the storage mode last.
+void drive(Driver &d, const SyntheticSummary &s, int users, mt19937 &rng)
+{
+    auto anyone = [&]()
+    { return to_string(1 + rng() % users); };
+    auto word = [&]()
+    { return SYNTHETIC_WORDS[rng() % SYNTHETIC_WORDS.size()]; };
+    auto community = [&]()
+    { return (int)(rng() % s.communityIds.size()); };
+    auto member = [&](int c)
+    { return to_string(s.members[c][rng() % s.members[c].size()]); };
+    vector<int> chats;
+    for (size_t p = 0; p < s.dmPairs.size(); p++)
+        if (s.dmCount[p] > 0)
+            chats.push_back(p);
+    auto dmPair = [&]()
+    { return chats[rng() % chats.size()]; };
+    vector<string> blobs;
+    for (auto &entry : filesystem::directory_iterator("data/blobs"))
+        blobs.push_back(entry.path().filename().string());
+    vector<string> images = syntheticMedia(rng, "image/png", 2048);
+    vector<int> owner;
+    for (const vector<int> &m : s.members)
+        owner.push_back(m[0]);
+
+    for (int i = 0; i < CALLS; i++)
+    {
+        string u = anyone(), v = anyone();
+        int c = community(), p = dmPair();
+        string id = to_string(s.communityIds[c]), viewer = member(c);
+        string a = to_string(s.dmPairs[p].first), b = to_string(s.dmPairs[p].second);
+
+        d.call({"get_user", u});
+        d.call({"login", "user" + u, "pw" + u});
+        d.call({"get_friends", u});
+        d.call({"get_pending_requests", u});
+        d.call({"get_relationship", u, v});
+        d.call({"get_relation", u, v});
+        vector<string> relations = {"get_relations", u};
+        for (int t = 0; t < 20; t++)
+            relations.push_back(anyone());
+        d.call(relations);
+        d.call({"search_users", "user" + to_string(1 + rng() % 99), "All", "20"});
+        d.call({"search_users", "", SYNTHETIC_TAGS[rng() % SYNTHETIC_TAGS.size()], "20"});
+        if (i % 10 == 0)
+            d.call({"get_all_communities"});
+        string page = d.call({"get_community", id, viewer, "0", "50"});
+        d.call({"sync_community", id, viewer, stringField(page, "sync_token"), to_string(s.messageCount[c])});
+        d.call({"search_messages", id, viewer, word()});
+        d.call({"get_community_members", id});
+        d.call({"get_my_communities", u});
+        d.call({"get_popular", i % 3 == 0 ? "members" : (i % 3 == 1 ? "active" : "influence"), "5"});
+        string dm = d.call({"get_dm", a, b, "0", "50"});
+        d.call({"sync_dm", a, b, stringField(dm, "sync_token"), to_string(s.dmCount[p])});
+        d.call({"search_dm", a, b, word()});
+        d.call({"get_my_dms", a});
+        d.call({"get_user_recs", u});
+        d.call({"get_recommendations", u});
+        d.call({"get_comm_recs", u});
+        d.call({"get_user_analytics", u});
+        if (i % 10 == 0)
+            d.call({"get_graph_stats", "10"});
+        d.call({"get_visual_graph", to_string(rng() % users), "500"});
+        d.call({"get_ego_graph", u, "2", "300", i % 2 ? "1" : "0"});
+        if (!blobs.empty())
+            d.call({"get_blob", blobs[rng() % blobs.size()]});
+        d.call({"nav_push", u, "comm_" + id});
+        d.call({"nav_back", u});
+        d.call({"nav_forward", u});
+    }
+
+    vector<int> sentDms(s.dmPairs.size(), 0);
+    for (int i = 0; i < CALLS; i++)
+    {
+        string u = anyone(), v = anyone();
+        int c = community(), p = dmPair();
+        string id = to_string(s.communityIds[c]), sender = member(c), boss = to_string(owner[c]);
+        string msg = to_string(1 + rng() % max(1, s.messageCount[c]));
+        string a = to_string(s.dmPairs[p].first), b = to_string(s.dmPairs[p].second);
+
+        if (i % 10 == 0)
+            d.call({"send_message", id, sender, "-1", "image", images[rng() % images.size()], syntheticText(rng)});
+        else
+            d.call({"send_message", id, sender, "-1", "text", "", syntheticText(rng)});
+        if (i % 4 == 0)
+            d.call({"create_poll", id, sender, syntheticText(rng) + "?", "0", "Yes", "No", "Maybe"});
+        if (!s.pollIds[c].empty())
+            d.call({"vote_poll", id, sender, to_string(s.pollIds[c][rng() % s.pollIds[c].size()]), "1"});
+        d.call({"vote_message", id, sender, msg});
+        d.call({"send_dm", a, b, "-1", "text", "", syntheticText(rng)});
+        string sent = to_string(s.dmCount[p] + ++sentDms[p]);
+        d.call({"react_dm", b, a, sent, "heart"});
+        if (i % 2 == 0)
+        {
+            d.call({"delete_dm", a, b, sent});
+            sentDms[p]--;
+        }
+        d.call({"register", "bench" + to_string(i) + "_" + to_string(users), "bench@nova.com", "pw", "NULL", "Tech,Music"});
+        d.call({"update_profile", u, "user" + u + "@nova.com", "NULL", "Gaming,Art"});
+        d.call({"send_request", u, v});
+        d.call({i % 2 ? "accept_request" : "decline_request", v, u});
+        const vector<int> &friends = s.friends[stoi(u) - 1];
+        if (!friends.empty())
+            d.call({"remove_friend", u, to_string(friends[rng() % friends.size()])});
+        d.call({"join_community", u, id});
+        d.call({"leave_community", u, id});
+        if (i % 10 == 0)
+            d.call({"create_community", "Bench " + to_string(i), syntheticText(rng), "Tech", u, "NULL"});
+
+        string target = member(c);
+        if (target == boss)
+            continue;
+        d.call({"mod_pin", id, boss, msg});
+        d.call({"mod_delete", id, boss, to_string(1 + rng() % max(1, s.messageCount[c]))});
+        d.call({"mod_promote_admin", id, boss, target});
+        d.call({"mod_demote_admin", id, boss, target});
+        d.call({"mod_ban", id, boss, target});
+        d.call({"mod_unban", id, boss, target});
+        if (i % 10 == 0)
+        {
+            d.call({"join_community", target, id});
+            d.call({"mod_transfer", id, boss, target});
+            owner[c] = stoi(target);
+        }
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        d.call({"precompute_recs"});
+        d.call({"compute_analytics"});
+    }
+    for (int i = 0; i < 5; i++)
+        d.call({"delete_user", anyone()});
+    d.call({"convert_snapshot"});
+}
+
+int main(int argc, char *argv[])
+{
+    vector<int> scales = {2000, 20000};
+    if (argc > 1)
+        scales.clear();
+    for (int i = 1; i < argc; i++)
+        scales.push_back(stoi(argv[i]));
+
+    filesystem::path original = filesystem::current_path();
+    filesystem::path dir = filesystem::temp_directory_path() / "novacom_e2e_bench";
+    map<int, map<string, CommandStats>> results;
+    int failures = 0;
+
+    cout << "users,edges,messages,dms,data_bytes,load_ms,rss_mb,peak_rss_mb,final_data_bytes" << endl;
+    for (int users : scales)
+    {
+        SyntheticConfig cfg;
+        cfg.users = users;
+        filesystem::remove_all(dir);
+        SyntheticSummary s = writeSyntheticData(dir, cfg);
+        filesystem::current_path(dir);
+
+        // The first load moves inline media into the blob store and rewrites
+        // the text files once; time the load after that, as a restart sees it.
+        {
+            NovaGraph first;
+            first.loadData();
+        }
+        uintmax_t dataBytes = directoryBytes(dir / "data");
+        auto start = chrono::steady_clock::now();
+        NovaGraph graph;
+        graph.loadData();
+        double loadMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        long long rss = procValue("status", "VmRSS");
+
+        Driver driver(graph);
+        mt19937 rng(users);
+        drive(driver, s, users, rng);
+        failures += driver.failures;
+
+        cout << users << "," << s.edges << "," << s.messages << "," << s.dms << "," << dataBytes << ","
+             << loadMs << "," << mb(rss) << "," << mb(procValue("status", "VmHWM")) << ","
+             << directoryBytes(dir / "data") << endl;
+        results[users] = driver.stats;
+        filesystem::current_path(original);
+    }
+
+    cout << endl
+         << "users,command,calls,p50_us,p99_us,max_us,avg_response_bytes,avg_written_bytes,failures" << endl;
+    for (auto &[users, stats] : results)
+        for (auto &[command, st] : stats)
+        {
+            size_t calls = st.micros.size();
+            cout << users << "," << command << "," << calls << "," << percentile(st.micros, 0.5) << ","
+                 << percentile(st.micros, 0.99) << "," << *max_element(st.micros.begin(), st.micros.end()) << ","
+                 << st.responseBytes / calls << "," << max(0LL, st.written) / (long long)calls << "," << st.failures << endl;
+        }
+
+    filesystem::remove_all(dir);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+// Microbenchmark for the string hot paths: JSON escaping and row sanitizing,
+// per-character baselines versus the vectorized TextScan kernels.
+// Build and run with bench/run.sh escape_bench
+#include "../include/JsonWriter.hpp"
+#include "../include/TextScan.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+string baselineEscape(const string &s)
+{
+    string output;
+    for (char c : s)
+    {
+        if (c == '"')
+            output += "\\\"";
+        else if (c == '\\')
+            output += "\\\\";
+        else if (c == '\n')
+            output += "\\n";
+        else if (c == '\r')
+            output += "\\r";
+        else if (c == '\t')
+            output += "\\t";
+        else
+            output += c;
+    }
+    return output;
+}
+
+string baselineSanitize(string input)
+{
+    replace(input.begin(), input.end(), '\n', ' ');
+    replace(input.begin(), input.end(), '\r', ' ');
+    replace(input.begin(), input.end(), '|', ' ');
+    return input;
+}
+
+string makeBase64(size_t bytes, mt19937 &rng)
+{
+    static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    string s = "data:image/png;base64,";
+    for (size_t i = 0; i < bytes; i++)
+        s += ALPHABET[rng() % 64];
+    return s;
+}
+
+string makeChatText(size_t bytes, mt19937 &rng)
+{
+    static const char *WORDS[] = {"hey", "did", "you", "see", "the", "new", "build", "\"quoted\"", "path\\to", "lol", "ok\n", "tab\there"};
+    string s;
+    while (s.size() < bytes)
+    {
+        s += WORDS[rng() % 12];
+        s += ' ';
+    }
+    return s;
+}
+
+template <class F>
+double timeMs(int reps, F body)
+{
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < reps; r++)
+        body();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+void runCase(const string &name, const vector<string> &inputs, int reps)
+{
+    size_t total = 0;
+    for (const string &s : inputs)
+        total += s.size();
+    double mb = double(total) * reps / (1024 * 1024);
+    volatile size_t sink = 0;
+
+    double escOld = timeMs(reps, [&]
+                           { for (const string &s : inputs) sink += baselineEscape(s).size(); });
+    double escNew = timeMs(reps, [&]
+                           {
+        string out;
+        for (const string &s : inputs)
+        {
+            out.clear();
+            appendJsonEscaped(out, s.data(), s.size());
+            sink += out.size();
+        } });
+    double sanOld = timeMs(reps, [&]
+                           { for (const string &s : inputs) sink += baselineSanitize(s).size(); });
+    double sanNew = timeMs(reps, [&]
+                           {
+        for (const string &s : inputs)
+        {
+            string copy = s;
+            replaceSeparators(&copy[0], copy.size());
+            sink += copy.size();
+        } });
+
+    cout << name << "," << mb / (escOld / 1000) << "," << mb / (escNew / 1000) << ","
+         << mb / (sanOld / 1000) << "," << mb / (sanNew / 1000) << "\n";
+}
+
+int main()
+{
+    mt19937 rng(7);
+    cout << "kernel: " << textScanKernel() << "\n";
+    cout << "input,escape_baseline_MBps,escape_simd_MBps,sanitize_baseline_MBps,sanitize_simd_MBps\n";
+
+    vector<string> media;
+    for (int i = 0; i < 8; i++)
+        media.push_back(makeBase64(512 * 1024, rng));
+    runCase("base64_512k", media, 10);
+
+    vector<string> chat;
+    for (int i = 0; i < 20000; i++)
+        chat.push_back(makeChatText(20 + rng() % 200, rng));
+    runCase("chat_text", chat, 20);
+
+    vector<string> shortFields;
+    for (int i = 0; i < 200000; i++)
+        shortFields.push_back("user" + to_string(i));
+    runCase("short_fields", shortFields, 20);
+    return 0;
+}
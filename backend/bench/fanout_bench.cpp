@@ -0,0 +1,192 @@
+// Recommendation latency and recall: bounded fan-out walk versus the exhaustive
+// 3-hop ball, on Chung-Lu power-law friend graphs with Zipf-sized communities.
+// Build and run with bench/run.sh fanout_bench
+#include "../include/Graph.hpp"
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+
+using namespace std;
+
+const int COMMUNITIES = 200;
+const int SAMPLED_USERS = 400;
+
+// Expected degree of user i is proportional to (i + 1)^(-1 / (gamma - 1)),
+// so the first few users are hubs with thousands of friends.
+void writeDataset(const filesystem::path &dir, int users, double avgDegree, double gamma)
+{
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir / "data");
+    mt19937 rng(42);
+
+    vector<double> cumulative(users);
+    double total = 0;
+    for (int i = 0; i < users; i++)
+        cumulative[i] = total += pow(i + 1.0, -1.0 / (gamma - 1.0));
+    uniform_real_distribution<double> unit(0.0, total);
+    auto pick = [&]()
+    { return int(lower_bound(cumulative.begin(), cumulative.end(), unit(rng)) - cumulative.begin()); };
+
+    vector<set<int>> friends(users);
+    for (long long e = 0; e < (long long)(users * avgDegree / 2); e++)
+    {
+        int a = pick(), b = pick();
+        if (a != b)
+        {
+            friends[a].insert(b);
+            friends[b].insert(a);
+        }
+    }
+
+    ofstream usersOut(dir / "data/users.txt");
+    ofstream graphOut(dir / "data/graph.txt");
+    for (int i = 0; i < users; i++)
+    {
+        usersOut << i + 1 << "|user" << i + 1 << "|user" << i + 1 << "@nova.com|pw|NULL|Gaming|0|0\n";
+        graphOut << i + 1;
+        for (int f : friends[i])
+            graphOut << "," << f + 1;
+        graphOut << "\n";
+    }
+
+    ofstream comms(dir / "data/communities.txt");
+    uniform_int_distribution<int> anyone(1, users);
+    for (int c = 0; c < COMMUNITIES; c++)
+    {
+        int size = max(2, int(users * 0.2 / (c + 1)));
+        comms << 100 + c << "|Community " << c << "|Benchmark community|NULL|Tech|";
+        for (int m = 0; m < size; m++)
+            comms << (m ? "," : "") << anyone(rng);
+        comms << "|" << anyone(rng) << "|NULL|NULL\n";
+    }
+    for (auto name : {"chats.txt", "dms.txt"})
+        ofstream(dir / "data" / name);
+}
+
+vector<int> valuesOf(const string &json, const string &key)
+{
+    vector<int> values;
+    string needle = "\"" + key + "\":";
+    for (size_t at = json.find(needle); at != string::npos; at = json.find(needle, at + needle.size()))
+        values.push_back(atoi(json.c_str() + at + needle.size()));
+    return values;
+}
+
+double recall(const vector<int> &truth, const vector<int> &got)
+{
+    if (truth.empty())
+        return 1.0;
+    set<int> found(got.begin(), got.end());
+    int hits = 0;
+    for (int id : truth)
+        hits += found.count(id);
+    return double(hits) / truth.size();
+}
+
+// Many candidates tie on score and ties go to the lowest id, which a sampled
+// walk cannot reproduce; this counts rank i as a hit when its score matches.
+double scoreRecall(const vector<int> &truth, const vector<int> &got)
+{
+    if (truth.empty())
+        return 1.0;
+    int hits = 0;
+    for (size_t i = 0; i < truth.size() && i < got.size(); i++)
+        hits += got[i] >= truth[i];
+    return double(hits) / truth.size();
+}
+
+struct Run
+{
+    vector<double> micros;
+    vector<vector<int>> users, userScores, communities;
+};
+
+Run measure(NovaGraph &graph, const vector<int> &sample)
+{
+    Run run;
+    for (int id : sample)
+    {
+        ostringstream users, communities;
+        auto start = chrono::steady_clock::now();
+        {
+            JsonWriter json(users);
+            graph.getSmartUserRecommendations(json, id);
+        }
+        run.micros.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+        {
+            JsonWriter json(communities);
+            graph.getSmartCommunityRecommendations(json, id);
+        }
+        run.users.push_back(valuesOf(users.str(), "id"));
+        run.userScores.push_back(valuesOf(users.str(), "score"));
+        run.communities.push_back(valuesOf(communities.str(), "id"));
+    }
+    return run;
+}
+
+double percentile(vector<double> v, double p)
+{
+    sort(v.begin(), v.end());
+    return v.empty() ? 0 : v[min(v.size() - 1, size_t(p * v.size()))];
+}
+
+int main()
+{
+    filesystem::path original = filesystem::current_path();
+    filesystem::path dir = filesystem::temp_directory_path() / "novacom_fanout_bench";
+
+    vector<pair<string, FanOut>> configs = {
+        {"exhaustive", FanOut()},
+        {"default", FanOut{{256, 64, 32}, 5000}},
+        {"wide", FanOut{{512, 128, 64}, 20000}},
+        {"tight", FanOut{{128, 32, 16}, 2000}},
+    };
+
+    cout << "users,gamma,max_degree,config,p50_us,p99_us,user_recall,user_score_recall,community_recall" << endl;
+    for (int users : {20000, 100000})
+        for (double gamma : {2.1, 2.5})
+        {
+            writeDataset(dir, users, 12, gamma);
+            filesystem::current_path(dir);
+            NovaGraph graph;
+            graph.loadData();
+            graph.refreshAnalytics();
+
+            int maxDegree = 0;
+            ifstream rows(dir / "data/graph.txt");
+            for (string line; getline(rows, line);)
+                maxDegree = max(maxDegree, (int)count(line.begin(), line.end(), ','));
+
+            mt19937 rng(7);
+            vector<int> sample;
+            for (int i = 0; i < SAMPLED_USERS; i++)
+                sample.push_back(1 + rng() % users);
+
+            Run truth;
+            for (auto &[name, fanOut] : configs)
+            {
+                graph.setRecommendationFanOut(fanOut);
+                Run run = measure(graph, sample);
+                if (name == "exhaustive")
+                    truth = run;
+                double userRecall = 0, scoreMatch = 0, communityRecall = 0;
+                for (size_t i = 0; i < sample.size(); i++)
+                {
+                    userRecall += recall(truth.users[i], run.users[i]);
+                    scoreMatch += scoreRecall(truth.userScores[i], run.userScores[i]);
+                    communityRecall += recall(truth.communities[i], run.communities[i]);
+                }
+                cout << users << "," << gamma << "," << maxDegree << "," << name << ","
+                     << percentile(run.micros, 0.5) << "," << percentile(run.micros, 0.99) << ","
+                     << userRecall / sample.size() << "," << scoreMatch / sample.size() << "," << communityRecall / sample.size() << endl;
+            }
+            filesystem::current_path(original);
+        }
+    filesystem::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,27 @@
+#!/bin/sh
+# Builds the backend benchmarks against every backend source except main.cpp
+# and runs them. Usage: bench/run.sh [name ...] [-- args]
+# With no names every *_bench.cpp runs; args after -- go to each program, e.g.
+#   bench/run.sh e2e_bench -- 100000
+#   bench/run.sh datagen -- /tmp/novacom 50000
+# Exits non-zero if a build or a program fails, so CI can run it as is.
+set -e
+cd "$(dirname "$0")/.."
+SOURCES=$(ls src/*.cpp | grep -v 'src/main.cpp')
+mkdir -p bench/bin
+
+NAMES=""
+while [ $# -gt 0 ] && [ "$1" != "--" ]; do
+    NAMES="$NAMES $1"
+    shift
+done
+[ "$1" = "--" ] && shift
+if [ -z "$NAMES" ]; then
+    NAMES=$(cd bench && ls *_bench.cpp | sed 's/\.cpp$//')
+fi
+
+for name in $NAMES; do
+    echo "== $name"
+    g++ -std=c++17 -O2 -pthread -I include "bench/$name.cpp" $SOURCES -o "bench/bin/$name"
+    "./bench/bin/$name" "$@"
+done
@@ -0,0 +1,104 @@
+// Startup-time benchmark: text (.txt) loading versus the mmap'ed binary snapshot.
+// The first load spills sealed chat history to data/history and cuts
+// chats.txt/dms.txt down to the tails, so an untimed load runs first and both
+// formats are then timed over the same content: the tails plus the shared
+// history segments (history_bytes).
+// Build and run with bench/run.sh snapshot_bench
+#include "../include/Graph.hpp"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+const int USERS = 2000;
+const int COMMUNITIES = 100;
+
+void writeDataset(const filesystem::path &dir, int messages)
+{
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir / "data");
+    mt19937 rng(42);
+
+    ofstream users(dir / "data/users.txt");
+    for (int id = 1; id <= USERS; id++)
+        users << id << "|user" << id << "|user" << id << "@nova.com|pw|NULL|Gaming,Music|" << (id % 50) << "|0\n";
+
+    ofstream graph(dir / "data/graph.txt");
+    for (int id = 1; id <= USERS; id++)
+    {
+        graph << id;
+        for (int k = 1; k <= 10; k++)
+            graph << "," << (1 + (id + k * 37) % USERS);
+        graph << "\n";
+    }
+
+    ofstream comms(dir / "data/communities.txt");
+    for (int c = 0; c < COMMUNITIES; c++)
+    {
+        comms << 100 + c << "|Community " << c << "|Benchmark community|NULL|Tech|";
+        for (int m = 1; m <= 50; m++)
+            comms << (m > 1 ? "," : "") << 1 + (c * 13 + m) % USERS;
+        comms << "|" << 1 + c << "|NULL|NULL\n";
+    }
+
+    ofstream chats(dir / "data/chats.txt");
+    for (int i = 0; i < messages; i++)
+    {
+        int sender = 1 + rng() % USERS;
+        chats << 100 + i % COMMUNITIES << "|" << 1 + i / COMMUNITIES << "|" << sender << "|user" << sender
+              << "|12:00|" << (i % 7 == 0 ? "3,9" : "0") << "|0|" << (i % 5 == 0 ? 1 : -1)
+              << "|text|NONE|message number " << i << " with a little bit of chat text\n";
+    }
+
+    ofstream dms(dir / "data/dms.txt");
+    for (int i = 0; i < messages / 10; i++)
+        dms << "1_" << 2 + i % 100 << "|" << 1 + i / 100 << "|1|12:00|-1|NONE|1|text|NONE|direct message " << i << "\n";
+}
+
+double timeLoad()
+{
+    auto start = chrono::steady_clock::now();
+    {
+        NovaGraph graph;
+        graph.loadData();
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+    filesystem::path original = filesystem::current_path();
+    filesystem::path dir = filesystem::temp_directory_path() / "novacom_snapshot_bench";
+
+    cout << "messages,text_ms,binary_ms,text_bytes,binary_bytes,history_bytes" << endl;
+    for (int messages : {10000, 100000, 1000000})
+    {
+        writeDataset(dir, messages);
+        filesystem::current_path(dir);
+
+        timeLoad();
+        double textMs = timeLoad();
+        uintmax_t textBytes = 0, historyBytes = 0;
+        for (auto name : {"users.txt", "graph.txt", "communities.txt", "chats.txt", "dms.txt"})
+            textBytes += filesystem::file_size(dir / "data" / name);
+        for (auto &entry : filesystem::directory_iterator(dir / "data/history"))
+            historyBytes += entry.file_size();
+
+        {
+            NovaGraph graph;
+            graph.loadData();
+            graph.convertToSnapshot();
+        }
+        double binaryMs = timeLoad();
+        uintmax_t binaryBytes = filesystem::file_size(dir / "data/snapshot.bin");
+
+        cout << messages << "," << textMs << "," << binaryMs << "," << textBytes << "," << binaryBytes << ","
+             << historyBytes << endl;
+        filesystem::current_path(original);
+    }
+    filesystem::remove_all(dir);
+    return 0;
+}
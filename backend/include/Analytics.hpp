@@ -0,0 +1,50 @@
+#pragma once
+#include "FriendGraph.hpp"
+#include <vector>
+
+using namespace std;
+
+// Whole-graph scores from one batch run over the friendship graph and the
+// user-community membership table. Per-user vectors are indexed like `ids`
+// (the FriendGraph's dense order at the time of the run), so a cached result
+// stays readable after the graph has been rebuilt; look users up with slotOf.
+struct GraphAnalytics
+{
+    bool computed = false;
+    size_t graphVersion = 0;
+    size_t changeSeq = 0;       // NovaGraph change count the run started from
+    long long ms = 0;
+    int threads = 0;
+    size_t edges = 0;
+
+    vector<int> ids;
+    vector<int> component;      // smallest slot in the same connected component
+    vector<int> componentSize;  // indexed by component root
+    vector<double> pageRank;    // sums to 1 over all slots
+    vector<int> triangles;      // triangles through the user
+    vector<double> clustering;  // local clustering coefficient
+    vector<int> cluster;        // label-propagation label, a slot in the cluster
+    vector<int> clusterSize;    // indexed by label
+    int componentCount = 0;
+    int clusterCount = 0;
+
+    // Summed PageRank of each community's members, by community id.
+    vector<pair<int, double>> communityInfluence;
+
+    int slotOf(int userId) const;
+};
+
+// A copy of what a run reads, taken under the graph lock so the run itself
+// can go on without it.
+struct AnalyticsInput
+{
+    FriendGraph graph;
+    vector<vector<int>> memberships;
+    vector<int> communityIds;
+    size_t changeSeq = 0;
+};
+
+// Membership rows are indexed by FriendGraph dense index and hold positions
+// into communityIds, as prepared for recommendations.
+void computeAnalytics(const FriendGraph &g, const vector<vector<int>> &memberships,
+                      const vector<int> &communityIds, int threads, GraphAnalytics &out);
@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+
+using namespace std;
+
+// Content-addressed storage for inline media (data: URIs). Payloads live in
+// data/blobs/<key>; rows and JSON carry only "blobref:<key>". data: URIs of
+// any type other than the app's image and audio formats are dropped (intern
+// returns "").
+class BlobStore
+{
+private:
+    string dir;
+
+public:
+    static const string REF_PREFIX;
+
+    void open(const string &directory);
+    string put(const string &payload);
+    string intern(const string &value);
+    bool get(const string &key, string &payload) const;
+
+    static bool isValidKey(const string &key);
+    static bool isAllowedMedia(const string &dataUri);
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+using namespace std;
+
+// Per-conversation change counter for incremental polling. Every mutation
+// bumps the version. Edits and deletes of existing messages are also logged
+// by id; new messages are not, since clients find them by id instead. Only
+// the last CAPACITY edits are kept, so a delta can start no earlier than
+// `floor`.
+struct ChangeRing
+{
+    static const size_t CAPACITY = 64;
+
+    uint64_t version = 0;
+    uint64_t floor = 0;
+    deque<pair<uint64_t, int>> edits;
+
+    void touch() { version++; }
+
+    void edited(int msgId)
+    {
+        version++;
+        edits.push_back({version, msgId});
+        if (edits.size() > CAPACITY)
+        {
+            floor = edits.front().first;
+            edits.pop_front();
+        }
+    }
+
+    bool covers(uint64_t since) const { return since >= floor && since <= version; }
+};
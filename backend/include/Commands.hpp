@@ -0,0 +1,10 @@
+#pragma once
+#include "Graph.hpp"
+#include <string>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+string resolveArg(const vector<string> &args, int index);
+int runCommand(NovaGraph &graph, const vector<string> &args, ostream &out);
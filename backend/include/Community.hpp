@@ -3,6 +3,9 @@
 #include <vector>
 #include <set>
 #include <map>
+#include "MessageLog.hpp"
+#include "ChangeRing.hpp"
+#include "TextIndex.hpp"
 
 using namespace std;
 
@@ -37,6 +40,20 @@ struct Message
     PollData poll;
 };
 
+// Binary record codec shared by data/snapshot.bin and the history segments.
+void writeRecord(SnapshotWriter &w, const Message &m);
+void readRecord(SnapshotReader &r, Message &m);
+
+// Pinned messages keep their history segment resident.
+inline bool isSticky(const Message &m) { return m.isPinned; }
+
+// Only typed text and poll questions are searchable; media captions, inline
+// payloads and legacy "POLL" rows (which carry vote counts) are not.
+inline bool isSearchable(const Message &m)
+{
+    return (m.type == "text" || m.type == "poll") && m.content.compare(0, 5, "data:") != 0;
+}
+
 struct Community
 {
     int id;
@@ -45,11 +62,26 @@ struct Community
     string coverUrl;
     vector<string> tags;
     set<int> members;
-    vector<Message> chatHistory;
+    MessageLog<Message> chatHistory;
 
     set<int> moderators;
     set<int> admins;
     set<int> bannedUsers;
 
+    // Ids of the pinned messages in history order, kept in step with
+    // Message::isPinned by NovaGraph and rebuilt on load.
+    set<int> pinnedIds;
+    ChangeRing changes;
+    TextIndex textIndex;
+
     int nextMsgId = 1;
-};
\ No newline at end of file
+};
+
+// Reverse index entry: the communities a user belongs to, by role.
+struct CommunityRoles
+{
+    set<int> joined;
+    set<int> moderated;
+    set<int> admin;
+    set<int> banned;
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Community ids ordered for the dashboard, kept current by NovaGraph on every
+// membership change and every new post, so the top of either order is a
+// walk over a few set nodes.
+//   byMembers:  most members first, then lowest id
+//   byActivity: most recent post first, then most members, then lowest id
+// Activity is a tick from a counter bumped on each post. On load NovaGraph
+// seeds it from each community's newest message, and the counter starts past
+// every seed so any new post ranks first.
+class CommunityRanking
+{
+private:
+    struct Entry
+    {
+        size_t members = 0;
+        long long active = 0;
+    };
+    unordered_map<int, Entry> entries;
+    set<tuple<size_t, int>> byMembers;
+    set<tuple<long long, size_t, int>> byActivity;
+    long long clock = 0;
+
+    void place(int id, const Entry &e);
+    void unplace(int id, const Entry &e);
+
+public:
+    void clear();
+    void update(int id, size_t members);
+    void touch(int id);
+    void seed(int id, long long tick);
+
+    vector<int> top(size_t n, bool recent) const;
+};
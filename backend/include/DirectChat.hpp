@@ -1,6 +1,9 @@
 #pragma once
 #include <string>
 #include <vector>
+#include "MessageLog.hpp"
+#include "ChangeRing.hpp"
+#include "TextIndex.hpp"
 
 using namespace std;
 
@@ -19,9 +22,34 @@ struct DirectMessage
     string mediaUrl = "";
 };
 
+void writeRecord(SnapshotWriter &w, const DirectMessage &m);
+void readRecord(SnapshotReader &r, DirectMessage &m);
+
+// Unseen messages keep their history segment resident, so the unread
+// counters can always be rebuilt from memory.
+inline bool isSticky(const DirectMessage &m) { return !m.isSeen; }
+
+inline bool isSearchable(const DirectMessage &m)
+{
+    return m.type == "text" && m.content.compare(0, 5, "data:") != 0;
+}
+
 struct DirectChat
 {
     string chatKey;
-    vector<DirectMessage> messages;
+    MessageLog<DirectMessage> messages;
     int nextMsgId = 1;
+    ChangeRing changes;
+    TextIndex textIndex;
+
+    // Participants (lowId <= highId) and unseen-message counts per sender,
+    // kept current by NovaGraph so the inbox never rescans the history.
+    int lowId = 0;
+    int highId = 0;
+    int unseenFromLow = 0;
+    int unseenFromHigh = 0;
+
+    int partnerOf(int userId) const { return userId == lowId ? highId : lowId; }
+    int &unseenFrom(int senderId) { return senderId == lowId ? unseenFromLow : unseenFromHigh; }
+    int unseenFrom(int senderId) const { return senderId == lowId ? unseenFromLow : unseenFromHigh; }
 };
\ No newline at end of file
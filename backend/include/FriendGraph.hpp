@@ -0,0 +1,93 @@
+#pragma once
+#include <map>
+#include <vector>
+
+using namespace std;
+
+// Reusable BFS state. dist is indexed by dense node index (-1 = unvisited);
+// order lists the nodes reached by the last run, so only those are reset.
+// tally holds mutual-friend counts from countMutuals for the nodes in counted.
+struct BfsScratch
+{
+    vector<int> dist;
+    vector<int> order;
+    vector<int> tally;
+    vector<int> counted;
+};
+
+// Caps for sampleCandidates (0 = no limit): perHop[0] bounds how many friends
+// are expanded, perHop[1] and perHop[2] how many neighbours of each hop-1 and
+// hop-2 node are followed, and maxReached how many nodes beyond the friends
+// are reached.
+struct FanOut
+{
+    int perHop[3] = {0, 0, 0};
+    size_t maxReached = 0;
+};
+
+// Visited state for depth-bounded degree queries. A node counts as reached
+// from side k only while mark[k][v] == epoch, so starting a new query is a
+// single increment instead of a clear.
+struct DegreeScratch
+{
+    unsigned epoch = 0;
+    vector<unsigned> mark[2];
+    vector<int> dist[2];
+    vector<int> frontier[2];
+    vector<int> next;
+
+    void begin(int nodes);
+};
+
+// Compressed-sparse-row view of the friendship graph. User IDs are mapped to
+// dense indices in ascending order and each neighbor row is sorted, so
+// traversals are linear scans over two flat arrays. Rows are laid out with
+// some slack so addEdge/removeEdge update them in place; a row that outgrows
+// its slack moves to the end of the array, and the space it leaves is
+// reclaimed by compact() once it is half the array. A user whose id is above
+// every indexed id gets a new row at the end; anything else marks the view
+// dirty for a full build().
+class FriendGraph
+{
+private:
+    vector<int> ids;
+    vector<int> rowStart;
+    vector<int> rowEnd;
+    vector<int> rowCap;
+    vector<int> neighbors;
+    size_t used = 0;
+    size_t wasted = 0;
+    bool dirty = true;
+    size_t layouts = 0;
+
+    int rowFor(int id);
+    void insertNeighbor(int row, int v);
+    void eraseNeighbor(int row, int v);
+    void compact();
+
+public:
+    void build(const map<int, vector<int>> &adjList);
+    void addEdge(int a, int b);
+    void removeEdge(int a, int b);
+    void markDirty() { dirty = true; }
+    bool isDirty() const { return dirty; }
+    // Changes whenever dense indices are reassigned or added.
+    size_t version() const { return layouts; }
+
+    int size() const { return (int)ids.size(); }
+    size_t edgeCount() const { return used / 2; }
+    int indexOf(int id) const;
+    int idAt(int index) const { return ids[index]; }
+    int degree(int index) const { return rowEnd[index] - rowStart[index]; }
+    const int *begin(int index) const { return neighbors.data() + rowStart[index]; }
+    const int *end(int index) const { return neighbors.data() + rowEnd[index]; }
+
+    void bfs(int startIndex, int maxDepth, BfsScratch &scratch) const;
+    int sampleCandidates(int startIndex, const FanOut &fanOut, BfsScratch &scratch) const;
+    int distance(int a, int b, int maxDepth, DegreeScratch &scratch) const;
+    void distances(int startIndex, const vector<int> &targets, int maxDepth, DegreeScratch &scratch, vector<int> &out) const;
+    int commonNeighbors(int a, int b) const;
+    // Mutual-friend counts for every node two hops from me, left in
+    // scratch.tally. Needs a bfs(me, >= 2) into the same scratch first.
+    void countMutuals(int me, BfsScratch &scratch) const;
+};
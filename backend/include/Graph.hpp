@@ -2,6 +2,15 @@
 #include "User.hpp"
 #include "Community.hpp"
 #include "DirectChat.hpp"
+#include "WriteAheadLog.hpp"
+#include "BlobStore.hpp"
+#include "HistoryStore.hpp"
+#include "JsonWriter.hpp"
+#include "FriendGraph.hpp"
+#include "UserIndex.hpp"
+#include "CommunityRanking.hpp"
+#include "Recommendations.hpp"
+#include "Analytics.hpp"
 #include <map>
 #include <vector>
 #include <string>
@@ -10,6 +19,7 @@
 #include <set>
 #include <algorithm>
 #include <stack>
+#include <chrono>
 
 using namespace std;
 
@@ -18,16 +28,105 @@ class NovaGraph
 private:
     map<int, User> userDB;
     map<string, int> usernameIndex;
+    UserIndex userIndex;
     map<int, vector<int>> adjList;
+    FriendGraph friendGraph;
+    BfsScratch bfsScratch;
+    DegreeScratch degreeScratch;
+
+    static const int USER_REC_LIMIT = 10;
+    static const int COMMUNITY_REC_LIMIT = 6;
+    map<int, RecommendationEntry> recCache;
+    vector<int> recCommunityIds;
+    vector<vector<int>> recMemberships;
+    vector<char> recKnownUser;
+    size_t recMembershipVersion = 0;
+    bool recMembershipsDirty = true;
+    RecommendationScratch recScratch;
+    // Friends-of-friends walk limits; hubs beyond these caps are sampled.
+    FanOut recFanOut = {{256, 64, 32}, 5000};
+    int recWarmCursor = 0;
+    GraphAnalytics analytics;
+    // Friendship and membership changes so far; analytics are refreshed once
+    // ANALYTICS_REFRESH_CHANGES have piled up, or after
+    // ANALYTICS_REFRESH_SECONDS if there is any.
+    static const size_t ANALYTICS_REFRESH_CHANGES = 1000;
+    static const int ANALYTICS_REFRESH_SECONDS = 60;
+    size_t graphChanges = 0;
+    chrono::steady_clock::time_point analyticsRunAt;
+    bool analyticsInBackground = false;
     map<int, Community> communityDB;
+    map<int, CommunityRoles> communityRoles;
+    CommunityRanking communityRanking;
     map<string, DirectChat> dmDB;
+    map<int, set<string>> dmIndex;
 
     int nextCommunityId = 100;
 
+    static const size_t SYNC_NEW_LIMIT = 100;
+    string syncEpoch;
+    set<string> events;
+
+    static const size_t WAL_COMPACT_BYTES = 8 * 1024 * 1024;
+    WriteAheadLog wal;
+    BlobStore blobs;
+    HistoryStore history;
+    bool loadedInlineMedia = false;
+    bool binarySnapshot = false;
+
+    void loadUserRow(const string &line);
+    void loadGraphRow(const string &line);
+    void loadCommunityRow(const string &line);
+    void loadChatRow(const string &line);
+    void loadDMRow(const string &line);
+    void replayLog();
+    void attachHistory(Community &c);
+    void attachHistory(DirectChat &chat);
+    DirectChat &directChat(const string &key);
+    void restoreHistoryLogs();
+    void trimHistory();
+    void saveHistory();
+    void rebuildCommunityIndex();
+    void rebuildDMIndex();
+    void syncCommunityRoles(const Community &c, int userId);
+    string loadMedia(const string &value);
+    bool loadSnapshot(const string &path);
+    void saveSnapshot(const string &path);
+    void logRecord(const string &type, const string &row);
+    void publish(const Community &c);
+    void publish(const DirectChat &chat);
+    const FriendGraph &friendView();
+    void prepareRecommendations();
+    void computeRecommendations(int userId, RecommendationScratch &scratch, RecommendationEntry &entry) const;
+    void computeRecommendationBatch(const vector<int> &ids, int threads);
+    const RecommendationEntry &recommendationsFor(int userId, bool communities);
+    void invalidateRecommendationsAround(int userId, int depth, bool users);
+    void friendshipChanged(int u, int v);
+    void membershipChanged(int userId);
+    const GraphAnalytics &analyticsView();
+    bool analyticsStale();
+    string syncToken(const ChangeRing &ring) const;
+    bool readSyncToken(const string &token, const ChangeRing &ring, uint64_t &since) const;
+    void markSeen(DirectChat &chat, int friendId);
+    void writeDirectMessageJSON(JsonWriter &json, DirectChat &chat, const DirectMessage &m);
+    void writeMessageJSON(JsonWriter &json, Community &c, const Message &m, int userId);
+    void writePinnedJSON(JsonWriter &json, Community &c);
+    void writeGraphNodeJSON(JsonWriter &json, const User &u, int degree);
+
 public:
     vector<string> split(const string &s, char delimiter);
     void loadData();
     void saveData();
+    void convertToSnapshot();
+    vector<string> takeEvents();
+    int precomputeRecommendations(int threads = 0);
+    int warmRecommendations(size_t limit, int threads = 0);
+    void setRecommendationFanOut(const FanOut &fanOut);
+    const GraphAnalytics &refreshAnalytics(int threads = 0);
+    bool analyticsDue() const;
+    void runAnalyticsInBackground() { analyticsInBackground = true; }
+    AnalyticsInput analyticsInput();
+    void installAnalytics(GraphAnalytics &result, const AnalyticsInput &input);
     int registerUser(string username, string email, string password, string avatar, string tags);
     int loginUser(string username, string password);
     void updateUserProfile(int id, string email, string avatar, string tags);
@@ -36,7 +135,7 @@ public:
     string sendConnectionRequest(int senderId, int targetId);
     void acceptConnectionRequest(int userId, int requesterId);
     void declineConnectionRequest(int userId, int requesterId);
-    string getPendingRequestsJSON(int userId);
+    void getPendingRequestsJSON(JsonWriter &json, int userId);
     string getRelationshipStatus(int me, int target);
 
     void addUser(int id, string username);
@@ -46,13 +145,13 @@ public:
     void leaveCommunity(int userId, int commId);
 
     void addMessage(int commId, int senderId, string content, string type = "text", string mediaUrl = "", int replyToId = -1);
-    void votePoll(int commId, int userId, int msgIndex, int optionIndex);
+    void votePoll(int commId, int userId, int msgId, int optionIndex);
 
     void banUser(int commId, int actorId, int targetId);
     void unbanUser(int commId, int actorId, int targetId);
-    void deleteMessage(int commId, int actorId, int msgIndex);
-    void pinMessage(int commId, int actorId, int msgIndex);
-    void upvoteMessage(int commId, int userId, int msgIndex);
+    void deleteMessage(int commId, int actorId, int msgId);
+    void pinMessage(int commId, int actorId, int msgId);
+    void upvoteMessage(int commId, int userId, int msgId);
     void promoteToAdmin(int commId, int actorId, int targetId);
     void demoteAdmin(int commId, int actorId, int targetId);
     void transferOwnership(int commId, int actorId, int targetId);
@@ -64,27 +163,36 @@ public:
     void sendDirectMessage(int senderId, int receiverId, string content, int replyToId = -1, string type = "text", string mediaUrl = "");
     void reactToDirectMessage(int senderId, int receiverId, int msgId, string reaction);
     void deleteDirectMessage(int userId, int friendId, int msgId);
-    string getDirectChatJSON(int viewerId, int friendId, int offset = 0, int limit = 50);
-    string getActiveDMsJSON(int userId);
-
-    string getUserJSON(int id);
-    string getFriendListJSON(int id);
-    string getAllCommunitiesJSON();
-    string getCommunityDetailsJSON(int commId, int userId, int offset = 0, int limit = 50);
-    string searchUsersJSON(string query, string tagFilter);
-    string getPopularCommunitiesJSON();
-    string getGraphVisualJSON();
-    string getRecommendationsJSON(int userId);
-    string getCommunityMembersJSON(int commId);
+    void getDirectChatJSON(JsonWriter &json, int viewerId, int friendId, int offset = 0, int limit = 50);
+    void getDirectSyncJSON(JsonWriter &json, int viewerId, int friendId, const string &token, int lastId);
+    void searchDirectMessagesJSON(JsonWriter &json, int viewerId, int friendId, const string &query, size_t limit);
+    void getActiveDMsJSON(JsonWriter &json, int userId);
+
+    void getUserJSON(JsonWriter &json, int id);
+    void getFriendListJSON(JsonWriter &json, int id);
+    void getAllCommunitiesJSON(JsonWriter &json);
+    void getCommunityDetailsJSON(JsonWriter &json, int commId, int userId, int offset = 0, int limit = 50);
+    void getCommunitySyncJSON(JsonWriter &json, int commId, int userId, const string &token, int lastId);
+    void searchCommunityMessagesJSON(JsonWriter &json, int commId, int userId, const string &query, size_t limit);
+    void searchUsersJSON(JsonWriter &json, string query, string tagFilter, size_t limit = 0);
+    void getPopularCommunitiesJSON(JsonWriter &json, const string &order = "members", size_t limit = 5);
+    void getGraphVisualJSON(JsonWriter &json, int afterId = 0, size_t limit = 0);
+    void getEgoGraphJSON(JsonWriter &json, int centerId, int hops, size_t maxNodes, bool sampleByDegree);
+    void getRecommendationsJSON(JsonWriter &json, int userId);
+    void getCommunityMembersJSON(JsonWriter &json, int commId);
+    void getBlobJSON(JsonWriter &json, string key);
 
     int getRelationDegree(int startNode, int targetNode);
-    string getConnectionsByDegreeJSON(int startNode, int targetDegree);
+    vector<int> getRelationDegrees(int startNode, const vector<int> &targetNodes);
+    void getConnectionsByDegreeJSON(JsonWriter &json, int startNode, int targetDegree);
 
-    string getJoinedCommunitiesJSON(int userId);
+    void getJoinedCommunitiesJSON(JsonWriter &json, int userId);
 
-    string getSmartUserRecommendations(int userId);
-    string getSmartCommunityRecommendations(int userId);
-    map<int, int> getDistancesBFS(int startId);
+    void getSmartUserRecommendations(JsonWriter &json, int userId);
+    void getSmartCommunityRecommendations(JsonWriter &json, int userId);
+    void getUserAnalyticsJSON(JsonWriter &json, int userId);
+    void getGraphStatsJSON(JsonWriter &json, size_t top = 10);
+    vector<pair<int, int>> getDistancesBFS(int startId);
 
     void navPush(int userId, string tab);
     string navBack(int userId);
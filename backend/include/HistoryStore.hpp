@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Bookkeeping for one chat-history segment. It stays in memory even when the
+// segment's messages do not, so counting and paging never touch disk.
+struct SegmentMeta
+{
+    int minId = 0;
+    int maxId = 0;
+    bool sticky = false;
+    vector<uint8_t> alive;
+};
+
+// On-disk home of sealed chat-history segments:
+//   data/history/<log>.<segment>.seg  "NOVAHIST" | u32 version | u32 reserved | u64 payloadSize | u64 checksum | payload
+//   data/history/manifest.txt         <log>|<segment>|<minId>|<maxId>|<sticky>|<alive bitmap, hex>
+// A segment file is written as soon as its segment seals, so files may run
+// ahead of the manifest; the manifest is only rewritten by NovaGraph::saveData.
+class HistoryStore
+{
+private:
+    string dir;
+    map<string, vector<SegmentMeta>> manifest;
+    map<string, size_t> listed;
+    bool behind = false;
+
+    string segmentPath(const string &log, size_t index) const;
+
+public:
+    void open(const string &directory);
+    vector<SegmentMeta> restore(const string &log) const;
+    vector<string> logs() const;
+    bool readSegment(const string &log, size_t index, string &payload) const;
+    void writeSegment(const string &log, size_t index, const string &payload);
+    void commitManifest(const map<string, vector<SegmentMeta>> &logs);
+    bool manifestBehind() const { return behind; }
+};
@@ -0,0 +1,115 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+void appendJsonEscaped(string &out, const char *s, size_t n);
+
+// Builds JSON into one pre-sized buffer. When bound to a stream the buffer is
+// handed to the sink in CHUNK-sized pieces, so large responses never exist as
+// a single string. Commas between members and elements are inserted automatically.
+class JsonWriter
+{
+private:
+    ostream *sink = nullptr;
+    string buf;
+    vector<bool> needComma;
+    bool afterKey = false;
+    bool wroteAny = false;
+
+    void separator()
+    {
+        wroteAny = true;
+        if (afterKey)
+        {
+            afterKey = false;
+            return;
+        }
+        if (!needComma.empty())
+        {
+            if (needComma.back())
+                buf += ',';
+            needComma.back() = true;
+        }
+    }
+    void spill()
+    {
+        if (sink && buf.size() >= CHUNK)
+            flush();
+    }
+    JsonWriter &literal(const char *text)
+    {
+        separator();
+        buf += text;
+        return *this;
+    }
+
+public:
+    static const size_t CHUNK = 64 * 1024;
+
+    JsonWriter() { buf.reserve(4096); }
+    explicit JsonWriter(ostream &out) : sink(&out) { buf.reserve(CHUNK + CHUNK / 4); }
+    JsonWriter(const JsonWriter &) = delete;
+    JsonWriter &operator=(const JsonWriter &) = delete;
+    ~JsonWriter();
+
+    JsonWriter &beginObject()
+    {
+        separator();
+        buf += '{';
+        needComma.push_back(false);
+        return *this;
+    }
+    JsonWriter &endObject()
+    {
+        buf += '}';
+        needComma.pop_back();
+        spill();
+        return *this;
+    }
+    JsonWriter &beginArray()
+    {
+        separator();
+        buf += '[';
+        needComma.push_back(false);
+        return *this;
+    }
+    JsonWriter &endArray()
+    {
+        buf += ']';
+        needComma.pop_back();
+        spill();
+        return *this;
+    }
+    JsonWriter &key(const char *k)
+    {
+        separator();
+        buf += '"';
+        buf += k;
+        buf += "\":";
+        afterKey = true;
+        return *this;
+    }
+
+    JsonWriter &value(const char *s, size_t n);
+    JsonWriter &value(const string &s) { return value(s.data(), s.size()); }
+    JsonWriter &value(const char *s) { return value(s, char_traits<char>::length(s)); }
+    JsonWriter &value(int v);
+    JsonWriter &value(long long v);
+    JsonWriter &value(size_t v);
+    JsonWriter &value(double v);
+    JsonWriter &value(bool v) { return literal(v ? "true" : "false"); }
+    JsonWriter &null() { return literal("null"); }
+
+    template <typename T>
+    JsonWriter &field(const char *k, const T &v)
+    {
+        key(k);
+        return value(v);
+    }
+
+    void flush();
+    const string &str() const { return buf; }
+};
@@ -0,0 +1,426 @@
+#pragma once
+#include "HistoryStore.hpp"
+#include "Snapshot.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Message storage for one conversation, addressed by message id. Messages
+// live in fixed-size segments that are reserved up front and never
+// reallocate, so appends and deletes never move existing payloads. A delete
+// leaves a tombstone and releases the message's strings; the slot itself is
+// kept, since spilled segments are addressed by slot position on disk.
+//
+// Once attached to a HistoryStore, every sealed segment is spilled to disk.
+// Spilled segments are dropped from memory by trim() unless they are among
+// the newest RECENT_SEGMENTS, were among the last PAGED_SEGMENTS read back,
+// or hold a message for which isSticky(m) is true. at(), view(), find() and
+// lookup() read an evicted segment back on demand. Iteration and tail() only
+// visit resident messages.
+template <class T>
+class MessageLog
+{
+public:
+    static const size_t SEGMENT_SIZE = 256;
+    static const size_t RECENT_SEGMENTS = 2;
+    static const size_t PAGED_SEGMENTS = 2;
+    static const size_t NONE = (size_t)-1;
+
+private:
+    vector<vector<T>> segments;
+    vector<SegmentMeta> meta;
+    vector<uint8_t> resident;
+    vector<uint8_t> unreadable;
+    vector<uint8_t> dirty;
+    vector<size_t> recentlyLoaded;
+    unordered_map<int, size_t> slotOf;
+    size_t slots = 0;
+    size_t live = 0;
+    size_t spilled = 0;
+    int spilledHigh = 0;
+    HistoryStore *store = nullptr;
+    string name;
+
+    template <class Log, class Ref>
+    class Iter
+    {
+    private:
+        Log *log;
+        size_t slot;
+
+        void skipDead()
+        {
+            while (slot < log->slots && !(log->resident[slot / SEGMENT_SIZE] && log->isLive(slot)))
+                slot++;
+        }
+
+    public:
+        Iter(Log *l, size_t s) : log(l), slot(s) { skipDead(); }
+        Ref operator*() const { return log->entry(slot); }
+        Iter &operator++()
+        {
+            slot++;
+            skipDead();
+            return *this;
+        }
+        bool operator!=(const Iter &other) const { return slot != other.slot; }
+    };
+
+    T &entry(size_t slot)
+    {
+        dirty[slot / SEGMENT_SIZE] = 1;
+        return segments[slot / SEGMENT_SIZE][slot % SEGMENT_SIZE];
+    }
+    const T &entry(size_t slot) const { return segments[slot / SEGMENT_SIZE][slot % SEGMENT_SIZE]; }
+
+    void ensure(size_t seg)
+    {
+        if (!resident[seg])
+            load(seg);
+    }
+
+    // Whether an evicted segment can hold a live message with this id, judged
+    // from its metadata so that ids outside its range, or in a segment whose
+    // messages are all deleted, never cost a disk read.
+    bool mayHold(size_t seg, int id) const
+    {
+        const SegmentMeta &info = meta[seg];
+        if (id < info.minId || id > info.maxId)
+            return false;
+        return std::find(info.alive.begin(), info.alive.end(), 1) != info.alive.end();
+    }
+
+    size_t locate(int id)
+    {
+        auto it = slotOf.find(id);
+        if (it != slotOf.end())
+            return it->second;
+        if (spilled == 0 || id > spilledHigh)
+            return NONE;
+        for (size_t s = 0; s < spilled; s++)
+        {
+            if (resident[s] || !mayHold(s, id))
+                continue;
+            load(s);
+            it = slotOf.find(id);
+            if (it != slotOf.end())
+                return it->second;
+        }
+        return NONE;
+    }
+
+    void load(size_t seg)
+    {
+        vector<T> messages(SEGMENT_SIZE);
+        vector<uint8_t> onDisk(SEGMENT_SIZE, 0);
+        string payload;
+        bool ok = store && store->readSegment(name, seg, payload);
+        if (ok)
+        {
+            SnapshotReader r(payload.data(), payload.size());
+            ok = r.u32() == SEGMENT_SIZE;
+            for (size_t i = 0; i < SEGMENT_SIZE && ok; i++)
+                onDisk[i] = r.u8();
+            for (size_t i = 0; i < SEGMENT_SIZE && ok; i++)
+                if (onDisk[i])
+                    readRecord(r, messages[i]);
+            ok = ok && r.ok();
+        }
+        // A segment that cannot be read stays resident only as placeholders:
+        // its tombstones are kept for the manifest, isLive() hides its slots
+        // and writeSegment() refuses it, so the file survives until a later
+        // load, after trim() evicts it, can read it again.
+        if (!ok)
+        {
+            cerr << "[C++ Error] Cannot read history segment " << seg << " of " << name << endl;
+            segments[seg] = move(messages);
+            resident[seg] = 1;
+            unreadable[seg] = 1;
+            return;
+        }
+
+        // The file is authoritative: it may have been rewritten after the
+        // manifest that seeded this segment's tombstones.
+        vector<uint8_t> &alive = meta[seg].alive;
+        for (size_t i = 0; i < SEGMENT_SIZE; i++)
+        {
+            live = live - alive[i] + onDisk[i];
+            alive[i] = onDisk[i];
+            if (alive[i])
+                slotOf[messages[i].id] = seg * SEGMENT_SIZE + i;
+        }
+        segments[seg] = move(messages);
+        resident[seg] = 1;
+        dirty[seg] = 0;
+
+        recentlyLoaded.push_back(seg);
+        if (recentlyLoaded.size() > PAGED_SEGMENTS)
+            recentlyLoaded.erase(recentlyLoaded.begin());
+    }
+
+    void writeSegment(size_t seg)
+    {
+        if (unreadable[seg])
+            return;
+        SnapshotWriter w;
+        w.u32(SEGMENT_SIZE);
+        for (size_t i = 0; i < SEGMENT_SIZE; i++)
+            w.u8(meta[seg].alive[i]);
+        for (size_t i = 0; i < SEGMENT_SIZE; i++)
+            if (meta[seg].alive[i])
+                writeRecord(w, segments[seg][i]);
+        store->writeSegment(name, seg, w.bytes());
+        dirty[seg] = 0;
+    }
+
+    void evict(size_t seg)
+    {
+        if (dirty[seg])
+            writeSegment(seg);
+        for (size_t i = 0; i < segments[seg].size(); i++)
+            if (meta[seg].alive[i])
+                slotOf.erase(segments[seg][i].id);
+        vector<T>().swap(segments[seg]);
+        resident[seg] = 0;
+        unreadable[seg] = 0;
+    }
+
+    bool holdsSticky(size_t seg) const
+    {
+        for (size_t i = 0; i < segments[seg].size(); i++)
+            if (meta[seg].alive[i] && isSticky(segments[seg][i]))
+                return true;
+        return false;
+    }
+
+    // Writes every sealed segment that has not reached disk yet.
+    void spill()
+    {
+        for (; spilled + 1 < segments.size(); spilled++)
+        {
+            writeSegment(spilled);
+            spilledHigh = max(spilledHigh, meta[spilled].maxId);
+        }
+    }
+
+public:
+    using iterator = Iter<MessageLog, T &>;
+    using const_iterator = Iter<const MessageLog, const T &>;
+
+    struct Range
+    {
+        const_iterator first, last;
+        const_iterator begin() const { return first; }
+        const_iterator end() const { return last; }
+    };
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, slots); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, slots); }
+
+    // Messages that have not been spilled; these are always resident and are
+    // what the row files and the snapshot persist.
+    Range tail() const { return {const_iterator(this, spilled * SEGMENT_SIZE), end()}; }
+    size_t tailSize() const
+    {
+        size_t n = 0;
+        for (size_t s = spilled; s < meta.size(); s++)
+            n += count(meta[s].alive.begin(), meta[s].alive.end(), 1);
+        return n;
+    }
+
+    size_t size() const { return live; }
+    bool empty() const { return live == 0; }
+    size_t slotCount() const { return slots; }
+    bool isLive(size_t slot) const
+    {
+        return meta[slot / SEGMENT_SIZE].alive[slot % SEGMENT_SIZE] != 0 && !unreadable[slot / SEGMENT_SIZE];
+    }
+
+    T &at(size_t slot)
+    {
+        ensure(slot / SEGMENT_SIZE);
+        return entry(slot);
+    }
+
+    const T &view(size_t slot)
+    {
+        ensure(slot / SEGMENT_SIZE);
+        return segments[slot / SEGMENT_SIZE][slot % SEGMENT_SIZE];
+    }
+
+    T &append(T m)
+    {
+        if (slots % SEGMENT_SIZE == 0)
+        {
+            segments.emplace_back();
+            segments.back().reserve(SEGMENT_SIZE);
+            meta.emplace_back();
+            meta.back().alive.reserve(SEGMENT_SIZE);
+            meta.back().minId = meta.back().maxId = m.id;
+            resident.push_back(1);
+            unreadable.push_back(0);
+            dirty.push_back(1);
+            if (store)
+            {
+                spill();
+                trim();
+            }
+        }
+        SegmentMeta &info = meta.back();
+        info.minId = min(info.minId, m.id);
+        info.maxId = max(info.maxId, m.id);
+        info.alive.push_back(1);
+        slotOf[m.id] = slots;
+        segments.back().push_back(move(m));
+        slots++;
+        live++;
+        return segments.back().back();
+    }
+
+    // Replaces the message with the same id, or appends it.
+    T &put(T m)
+    {
+        T *existing = find(m.id);
+        if (!existing)
+            return append(move(m));
+        *existing = move(m);
+        return *existing;
+    }
+
+    T *find(int id)
+    {
+        size_t slot = locate(id);
+        return slot == NONE ? nullptr : &entry(slot);
+    }
+
+    const T *lookup(int id)
+    {
+        size_t slot = locate(id);
+        return slot == NONE ? nullptr : &segments[slot / SEGMENT_SIZE][slot % SEGMENT_SIZE];
+    }
+
+    bool erase(int id)
+    {
+        size_t slot = locate(id);
+        if (slot == NONE)
+            return false;
+        slotOf.erase(id);
+        meta[slot / SEGMENT_SIZE].alive[slot % SEGMENT_SIZE] = 0;
+        entry(slot) = T();
+        live--;
+        return true;
+    }
+
+    const T *back()
+    {
+        for (size_t s = slots; s-- > 0;)
+            if (isLive(s))
+                return &view(s);
+        return nullptr;
+    }
+
+    // Slots of one page counted back from the newest message: skips the
+    // `offset` newest live messages and returns up to `limit` slots, oldest first.
+    // Skipped segments are counted from their metadata; the segments holding
+    // the page are read in, and the page is recounted if a segment file turned
+    // out to have fewer live messages than the manifest said.
+    vector<size_t> page(size_t offset, size_t limit)
+    {
+        while (true)
+        {
+            vector<size_t> result;
+            size_t skip = offset;
+            size_t s = slots;
+            while (s > 0 && skip > 0)
+                if (isLive(--s))
+                    skip--;
+            while (s > 0 && result.size() < limit)
+                if (isLive(--s))
+                    result.push_back(s);
+
+            bool loaded = false;
+            for (size_t slot : result)
+                if (!resident[slot / SEGMENT_SIZE])
+                {
+                    load(slot / SEGMENT_SIZE);
+                    loaded = true;
+                }
+            if (!loaded)
+                return vector<size_t>(result.rbegin(), result.rend());
+        }
+    }
+
+    // Binds the log to its on-disk history and restores the segments the
+    // manifest lists for it. Must run before the first append.
+    void attach(HistoryStore *history, const string &logName)
+    {
+        if (store)
+            return;
+        store = history;
+        name = logName;
+        if (slots != 0)
+            return;
+        for (SegmentMeta &info : history->restore(name))
+        {
+            if (info.alive.size() != SEGMENT_SIZE)
+                break;
+            live += count(info.alive.begin(), info.alive.end(), 1);
+            spilledHigh = max(spilledHigh, info.maxId);
+            segments.emplace_back();
+            meta.push_back(move(info));
+            resident.push_back(0);
+            unreadable.push_back(0);
+            dirty.push_back(0);
+            slots += SEGMENT_SIZE;
+        }
+        spilled = segments.size();
+        for (size_t s = 0; s < spilled; s++)
+            if (meta[s].sticky)
+                load(s);
+    }
+
+    int highestId() const
+    {
+        int high = 0;
+        for (const SegmentMeta &info : meta)
+            high = max(high, info.maxId);
+        return high;
+    }
+
+    // Brings every spilled segment file up to date and returns the metadata
+    // the manifest needs for them.
+    vector<SegmentMeta> flush()
+    {
+        vector<SegmentMeta> listing;
+        if (!store)
+            return listing;
+        spill();
+        for (size_t s = 0; s < spilled; s++)
+        {
+            if (resident[s] && dirty[s])
+                writeSegment(s);
+            listing.push_back(meta[s]);
+            listing.back().sticky = resident[s] && holdsSticky(s);
+        }
+        return listing;
+    }
+
+    // Drops spilled segments nobody needs resident. Invalidates references
+    // into evicted segments, so callers run it once they are done reading.
+    void trim()
+    {
+        size_t recentFrom = segments.size() > RECENT_SEGMENTS ? segments.size() - RECENT_SEGMENTS : 0;
+        for (size_t s = 0; s < spilled && s < recentFrom; s++)
+            if (resident[s] && !holdsSticky(s) &&
+                std::find(recentlyLoaded.begin(), recentlyLoaded.end(), s) == recentlyLoaded.end())
+                evict(s);
+    }
+};
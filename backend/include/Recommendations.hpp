@@ -0,0 +1,39 @@
+#pragma once
+#include "FriendGraph.hpp"
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+struct UserRecommendation
+{
+    int id;
+    int score;
+    int degree;
+};
+
+struct CommunityRecommendation
+{
+    int id;
+    double score;
+};
+
+// Cached top-K results for one user; a stale half is recomputed (with the
+// other) on the next read of it. User results never read memberships, so
+// membership changes only mark the community half.
+struct RecommendationEntry
+{
+    vector<UserRecommendation> users;
+    vector<CommunityRecommendation> communities;
+    bool usersStale = true;
+    bool communitiesStale = true;
+};
+
+// Per-thread working memory so batch workers never share mutable state.
+struct RecommendationScratch
+{
+    BfsScratch bfs;
+    vector<double> communityScore;
+    vector<int> touched;
+    vector<pair<int, int>> candidates;
+};
@@ -0,0 +1,148 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+// data/snapshot.bin layout (little-endian, host byte order):
+//   "NOVASNAP" | u32 version | u32 reserved | u64 payloadSize | u64 checksum | payload
+// The payload holds users, adjacency, communities and DMs as length-prefixed
+// records; see NovaGraph::saveSnapshot for the field order. Each chat history
+// contributes only its unspilled tail; sealed segments live in data/history
+// (see HistoryStore).
+const char SNAPSHOT_MAGIC[8] = {'N', 'O', 'V', 'A', 'S', 'N', 'A', 'P'};
+const uint32_t SNAPSHOT_VERSION = 1;
+const size_t SNAPSHOT_HEADER_SIZE = 32;
+
+uint64_t snapshotChecksum(const char *data, size_t size);
+
+class MappedFile
+{
+private:
+    const char *bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mapHandle = nullptr;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const string &path);
+    void close();
+    const char *data() const { return bytes; }
+    size_t size() const { return length; }
+};
+
+class SnapshotWriter
+{
+private:
+    string buf;
+
+public:
+    void u8(uint8_t v) { buf.push_back((char)v); }
+    void u32(uint32_t v) { buf.append((const char *)&v, sizeof(v)); }
+    void i32(int32_t v) { buf.append((const char *)&v, sizeof(v)); }
+    void u64(uint64_t v) { buf.append((const char *)&v, sizeof(v)); }
+    void str(const string &s)
+    {
+        u32(s.size());
+        buf.append(s);
+    }
+    template <typename Ids>
+    void ids(const Ids &list)
+    {
+        u32(list.size());
+        for (int id : list)
+            i32(id);
+    }
+    void strs(const vector<string> &list)
+    {
+        u32(list.size());
+        for (const auto &s : list)
+            str(s);
+    }
+    string &bytes() { return buf; }
+};
+
+class SnapshotReader
+{
+private:
+    const char *pos;
+    const char *end;
+    bool valid = true;
+
+    bool take(void *out, size_t n)
+    {
+        if (!valid || (size_t)(end - pos) < n)
+        {
+            valid = false;
+            return false;
+        }
+        memcpy(out, pos, n);
+        pos += n;
+        return true;
+    }
+
+public:
+    SnapshotReader(const char *data, size_t size) : pos(data), end(data + size) {}
+
+    bool ok() const { return valid; }
+    uint8_t u8()
+    {
+        uint8_t v = 0;
+        take(&v, sizeof(v));
+        return v;
+    }
+    uint32_t u32()
+    {
+        uint32_t v = 0;
+        take(&v, sizeof(v));
+        return v;
+    }
+    int32_t i32()
+    {
+        int32_t v = 0;
+        take(&v, sizeof(v));
+        return v;
+    }
+    uint64_t u64()
+    {
+        uint64_t v = 0;
+        take(&v, sizeof(v));
+        return v;
+    }
+    string str()
+    {
+        uint32_t n = u32();
+        if (!valid || (size_t)(end - pos) < n)
+        {
+            valid = false;
+            return "";
+        }
+        string s(pos, n);
+        pos += n;
+        return s;
+    }
+    template <typename Ids>
+    void ids(Ids &out)
+    {
+        uint32_t n = u32();
+        for (uint32_t i = 0; i < n && valid; i++)
+            out.insert(out.end(), i32());
+    }
+    vector<string> strs()
+    {
+        vector<string> list;
+        uint32_t n = u32();
+        for (uint32_t i = 0; i < n && valid; i++)
+            list.push_back(str());
+        return list;
+    }
+};
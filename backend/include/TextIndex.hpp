@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Distinct terms of a text, sorted: runs of ASCII letters/digits
+// (lower-cased) and non-ASCII bytes, of any length.
+vector<string> splitTerms(const string &text);
+
+// Whether a term is long enough, and short enough, to be indexed (2 to 40 bytes).
+bool isIndexedTerm(const string &term);
+
+// The terms of a text that the index stores.
+vector<string> tokenize(const string &text);
+
+// A query is only searched if at least one of its terms is indexed; the
+// others are checked against the messages that term matches.
+bool hasIndexedTerm(const string &query);
+
+// Message ids holding one term, ascending, stored as varint-encoded gaps.
+struct Posting
+{
+    string gaps;
+    int last = 0;
+};
+
+// Inverted index over the messages of one conversation. It is built on the
+// first search (see NovaGraph::searchIndex) and then kept current by every
+// append and delete; until then add/remove are no-ops.
+class TextIndex
+{
+private:
+    unordered_map<string, Posting> terms;
+    bool built = false;
+
+public:
+    bool ready() const { return built; }
+    void markReady() { built = true; }
+
+    void add(int id, const string &text);
+    void remove(int id, const string &text);
+
+    // Ids of messages containing every indexed term of the query, newest
+    // first. Terms the index does not store are not checked here; callers
+    // verify them against the rows (see searchLog in Graph.cpp).
+    vector<int> search(const string &query, size_t limit) const;
+};
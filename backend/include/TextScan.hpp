@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+
+// Vectorized byte scans used on every serialized string. Each kernel picks
+// AVX2 or SSE2 at startup on x86 and falls back to a scalar loop elsewhere.
+
+// Index of the first byte that JSON requires escaping (< 0x20, '"' or '\\'), or n.
+size_t findJsonEscape(const char *s, size_t n);
+
+// Replaces '\n', '\r' and '|' with ' ' in place, in a single pass.
+void replaceSeparators(char *s, size_t n);
+
+// "avx2", "sse2" or "scalar".
+const char *textScanKernel();
@@ -0,0 +1,67 @@
+#pragma once
+#include "User.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// ASCII lower-casing, the same folding searchUsersJSON has always applied.
+string foldCase(string s);
+
+// True if `folded` (already lower-cased) occurs in `text` ignoring ASCII case.
+bool containsFolded(const string &text, const string &folded);
+
+// Search postings kept current by NovaGraph on every user insert, update
+// and delete. Each list holds user IDs in ascending order, so results come
+// out in the same order as a walk over userDB.
+//   grams: every distinct 3-byte window of the lower-cased username
+//   tags:  exact tag -> users carrying it
+class UserIndex
+{
+private:
+    unordered_map<uint32_t, vector<int>> grams;
+    unordered_map<string, vector<int>> tags;
+
+public:
+    void add(const User &u);
+    void remove(const User &u);
+    void clear();
+
+    // Appends the posting list of every trigram of `folded`. Their
+    // intersection is a superset of the users whose name contains `folded`;
+    // callers confirm with containsFolded. False if some trigram has no users.
+    bool postings(const string &folded, vector<const vector<int> *> &lists) const;
+    const vector<int> *tagged(const string &tag) const;
+};
+
+// Calls visit(id) for each ID present in every list, in ascending order,
+// until visit returns false. The shortest list drives the walk and the
+// others are probed with forward-only cursors.
+template <class Visit>
+void intersectPostings(vector<const vector<int> *> lists, Visit visit)
+{
+    if (lists.empty())
+        return;
+    sort(lists.begin(), lists.end(), [](const vector<int> *a, const vector<int> *b)
+         { return a->size() < b->size(); });
+    vector<vector<int>::const_iterator> cursors;
+    for (const vector<int> *list : lists)
+        cursors.push_back(list->begin());
+
+    for (int id : *lists[0])
+    {
+        bool everywhere = true;
+        for (size_t i = 1; i < lists.size() && everywhere; i++)
+        {
+            cursors[i] = lower_bound(cursors[i], lists[i]->end(), id);
+            if (cursors[i] == lists[i]->end())
+                return;
+            everywhere = *cursors[i] == id;
+        }
+        if (everywhere && !visit(id))
+            return;
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+
+using namespace std;
+
+struct LogRecord
+{
+    string type;
+    string row;
+};
+
+class WriteAheadLog
+{
+private:
+    string path;
+    ofstream file;
+    size_t bytes = 0;
+
+public:
+    void open(const string &logPath);
+    vector<LogRecord> readAll();
+    void append(const string &type, const string &row);
+    void reset();
+    size_t size() const { return bytes; }
+};
@@ -1 +1 @@
-g++ -std=c++17 src/*.cpp -I include -o backend.exe
\ No newline at end of file
+g++ -std=c++17 -pthread src/*.cpp -I include -o backend.exe
\ No newline at end of file
@@ -0,0 +1,387 @@
+#include "../include/Graph.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+using namespace std;
+
+const double PAGERANK_DAMPING = 0.85;
+const double PAGERANK_TOLERANCE = 1e-9;
+const int PAGERANK_MAX_ROUNDS = 100;
+const int LABEL_MAX_ROUNDS = 20;
+
+int GraphAnalytics::slotOf(int userId) const
+{
+    auto it = lower_bound(ids.begin(), ids.end(), userId);
+    if (it == ids.end() || *it != userId)
+        return -1;
+    return it - ids.begin();
+}
+
+// Calls fn(begin, end) over [0, n) in CHUNK-sized ranges claimed by `threads`
+// workers, the same scheme precomputeRecommendations uses. Every kernel below
+// writes only to slots of its own range, so results do not depend on timing.
+template <class Fn>
+void parallelFor(int n, int threads, Fn fn)
+{
+    const int CHUNK = 256;
+    atomic<int> next(0);
+    auto worker = [&]()
+    {
+        for (int start = next.fetch_add(CHUNK); start < n; start = next.fetch_add(CHUNK))
+            fn(start, min(n, start + CHUNK));
+    };
+    vector<thread> pool;
+    for (int t = 1; t < threads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for (thread &t : pool)
+        t.join();
+}
+
+// Lock-free union-find: roots are only ever linked under a smaller root, so
+// parents decrease along every path and each component ends up rooted at its
+// smallest slot whatever order the unions ran in.
+int findRoot(vector<atomic<int>> &parent, int v)
+{
+    while (true)
+    {
+        int p = parent[v].load();
+        if (p == v)
+            return v;
+        int gp = parent[p].load();
+        if (gp != p)
+            parent[v].compare_exchange_weak(p, gp);
+        v = gp;
+    }
+}
+
+void unite(vector<atomic<int>> &parent, int a, int b)
+{
+    while (true)
+    {
+        a = findRoot(parent, a);
+        b = findRoot(parent, b);
+        if (a == b)
+            return;
+        if (a < b)
+            swap(a, b);
+        int expected = a;
+        if (parent[a].compare_exchange_strong(expected, b))
+            return;
+    }
+}
+
+void findComponents(const FriendGraph &g, int threads, GraphAnalytics &out)
+{
+    int n = g.size();
+    vector<atomic<int>> parent(n);
+    parallelFor(n, threads, [&](int begin, int end)
+                {
+                    for (int v = begin; v < end; v++)
+                        parent[v].store(v); });
+    parallelFor(n, threads, [&](int begin, int end)
+                {
+                    for (int v = begin; v < end; v++)
+                        for (const int *p = g.begin(v), *e = g.end(v); p != e; ++p)
+                            if (*p > v)
+                                unite(parent, v, *p); });
+    out.component.assign(n, 0);
+    parallelFor(n, threads, [&](int begin, int end)
+                {
+                    for (int v = begin; v < end; v++)
+                        out.component[v] = findRoot(parent, v); });
+    out.componentSize.assign(n, 0);
+    out.componentCount = 0;
+    for (int v = 0; v < n; v++)
+        if (out.componentSize[out.component[v]]++ == 0)
+            out.componentCount++;
+}
+
+// Pull-style power iteration. Rank held by users without friends is spread
+// evenly, so the scores always sum to 1.
+void rankUsers(const FriendGraph &g, int threads, GraphAnalytics &out)
+{
+    int n = g.size();
+    out.pageRank.assign(n, n ? 1.0 / n : 0.0);
+    vector<double> share(n), next(n);
+    for (int round = 0; round < PAGERANK_MAX_ROUNDS && n; round++)
+    {
+        double dangling = 0;
+        for (int v = 0; v < n; v++)
+        {
+            int d = g.degree(v);
+            share[v] = d ? out.pageRank[v] / d : 0.0;
+            if (!d)
+                dangling += out.pageRank[v];
+        }
+        double base = (1.0 - PAGERANK_DAMPING + PAGERANK_DAMPING * dangling) / n;
+        parallelFor(n, threads, [&](int begin, int end)
+                    {
+                        for (int v = begin; v < end; v++)
+                        {
+                            double sum = 0;
+                            for (const int *p = g.begin(v), *e = g.end(v); p != e; ++p)
+                                sum += share[*p];
+                            next[v] = base + PAGERANK_DAMPING * sum;
+                        } });
+        double delta = 0;
+        for (int v = 0; v < n; v++)
+            delta += fabs(next[v] - out.pageRank[v]);
+        out.pageRank.swap(next);
+        if (delta < PAGERANK_TOLERANCE)
+            break;
+    }
+}
+
+// Each triangle through v is seen once from each of its two other corners.
+void countTriangles(const FriendGraph &g, int threads, GraphAnalytics &out)
+{
+    int n = g.size();
+    out.triangles.assign(n, 0);
+    out.clustering.assign(n, 0.0);
+    parallelFor(n, threads, [&](int begin, int end)
+                {
+                    for (int v = begin; v < end; v++)
+                    {
+                        long long twice = 0;
+                        for (const int *p = g.begin(v), *e = g.end(v); p != e; ++p)
+                            twice += g.commonNeighbors(v, *p);
+                        long long d = g.degree(v);
+                        out.triangles[v] = twice / 2;
+                        if (d > 1)
+                            out.clustering[v] = (double)twice / (d * (d - 1));
+                    } });
+}
+
+// Synchronous label propagation: every user takes the label most common among
+// itself and its friends, the smallest on a tie, until labels settle or
+// LABEL_MAX_ROUNDS have run. Counting the user's own label keeps two friends
+// from endlessly swapping labels.
+void propagateLabels(const FriendGraph &g, int threads, GraphAnalytics &out)
+{
+    int n = g.size();
+    vector<int> label(n), next(n);
+    for (int v = 0; v < n; v++)
+        label[v] = v;
+    for (int round = 0; round < LABEL_MAX_ROUNDS; round++)
+    {
+        atomic<int> changed(0);
+        parallelFor(n, threads, [&](int begin, int end)
+                    {
+                        vector<int> seen;
+                        int moved = 0;
+                        for (int v = begin; v < end; v++)
+                        {
+                            seen.assign(1, label[v]);
+                            for (const int *p = g.begin(v), *e = g.end(v); p != e; ++p)
+                                seen.push_back(label[*p]);
+                            sort(seen.begin(), seen.end());
+                            int best = label[v], bestCount = 0;
+                            for (size_t i = 0, j; i < seen.size(); i = j)
+                            {
+                                for (j = i; j < seen.size() && seen[j] == seen[i]; j++)
+                                    ;
+                                if ((int)(j - i) > bestCount)
+                                {
+                                    best = seen[i];
+                                    bestCount = j - i;
+                                }
+                            }
+                            next[v] = best;
+                            if (next[v] != label[v])
+                                moved++;
+                        }
+                        changed += moved; });
+        label.swap(next);
+        if (changed.load() == 0)
+            break;
+    }
+    out.cluster = move(label);
+    out.clusterSize.assign(n, 0);
+    out.clusterCount = 0;
+    for (int v = 0; v < n; v++)
+        if (out.clusterSize[out.cluster[v]]++ == 0)
+            out.clusterCount++;
+}
+
+void computeAnalytics(const FriendGraph &g, const vector<vector<int>> &memberships,
+                      const vector<int> &communityIds, int threads, GraphAnalytics &out)
+{
+    auto start = chrono::steady_clock::now();
+    if (threads <= 0)
+        threads = max(1u, thread::hardware_concurrency());
+    int n = g.size();
+    out.ids.resize(n);
+    for (int v = 0; v < n; v++)
+        out.ids[v] = g.idAt(v);
+    out.edges = g.edgeCount();
+
+    findComponents(g, threads, out);
+    rankUsers(g, threads, out);
+    countTriangles(g, threads, out);
+    propagateLabels(g, threads, out);
+
+    vector<double> influence(communityIds.size(), 0.0);
+    for (int v = 0; v < n && v < (int)memberships.size(); v++)
+        for (int c : memberships[v])
+            influence[c] += out.pageRank[v];
+    out.communityInfluence.clear();
+    for (size_t c = 0; c < communityIds.size(); c++)
+        out.communityInfluence.push_back({communityIds[c], influence[c]});
+    sort(out.communityInfluence.begin(), out.communityInfluence.end(), [](const pair<int, double> &a, const pair<int, double> &b)
+         { return a.second != b.second ? a.second > b.second : a.first < b.first; });
+
+    out.threads = threads;
+    out.computed = true;
+    out.ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+}
+
+const GraphAnalytics &NovaGraph::refreshAnalytics(int threads)
+{
+    AnalyticsInput input = analyticsInput();
+    GraphAnalytics result;
+    computeAnalytics(input.graph, input.memberships, input.communityIds, threads, result);
+    installAnalytics(result, input);
+    return analytics;
+}
+
+bool NovaGraph::analyticsDue() const
+{
+    if (!analytics.computed)
+        return true;
+    size_t pending = graphChanges - analytics.changeSeq;
+    return pending >= ANALYTICS_REFRESH_CHANGES ||
+           (pending > 0 && chrono::steady_clock::now() - analyticsRunAt >= chrono::seconds(ANALYTICS_REFRESH_SECONDS));
+}
+
+AnalyticsInput NovaGraph::analyticsInput()
+{
+    prepareRecommendations();
+    AnalyticsInput input;
+    input.graph = friendGraph;
+    input.memberships = recMemberships;
+    input.communityIds = recCommunityIds;
+    input.changeSeq = graphChanges;
+    return input;
+}
+
+// Keeps whichever result saw more changes, so a run that finishes after a
+// newer one (compute_analytics during a background run) is dropped.
+void NovaGraph::installAnalytics(GraphAnalytics &result, const AnalyticsInput &input)
+{
+    analyticsRunAt = chrono::steady_clock::now();
+    if (analytics.computed && input.changeSeq < analytics.changeSeq)
+        return;
+    analytics = move(result);
+    analytics.graphVersion = input.graph.version();
+    analytics.changeSeq = input.changeSeq;
+    // User recommendation scores read the analytics, so every cached list is now out of date.
+    for (auto &[id, entry] : recCache)
+        entry.usersStale = true;
+}
+
+// Readers get the last result even while the graph has moved on. Serve mode
+// runs every refresh in the background (see analyticsDue), so until the
+// first one lands readers see an empty result flagged stale; otherwise it is
+// computed on first use, and compute_analytics refreshes it on demand.
+const GraphAnalytics &NovaGraph::analyticsView()
+{
+    if (!analytics.computed && !analyticsInBackground)
+        refreshAnalytics();
+    return analytics;
+}
+
+bool NovaGraph::analyticsStale()
+{
+    return !analytics.computed || analytics.changeSeq != graphChanges;
+}
+
+void NovaGraph::getUserAnalyticsJSON(JsonWriter &json, int userId)
+{
+    const GraphAnalytics &a = analyticsView();
+    int s = userDB.count(userId) ? a.slotOf(userId) : -1;
+    json.beginObject().field("id", userId);
+    if (s < 0)
+    {
+        json.field("component", userId)
+            .field("component_size", 1)
+            .field("influence", 0.0)
+            .field("triangles", 0)
+            .field("clustering", 0.0)
+            .field("cluster", userId)
+            .field("cluster_size", 1);
+    }
+    else
+    {
+        json.field("component", a.ids[a.component[s]])
+            .field("component_size", a.componentSize[a.component[s]])
+            .field("influence", a.pageRank[s] * a.ids.size())
+            .field("triangles", a.triangles[s])
+            .field("clustering", a.clustering[s])
+            .field("cluster", a.ids[a.cluster[s]])
+            .field("cluster_size", a.clusterSize[a.cluster[s]]);
+    }
+    json.field("stale", analyticsStale()).endObject();
+}
+
+// Influence is PageRank scaled by the user count, so 1 is an average user.
+void NovaGraph::getGraphStatsJSON(JsonWriter &json, size_t top)
+{
+    const GraphAnalytics &a = analyticsView();
+    int n = a.ids.size();
+    long long triangleSum = 0;
+    double clusteringSum = 0;
+    for (int v = 0; v < n; v++)
+    {
+        triangleSum += a.triangles[v];
+        clusteringSum += a.clustering[v];
+    }
+    vector<int> slots(n);
+    for (int v = 0; v < n; v++)
+        slots[v] = v;
+    size_t k = min(top, slots.size());
+    partial_sort(slots.begin(), slots.begin() + k, slots.end(), [&](int x, int y)
+                 { return a.pageRank[x] != a.pageRank[y] ? a.pageRank[x] > a.pageRank[y] : x < y; });
+
+    json.beginObject()
+        .field("users", n)
+        .field("edges", a.edges)
+        .field("components", a.componentCount)
+        .field("largest_component", n ? *max_element(a.componentSize.begin(), a.componentSize.end()) : 0)
+        .field("clusters", a.clusterCount)
+        .field("largest_cluster", n ? *max_element(a.clusterSize.begin(), a.clusterSize.end()) : 0)
+        .field("triangles", triangleSum / 3)
+        .field("avg_clustering", n ? clusteringSum / n : 0.0)
+        .key("top_users")
+        .beginArray();
+    for (size_t i = 0; i < k; i++)
+    {
+        int id = a.ids[slots[i]];
+        auto user = userDB.find(id);
+        json.beginObject()
+            .field("id", id)
+            .field("name", user == userDB.end() ? string() : user->second.username)
+            .field("influence", a.pageRank[slots[i]] * n)
+            .endObject();
+    }
+    json.endArray().key("top_communities").beginArray();
+    size_t shown = 0;
+    for (auto const &[id, score] : a.communityInfluence)
+    {
+        if (shown >= top)
+            break;
+        auto it = communityDB.find(id);
+        if (it == communityDB.end())
+            continue;
+        json.beginObject().field("id", id).field("name", it->second.name).field("influence", score * n).endObject();
+        shown++;
+    }
+    json.endArray()
+        .field("threads", a.threads)
+        .field("ms", a.ms)
+        .field("stale", analyticsStale())
+        .endObject();
+}
@@ -0,0 +1,114 @@
+#include "../include/BlobStore.hpp"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+#include <cctype>
+#include <vector>
+
+using namespace std;
+
+const string BlobStore::REF_PREFIX = "blobref:";
+
+// The media types the app uploads. The bridge serves blobs with their declared
+// type, so anything that a browser would render as a document (text/html,
+// image/svg+xml, ...) must never be stored.
+const vector<string> MEDIA_TYPES = {"image/png", "image/jpeg", "image/gif", "image/webp", "image/bmp", "image/avif",
+                                    "audio/webm", "audio/ogg", "audio/mpeg", "audio/mp4", "audio/wav"};
+
+// FNV-1a of the payload plus its length. The hash is not collision resistant,
+// so put() confirms a match byte for byte and on a clash moves on to the next
+// attempt, which seeds the hash differently.
+string blobKey(const string &payload, uint32_t attempt)
+{
+    uint64_t hash = 1469598103934665603ULL;
+    for (int shift = 0; attempt && shift < 32; shift += 8)
+    {
+        hash ^= (attempt >> shift) & 0xff;
+        hash *= 1099511628211ULL;
+    }
+    for (unsigned char c : payload)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    char buffer[40];
+    snprintf(buffer, sizeof(buffer), "%016llx%08llx", (unsigned long long)hash, (unsigned long long)payload.size());
+    return string(buffer);
+}
+
+void BlobStore::open(const string &directory)
+{
+    dir = directory;
+    filesystem::create_directories(dir);
+}
+
+string BlobStore::put(const string &payload)
+{
+    for (uint32_t attempt = 0;; attempt++)
+    {
+        string key = blobKey(payload, attempt);
+        string path = dir + "/" + key;
+        if (filesystem::exists(path))
+        {
+            string stored;
+            if (get(key, stored) && stored == payload)
+                return REF_PREFIX + key;
+            continue;
+        }
+        {
+            ofstream out(path + ".tmp", ios::binary);
+            out.write(payload.data(), payload.size());
+        }
+#ifdef _WIN32
+        remove(path.c_str());
+#endif
+        rename((path + ".tmp").c_str(), path.c_str());
+        return REF_PREFIX + key;
+    }
+}
+
+string BlobStore::intern(const string &value)
+{
+    if (value.rfind("data:", 0) != 0)
+        return value;
+    if (!isAllowedMedia(value))
+        return "";
+    return put(value);
+}
+
+bool BlobStore::get(const string &key, string &payload) const
+{
+    if (!isValidKey(key))
+        return false;
+    ifstream in(dir + "/" + key, ios::binary);
+    if (!in.is_open())
+        return false;
+    stringstream buffer;
+    buffer << in.rdbuf();
+    payload = buffer.str();
+    return true;
+}
+
+bool BlobStore::isAllowedMedia(const string &dataUri)
+{
+    size_t end = dataUri.find_first_of(";,", 5);
+    if (end == string::npos)
+        return false;
+    string type = dataUri.substr(5, end - 5);
+    for (char &c : type)
+        c = tolower((unsigned char)c);
+    return find(MEDIA_TYPES.begin(), MEDIA_TYPES.end(), type) != MEDIA_TYPES.end();
+}
+
+bool BlobStore::isValidKey(const string &key)
+{
+    if (key.size() != 24)
+        return false;
+    for (char c : key)
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+            return false;
+    return true;
+}
@@ -0,0 +1,509 @@
+#include "../include/Commands.hpp"
+#include <fstream>
+#include <sstream>
+#include <chrono>
+
+using namespace std;
+
+// One-shot CLI calls may pass a large media argument as FILE:<path>. Serve
+// frames carry the bytes themselves, and their arguments come from clients,
+// so there the argument is always taken literally.
+string resolveArg(const vector<string> &args, int index)
+{
+    const string &arg = args[index];
+    if (args[0] != "serve" && arg.rfind("FILE:", 0) == 0)
+    {
+        string path = arg.substr(5);
+        ifstream file(path, ios::binary);
+        if (file.is_open())
+        {
+            stringstream buffer;
+            buffer << file.rdbuf();
+            return buffer.str();
+        }
+        else
+        {
+            cerr << "[C++ Error] Failed to open temp file: " << path << endl;
+        }
+    }
+    return arg;
+}
+
+int runCommand(NovaGraph &graph, const vector<string> &args, ostream &out)
+{
+    int argc = args.size();
+    if (argc < 2)
+    {
+        out << "{ \"error\": \"No command provided\" }" << endl;
+        return 1;
+    }
+    string command = args[1];
+
+    if (command == "register")
+    {
+        if (argc < 7)
+        {
+            out << "{ \"error\": \"Missing args\" }" << endl;
+            return 1;
+        }
+        int newId = graph.registerUser(args[2], args[3], args[4], args[5], args[6]);
+        if (newId == -1)
+            out << "{ \"error\": \"Username taken\" }" << endl;
+        else
+            out << "{ \"id\": " << newId << ", \"status\": \"success\" }" << endl;
+    }
+    else if (command == "login")
+    {
+        if (argc < 4)
+        {
+            out << "{ \"error\": \"Missing args\" }" << endl;
+            return 1;
+        }
+        int id = graph.loginUser(args[2], args[3]);
+        if (id == -1)
+            out << "{ \"error\": \"Invalid credentials\" }" << endl;
+        else
+            out << "{ \"id\": " << id << ", \"status\": \"success\" }" << endl;
+    }
+    else if (command == "get_user")
+    {
+        if (argc < 3)
+            return 1;
+        JsonWriter json(out);
+        graph.getUserJSON(json, stoi(args[2]));
+    }
+    else if (command == "update_profile")
+    {
+        if (argc < 6)
+            return 1;
+        graph.updateUserProfile(stoi(args[2]), args[3], args[4], args[5]);
+        out << "{ \"status\": \"updated\" }" << endl;
+    }
+    else if (command == "delete_user")
+    {
+        if (argc < 3)
+            return 1;
+        graph.deleteUser(stoi(args[2]));
+        out << "{ \"status\": \"deleted\" }" << endl;
+    }
+    else if (command == "send_request")
+    {
+        if (argc < 4)
+            return 1;
+        string status = graph.sendConnectionRequest(stoi(args[2]), stoi(args[3]));
+        out << "{ \"status\": \"" << status << "\" }" << endl;
+    }
+    else if (command == "accept_request")
+    {
+        if (argc < 4)
+            return 1;
+        graph.acceptConnectionRequest(stoi(args[2]), stoi(args[3]));
+        out << "{ \"status\": \"accepted\" }" << endl;
+    }
+    else if (command == "decline_request")
+    {
+        if (argc < 4)
+            return 1;
+        graph.declineConnectionRequest(stoi(args[2]), stoi(args[3]));
+        out << "{ \"status\": \"declined\" }" << endl;
+    }
+    else if (command == "get_pending_requests")
+    {
+        if (argc < 3)
+            return 1;
+        JsonWriter json(out);
+        graph.getPendingRequestsJSON(json, stoi(args[2]));
+    }
+    else if (command == "get_relationship")
+    {
+        if (argc < 4)
+            return 1;
+        out << "{ \"status\": \"" << graph.getRelationshipStatus(stoi(args[2]), stoi(args[3])) << "\" }" << endl;
+    }
+    else if (command == "get_relation")
+    {
+        if (argc < 4)
+            return 1;
+        out << "{ \"degree\": " << graph.getRelationDegree(stoi(args[2]), stoi(args[3])) << " }" << endl;
+    }
+    else if (command == "get_relations")
+    {
+        if (argc < 3)
+            return 1;
+        vector<int> targets;
+        for (int i = 3; i < argc; i++)
+            targets.push_back(stoi(args[i]));
+        vector<int> degrees = graph.getRelationDegrees(stoi(args[2]), targets);
+        JsonWriter json(out);
+        json.beginArray();
+        for (size_t i = 0; i < targets.size(); i++)
+            json.beginObject().field("id", targets[i]).field("degree", degrees[i]).endObject();
+        json.endArray();
+    }
+    else if (command == "get_friends")
+    {
+        if (argc < 3)
+            return 1;
+        JsonWriter json(out);
+        graph.getFriendListJSON(json, stoi(args[2]));
+    }
+    else if (command == "create_community")
+    {
+        if (argc < 7)
+            return 1;
+        graph.createCommunity(args[2], args[3], args[4], stoi(args[5]), args[6]);
+        out << "{ \"status\": \"success\" }" << endl;
+    }
+    else if (command == "get_all_communities")
+    {
+        JsonWriter json(out);
+        graph.getAllCommunitiesJSON(json);
+    }
+    else if (command == "join_community")
+    {
+        if (argc < 4)
+            return 1;
+        graph.joinCommunity(stoi(args[2]), stoi(args[3]));
+        out << "{ \"status\": \"joined\" }" << endl;
+    }
+    else if (command == "leave_community")
+    {
+        if (argc < 4)
+            return 1;
+        graph.leaveCommunity(stoi(args[2]), stoi(args[3]));
+        out << "{ \"status\": \"left\" }" << endl;
+    }
+    else if (command == "get_community")
+    {
+        if (argc < 4)
+            return 1;
+        int offset = (argc > 4) ? stoi(args[4]) : 0;
+        int limit = (argc > 5) ? stoi(args[5]) : 50;
+        JsonWriter json(out);
+        graph.getCommunityDetailsJSON(json, stoi(args[2]), stoi(args[3]), offset, limit);
+    }
+    else if (command == "sync_community")
+    {
+        if (argc < 6)
+            return 1;
+        JsonWriter json(out);
+        graph.getCommunitySyncJSON(json, stoi(args[2]), stoi(args[3]), args[4], stoi(args[5]));
+    }
+    else if (command == "search_messages")
+    {
+        if (argc < 5)
+            return 1;
+        size_t limit = (argc > 5) ? stoul(args[5]) : 50;
+        if (!hasIndexedTerm(args[4]))
+        {
+            out << "{ \"error\": \"Search needs a word of 2 to 40 characters\" }" << endl;
+            return 0;
+        }
+        JsonWriter json(out);
+        graph.searchCommunityMessagesJSON(json, stoi(args[2]), stoi(args[3]), args[4], limit);
+    }
+    else if (command == "get_community_members")
+    {
+        if (argc < 3)
+            return 1;
+        JsonWriter json(out);
+        graph.getCommunityMembersJSON(json, stoi(args[2]));
+    }
+    else if (command == "send_message")
+    {
+        if (argc < 8)
+            return 1;
+
+        int replyId = stoi(args[4]);
+        string type = args[5];
+        string mediaUrl = resolveArg(args, 6);
+        string content = args[7];
+
+        for (int i = 8; i < argc; ++i)
+            content += " " + args[i];
+
+        graph.addMessage(stoi(args[2]), stoi(args[3]), content, type, mediaUrl, replyId);
+        out << "{ \"status\": \"sent\" }" << endl;
+    }
+    else if (command == "convert_snapshot")
+    {
+        graph.convertToSnapshot();
+        out << "{ \"status\": \"converted\" }" << endl;
+    }
+    else if (command == "precompute_recs")
+    {
+        int threads = argc > 2 ? stoi(args[2]) : 0;
+        auto start = chrono::steady_clock::now();
+        int users = graph.precomputeRecommendations(threads);
+        long long ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+        JsonWriter json(out);
+        json.beginObject().field("status", "success").field("users", users).field("ms", ms).endObject();
+    }
+    else if (command == "compute_analytics")
+    {
+        int threads = argc > 2 ? stoi(args[2]) : 0;
+        const GraphAnalytics &a = graph.refreshAnalytics(threads);
+        JsonWriter json(out);
+        json.beginObject()
+            .field("status", "success")
+            .field("users", a.ids.size())
+            .field("threads", a.threads)
+            .field("ms", a.ms)
+            .endObject();
+    }
+    else if (command == "get_user_analytics")
+    {
+        if (argc < 3)
+            return 1;
+        JsonWriter json(out);
+        graph.getUserAnalyticsJSON(json, stoi(args[2]));
+    }
+    else if (command == "get_graph_stats")
+    {
+        size_t top = (argc > 2) ? stoul(args[2]) : 10;
+        JsonWriter json(out);
+        graph.getGraphStatsJSON(json, top);
+    }
+    else if (command == "get_blob")
+    {
+        if (argc < 3)
+            return 1;
+        JsonWriter json(out);
+        graph.getBlobJSON(json, args[2]);
+    }
+    else if (command == "search_users")
+    {
+        string q = (argc > 2) ? args[2] : "";
+        string t = (argc > 3) ? args[3] : "All";
+        size_t limit = (argc > 4) ? stoul(args[4]) : 0;
+        JsonWriter json(out);
+        graph.searchUsersJSON(json, q, t, limit);
+    }
+    else if (command == "remove_friend")
+    {
+        if (argc < 4)
+            return 1;
+        graph.removeFriendship(stoi(args[2]), stoi(args[3]));
+        out << "{ \"status\": \"removed\" }" << endl;
+    }
+    else if (command == "get_popular")
+    {
+        string order = (argc > 2) ? args[2] : "members";
+        size_t limit = (argc > 3) ? stoul(args[3]) : 5;
+        JsonWriter json(out);
+        graph.getPopularCommunitiesJSON(json, order, limit);
+    }
+    else if (command == "get_visual_graph")
+    {
+        int afterId = (argc > 2) ? stoi(args[2]) : 0;
+        size_t limit = (argc > 3) ? stoul(args[3]) : 0;
+        JsonWriter json(out);
+        graph.getGraphVisualJSON(json, afterId, limit);
+    }
+    else if (command == "get_ego_graph")
+    {
+        if (argc < 3)
+            return 1;
+        int hops = (argc > 3) ? stoi(args[3]) : 2;
+        size_t maxNodes = (argc > 4) ? stoul(args[4]) : 300;
+        bool sample = (argc > 5) && args[5] == "1";
+        JsonWriter json(out);
+        graph.getEgoGraphJSON(json, stoi(args[2]), hops, maxNodes, sample);
+    }
+    else if (command == "vote_message")
+    {
+        if (argc < 5)
+            return 1;
+        graph.upvoteMessage(stoi(args[2]), stoi(args[3]), stoi(args[4]));
+        out << "{ \"status\": \"voted\" }" << endl;
+    }
+    else if (command == "mod_ban")
+    {
+        if (argc < 5)
+            return 1;
+        graph.banUser(stoi(args[2]), stoi(args[3]), stoi(args[4]));
+        out << "{ \"status\": \"banned\" }" << endl;
+    }
+    else if (command == "mod_unban")
+    {
+        if (argc < 5)
+            return 1;
+        graph.unbanUser(stoi(args[2]), stoi(args[3]), stoi(args[4]));
+        out << "{ \"status\": \"unbanned\" }" << endl;
+    }
+    else if (command == "mod_delete")
+    {
+        if (argc < 5)
+            return 1;
+        graph.deleteMessage(stoi(args[2]), stoi(args[3]), stoi(args[4]));
+        out << "{ \"status\": \"deleted\" }" << endl;
+    }
+    else if (command == "mod_pin")
+    {
+        if (argc < 5)
+            return 1;
+        graph.pinMessage(stoi(args[2]), stoi(args[3]), stoi(args[4]));
+        out << "{ \"status\": \"pinned\" }" << endl;
+    }
+    else if (command == "mod_promote_admin")
+    {
+        if (argc < 5)
+            return 1;
+        graph.promoteToAdmin(stoi(args[2]), stoi(args[3]), stoi(args[4]));
+        out << "{ \"status\": \"promoted\" }" << endl;
+    }
+    else if (command == "mod_demote_admin")
+    {
+        if (argc < 5)
+            return 1;
+        graph.demoteAdmin(stoi(args[2]), stoi(args[3]), stoi(args[4]));
+        out << "{ \"status\": \"demoted\" }" << endl;
+    }
+    else if (command == "mod_transfer")
+    {
+        if (argc < 5)
+            return 1;
+        graph.transferOwnership(stoi(args[2]), stoi(args[3]), stoi(args[4]));
+        out << "{ \"status\": \"transferred\" }" << endl;
+    }
+    else if (command == "send_dm")
+    {
+        if (argc < 8)
+            return 1;
+
+        int replyId = stoi(args[4]);
+        string type = args[5];
+
+        string mediaUrl = resolveArg(args, 6);
+
+        string content = args[7];
+        for (int i = 8; i < argc; ++i)
+            content += " " + args[i];
+
+        graph.sendDirectMessage(stoi(args[2]), stoi(args[3]), content, replyId, type, mediaUrl);
+        out << "{ \"status\": \"sent\" }" << endl;
+    }
+    else if (command == "get_dm")
+    {
+        if (argc < 4)
+            return 1;
+        int offset = (argc > 4) ? stoi(args[4]) : 0;
+        int limit = (argc > 5) ? stoi(args[5]) : 50;
+        JsonWriter json(out);
+        graph.getDirectChatJSON(json, stoi(args[2]), stoi(args[3]), offset, limit);
+    }
+    else if (command == "sync_dm")
+    {
+        if (argc < 6)
+            return 1;
+        JsonWriter json(out);
+        graph.getDirectSyncJSON(json, stoi(args[2]), stoi(args[3]), args[4], stoi(args[5]));
+    }
+    else if (command == "search_dm")
+    {
+        if (argc < 5)
+            return 1;
+        size_t limit = (argc > 5) ? stoul(args[5]) : 50;
+        if (!hasIndexedTerm(args[4]))
+        {
+            out << "{ \"error\": \"Search needs a word of 2 to 40 characters\" }" << endl;
+            return 0;
+        }
+        JsonWriter json(out);
+        graph.searchDirectMessagesJSON(json, stoi(args[2]), stoi(args[3]), args[4], limit);
+    }
+    else if (command == "delete_dm")
+    {
+        if (argc < 5)
+            return 1;
+        graph.deleteDirectMessage(stoi(args[2]), stoi(args[3]), stoi(args[4]));
+        out << "{ \"status\": \"deleted\" }" << endl;
+    }
+    else if (command == "react_dm")
+    {
+        if (argc < 6)
+            return 1;
+        graph.reactToDirectMessage(stoi(args[2]), stoi(args[3]), stoi(args[4]), args[5]);
+        out << "{ \"status\": \"reacted\" }" << endl;
+    }
+    else if (command == "get_my_dms")
+    {
+        if (argc < 3)
+            return 1;
+        JsonWriter json(out);
+        graph.getActiveDMsJSON(json, stoi(args[2]));
+    }
+    else if (command == "create_poll")
+    {
+        if (argc < 6)
+            return 1;
+        string question = args[4];
+        bool multi = (args[5] == "1");
+        vector<string> options;
+        for (int i = 6; i < argc; i++)
+            options.push_back(args[i]);
+        graph.createPoll(stoi(args[2]), stoi(args[3]), question, multi, options);
+        out << "{ \"status\": \"poll_created\" }" << endl;
+    }
+    else if (command == "vote_poll")
+    {
+        if (argc < 6)
+            return 1;
+        graph.togglePollVote(stoi(args[2]), stoi(args[3]), stoi(args[4]), stoi(args[5]));
+        out << "{ \"status\": \"voted\" }" << endl;
+    }
+    else if (command == "get_my_communities")
+    {
+        if (argc < 3)
+            return 1;
+        JsonWriter json(out);
+        graph.getJoinedCommunitiesJSON(json, stoi(args[2]));
+    }
+    else if (command == "get_user_recs")
+    {
+        if (argc < 3)
+            return 1;
+        JsonWriter json(out);
+        graph.getSmartUserRecommendations(json, stoi(args[2]));
+    }
+    else if (command == "get_recommendations")
+    {
+        if (argc < 3)
+            return 1;
+        JsonWriter json(out);
+        graph.getSmartUserRecommendations(json, stoi(args[2]));
+    }
+    else if (command == "get_comm_recs")
+    {
+        if (argc < 3)
+            return 1;
+        JsonWriter json(out);
+        graph.getSmartCommunityRecommendations(json, stoi(args[2]));
+    }
+    else if (command == "nav_push")
+    {
+        if (argc < 4)
+            return 1;
+        graph.navPush(stoi(args[2]), args[3]);
+        out << "{ \"status\": \"pushed\" }" << endl;
+    }
+    else if (command == "nav_back")
+    {
+        if (argc < 3)
+            return 1;
+        out << "{ \"tab\": \"" << graph.navBack(stoi(args[2])) << "\" }" << endl;
+    }
+    else if (command == "nav_forward")
+    {
+        if (argc < 3)
+            return 1;
+        out << "{ \"tab\": \"" << graph.navForward(stoi(args[2])) << "\" }" << endl;
+    }
+    else
+    {
+        out << "{ \"error\": \"Unknown command\" }" << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "../include/CommunityRanking.hpp"
+#include <algorithm>
+
+using namespace std;
+
+// Keys are negated so the natural set order is the ranking order.
+void CommunityRanking::place(int id, const Entry &e)
+{
+    byMembers.insert({~e.members, id});
+    byActivity.insert({-e.active, ~e.members, id});
+}
+
+void CommunityRanking::unplace(int id, const Entry &e)
+{
+    byMembers.erase({~e.members, id});
+    byActivity.erase({-e.active, ~e.members, id});
+}
+
+void CommunityRanking::clear()
+{
+    entries.clear();
+    byMembers.clear();
+    byActivity.clear();
+    clock = 0;
+}
+
+void CommunityRanking::update(int id, size_t members)
+{
+    auto it = entries.find(id);
+    if (it == entries.end())
+    {
+        Entry e;
+        e.members = members;
+        entries[id] = e;
+        place(id, e);
+        return;
+    }
+    if (it->second.members == members)
+        return;
+    unplace(id, it->second);
+    it->second.members = members;
+    place(id, it->second);
+}
+
+void CommunityRanking::touch(int id)
+{
+    auto it = entries.find(id);
+    if (it == entries.end())
+        return;
+    unplace(id, it->second);
+    it->second.active = ++clock;
+    place(id, it->second);
+}
+
+void CommunityRanking::seed(int id, long long tick)
+{
+    auto it = entries.find(id);
+    if (it == entries.end())
+        return;
+    unplace(id, it->second);
+    it->second.active = tick;
+    place(id, it->second);
+    clock = max(clock, tick);
+}
+
+vector<int> CommunityRanking::top(size_t n, bool recent) const
+{
+    vector<int> ids;
+    if (recent)
+    {
+        for (auto it = byActivity.begin(); it != byActivity.end() && ids.size() < n; ++it)
+            ids.push_back(get<2>(*it));
+    }
+    else
+    {
+        for (auto it = byMembers.begin(); it != byMembers.end() && ids.size() < n; ++it)
+            ids.push_back(get<1>(*it));
+    }
+    return ids;
+}
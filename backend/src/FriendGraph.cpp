@@ -0,0 +1,493 @@
+#include "../include/FriendGraph.hpp"
+#include <algorithm>
+#include <cstdint>
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// Spare entries a row gets when laid out, so most friendship changes fit.
+int rowSlack(int degree)
+{
+    return 2 + degree / 8;
+}
+
+void FriendGraph::build(const map<int, vector<int>> &adjList)
+{
+    ids.clear();
+    ids.reserve(adjList.size());
+    for (auto const &[id, friends] : adjList)
+    {
+        ids.push_back(id);
+        for (int f : friends)
+            ids.push_back(f);
+    }
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+
+    vector<int> degrees(ids.size(), 0);
+    for (auto const &[id, friends] : adjList)
+        degrees[indexOf(id)] = friends.size();
+    rowStart.resize(ids.size());
+    rowEnd.resize(ids.size());
+    rowCap.resize(ids.size());
+    int next = 0;
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        rowStart[i] = rowEnd[i] = next;
+        next += degrees[i] + rowSlack(degrees[i]);
+        rowCap[i] = next;
+    }
+
+    neighbors.assign(next, 0);
+    used = 0;
+    for (auto const &[id, friends] : adjList)
+    {
+        int row = indexOf(id);
+        int *out = neighbors.data() + rowStart[row];
+        for (int f : friends)
+            *out++ = indexOf(f);
+        sort(neighbors.data() + rowStart[row], out);
+        rowEnd[row] += friends.size();
+        used += friends.size();
+    }
+    wasted = 0;
+    dirty = false;
+    layouts++;
+}
+
+// Row for a user id, adding one at the end when the id sorts after every
+// indexed id. -1 when the id would need a row in the middle.
+int FriendGraph::rowFor(int id)
+{
+    int row = indexOf(id);
+    if (row >= 0 || (!ids.empty() && id < ids.back()))
+        return row;
+    ids.push_back(id);
+    rowStart.push_back(neighbors.size());
+    rowEnd.push_back(neighbors.size());
+    neighbors.resize(neighbors.size() + rowSlack(0));
+    rowCap.push_back(neighbors.size());
+    layouts++;
+    return ids.size() - 1;
+}
+
+void FriendGraph::insertNeighbor(int row, int v)
+{
+    int *first = neighbors.data() + rowStart[row], *last = neighbors.data() + rowEnd[row];
+    int *at = lower_bound(first, last, v);
+    if (at != last && *at == v)
+        return;
+    int offset = at - first;
+    if (rowEnd[row] == rowCap[row])
+    {
+        int degree = rowEnd[row] - rowStart[row];
+        int start = neighbors.size();
+        neighbors.resize(start + 2 * degree + rowSlack(degree));
+        copy(neighbors.begin() + rowStart[row], neighbors.begin() + rowEnd[row], neighbors.begin() + start);
+        wasted += rowCap[row] - rowStart[row];
+        rowStart[row] = start;
+        rowEnd[row] = start + degree;
+        rowCap[row] = neighbors.size();
+    }
+    int *pos = neighbors.data() + rowStart[row] + offset;
+    copy_backward(pos, neighbors.data() + rowEnd[row], neighbors.data() + rowEnd[row] + 1);
+    *pos = v;
+    rowEnd[row]++;
+    used++;
+}
+
+void FriendGraph::eraseNeighbor(int row, int v)
+{
+    int *first = neighbors.data() + rowStart[row], *last = neighbors.data() + rowEnd[row];
+    int *at = lower_bound(first, last, v);
+    if (at == last || *at != v)
+        return;
+    copy(at + 1, last, at);
+    rowEnd[row]--;
+    used--;
+}
+
+// Lays the rows out again in index order with fresh slack. Indices stay the
+// same, so version() does not change.
+void FriendGraph::compact()
+{
+    vector<int> packed;
+    packed.reserve(used + ids.size() * rowSlack(0));
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        int degree = rowEnd[i] - rowStart[i];
+        int start = packed.size();
+        packed.insert(packed.end(), neighbors.begin() + rowStart[i], neighbors.begin() + rowEnd[i]);
+        packed.resize(packed.size() + rowSlack(degree));
+        rowStart[i] = start;
+        rowEnd[i] = start + degree;
+        rowCap[i] = packed.size();
+    }
+    neighbors.swap(packed);
+    wasted = 0;
+}
+
+void FriendGraph::addEdge(int a, int b)
+{
+    if (dirty || a == b)
+        return;
+    rowFor(min(a, b));
+    int ia = rowFor(a), ib = rowFor(b);
+    if (ia < 0 || ib < 0)
+    {
+        dirty = true;
+        return;
+    }
+    insertNeighbor(ia, ib);
+    insertNeighbor(ib, ia);
+    if (wasted * 2 > neighbors.size())
+        compact();
+}
+
+void FriendGraph::removeEdge(int a, int b)
+{
+    if (dirty)
+        return;
+    int ia = indexOf(a), ib = indexOf(b);
+    if (ia < 0 || ib < 0)
+        return;
+    eraseNeighbor(ia, ib);
+    eraseNeighbor(ib, ia);
+}
+
+int FriendGraph::indexOf(int id) const
+{
+    auto it = lower_bound(ids.begin(), ids.end(), id);
+    if (it == ids.end() || *it != id)
+        return -1;
+    return it - ids.begin();
+}
+
+void resetWalk(BfsScratch &scratch, int nodes)
+{
+    if ((int)scratch.dist.size() != nodes)
+        scratch.dist.assign(nodes, -1);
+    else
+        for (int v : scratch.order)
+            scratch.dist[v] = -1;
+    scratch.order.clear();
+}
+
+void FriendGraph::bfs(int startIndex, int maxDepth, BfsScratch &scratch) const
+{
+    resetWalk(scratch, size());
+    if (startIndex < 0)
+        return;
+
+    scratch.dist[startIndex] = 0;
+    scratch.order.push_back(startIndex);
+    for (size_t head = 0; head < scratch.order.size(); head++)
+    {
+        int u = scratch.order[head];
+        int next = scratch.dist[u] + 1;
+        if (next > maxDepth)
+            break;
+        for (const int *p = begin(u), *e = end(u); p != e; ++p)
+            if (scratch.dist[*p] < 0)
+            {
+                scratch.dist[*p] = next;
+                scratch.order.push_back(*p);
+            }
+    }
+}
+
+// Friends-of-friends walk for recommendations: a bfs to depth 3 that marks
+// every friend but caps what is expanded after that. Each level is ordered by
+// degree; at most perHop[0] friends are expanded, picked evenly across that
+// order so hubs and ordinary friends are both represented, and a node with
+// more neighbours than perHop[1] or perHop[2] follows an evenly spaced sample
+// from a per-node offset. Hubs therefore cost their cap, not their degree.
+// Paths start-f-c are tallied for every hop-2 node c as with countMutuals.
+// Returns how many friends were not fully expanded, which bounds how far any
+// tally can fall short; 0 means hops 1-2 and the tallies match bfs exactly.
+int FriendGraph::sampleCandidates(int startIndex, const FanOut &fanOut, BfsScratch &scratch) const
+{
+    resetWalk(scratch, size());
+    if ((int)scratch.tally.size() != size())
+        scratch.tally.assign(size(), 0);
+    else
+        for (int v : scratch.counted)
+            scratch.tally[v] = 0;
+    scratch.counted.clear();
+    if (startIndex < 0)
+        return 0;
+
+    scratch.dist[startIndex] = 0;
+    scratch.order.push_back(startIndex);
+    for (const int *p = begin(startIndex), *e = end(startIndex); p != e; ++p)
+        if (scratch.dist[*p] < 0)
+        {
+            scratch.dist[*p] = 1;
+            scratch.order.push_back(*p);
+        }
+    size_t limit = fanOut.maxReached ? scratch.order.size() + fanOut.maxReached : SIZE_MAX;
+
+    int slack = 0;
+    size_t levelBegin = 1;
+    for (int depth = 1; depth < 3; depth++)
+    {
+        size_t levelEnd = scratch.order.size();
+        sort(scratch.order.begin() + levelBegin, scratch.order.begin() + levelEnd, [&](int a, int b)
+             { return degree(a) != degree(b) ? degree(a) < degree(b) : a < b; });
+        size_t width = levelEnd - levelBegin, expand = width;
+        if (depth == 1 && fanOut.perHop[0] > 0 && width > (size_t)fanOut.perHop[0])
+        {
+            expand = fanOut.perHop[0];
+            slack += width - expand;
+        }
+        int cap = fanOut.perHop[depth];
+        for (size_t j = 0; j < expand; j++)
+        {
+            int u = scratch.order[levelBegin + j * width / expand], d = degree(u);
+            int take = (cap > 0 && d > cap) ? cap : d;
+            size_t offset = take < d ? ((uint32_t)u * 2654435761u ^ (uint32_t)startIndex) % d : 0;
+            const int *row = begin(u);
+            for (int k = 0; k < take; k++)
+            {
+                int v = row[take < d ? (offset + (size_t)k * d / take) % d : k];
+                if (scratch.dist[v] < 0)
+                {
+                    if (scratch.order.size() >= limit)
+                        return depth == 1 ? slack + int(expand - j) : slack;
+                    scratch.dist[v] = depth + 1;
+                    scratch.order.push_back(v);
+                }
+                if (depth == 1 && scratch.dist[v] == 2 && scratch.tally[v]++ == 0)
+                    scratch.counted.push_back(v);
+            }
+            if (depth == 1 && take < d)
+                slack++;
+        }
+        levelBegin = levelEnd;
+    }
+    return slack;
+}
+
+void DegreeScratch::begin(int nodes)
+{
+    if ((int)mark[0].size() != nodes || ++epoch == 0)
+    {
+        for (int side = 0; side < 2; side++)
+        {
+            mark[side].assign(nodes, 0);
+            dist[side].resize(nodes);
+        }
+        epoch = 1;
+    }
+    frontier[0].clear();
+    frontier[1].clear();
+}
+
+// Bidirectional BFS: each round expands whichever side has the smaller
+// frontier by one full layer, so the search stays near the sparser endpoint.
+// Returns -1 if a and b are more than maxDepth hops apart.
+int FriendGraph::distance(int a, int b, int maxDepth, DegreeScratch &scratch) const
+{
+    if (a == b)
+        return 0;
+    scratch.begin(size());
+    unsigned epoch = scratch.epoch;
+    int ends[2] = {a, b};
+    int depth[2] = {0, 0};
+    for (int side = 0; side < 2; side++)
+    {
+        scratch.mark[side][ends[side]] = epoch;
+        scratch.dist[side][ends[side]] = 0;
+        scratch.frontier[side].push_back(ends[side]);
+    }
+
+    while (depth[0] + depth[1] < maxDepth && !scratch.frontier[0].empty() && !scratch.frontier[1].empty())
+    {
+        int side = scratch.frontier[0].size() <= scratch.frontier[1].size() ? 0 : 1;
+        int other = 1 - side;
+        vector<unsigned> &mine = scratch.mark[side];
+        const vector<unsigned> &theirs = scratch.mark[other];
+        int next = ++depth[side];
+        int best = -1;
+        scratch.next.clear();
+        for (int u : scratch.frontier[side])
+            for (const int *p = begin(u), *e = end(u); p != e; ++p)
+            {
+                int v = *p;
+                if (theirs[v] == epoch)
+                {
+                    int length = next + scratch.dist[other][v];
+                    if (best < 0 || length < best)
+                        best = length;
+                }
+                if (mine[v] != epoch)
+                {
+                    mine[v] = epoch;
+                    scratch.dist[side][v] = next;
+                    scratch.next.push_back(v);
+                }
+            }
+        if (best >= 0)
+            return best;
+        scratch.frontier[side].swap(scratch.next);
+    }
+    return -1;
+}
+
+// Degrees from one node to many: a single BFS from startIndex that stops
+// once every target is reached or maxDepth is exhausted. out[i] is the
+// distance to targets[i], or -1 (also for targets that are not in the graph).
+void FriendGraph::distances(int startIndex, const vector<int> &targets, int maxDepth, DegreeScratch &scratch, vector<int> &out) const
+{
+    out.assign(targets.size(), -1);
+    if (startIndex < 0)
+        return;
+    scratch.begin(size());
+    unsigned epoch = scratch.epoch;
+    vector<unsigned> &seen = scratch.mark[0], &wanted = scratch.mark[1];
+    size_t remaining = 0;
+    for (int t : targets)
+        if (t >= 0 && wanted[t] != epoch)
+        {
+            wanted[t] = epoch;
+            remaining++;
+        }
+
+    seen[startIndex] = epoch;
+    scratch.dist[0][startIndex] = 0;
+    if (wanted[startIndex] == epoch)
+        remaining--;
+    vector<int> &frontier = scratch.frontier[0];
+    frontier.push_back(startIndex);
+    for (int depth = 1; depth <= maxDepth && remaining > 0 && !frontier.empty(); depth++)
+    {
+        scratch.next.clear();
+        for (int u : frontier)
+            for (const int *p = begin(u), *e = end(u); p != e; ++p)
+                if (seen[*p] != epoch)
+                {
+                    seen[*p] = epoch;
+                    scratch.dist[0][*p] = depth;
+                    scratch.next.push_back(*p);
+                    if (wanted[*p] == epoch)
+                        remaining--;
+                }
+        frontier.swap(scratch.next);
+    }
+
+    for (size_t i = 0; i < targets.size(); i++)
+        if (targets[i] >= 0 && seen[targets[i]] == epoch)
+            out[i] = scratch.dist[0][targets[i]];
+}
+
+const int GALLOP_RATIO = 4;
+
+// Plain merge of two sorted, duplicate-free ranges.
+int mergeCount(const int *p, const int *pe, const int *q, const int *qe)
+{
+    int count = 0;
+    while (p != pe && q != qe)
+    {
+        if (*p < *q)
+            ++p;
+        else if (*q < *p)
+            ++q;
+        else
+        {
+            count++;
+            ++p;
+            ++q;
+        }
+    }
+    return count;
+}
+
+// For a short list against a much longer one: each element of [p, pe) is
+// located in the rest of [q, qe) by doubling steps, then a binary search.
+int gallopCount(const int *p, const int *pe, const int *q, const int *qe)
+{
+    int count = 0;
+    for (; p != pe && q != qe; ++p)
+    {
+        if (*q < *p)
+        {
+            ptrdiff_t lo = 0, hi = 1, len = qe - q;
+            while (hi < len && q[hi] < *p)
+            {
+                lo = hi;
+                hi *= 2;
+            }
+            q = lower_bound(q + lo + 1, q + min(hi + 1, len), *p);
+        }
+        if (q != qe && *q == *p)
+        {
+            count++;
+            ++q;
+        }
+    }
+    return count;
+}
+
+#if defined(__SSE2__) && defined(__GNUC__)
+// Compares four elements of each list at a time: the block from p against all
+// four rotations of the block from q. Rows hold no duplicates, so each equal
+// lane is one common friend, and advancing the block with the smaller last
+// element (both on a tie) never pairs the same two elements twice. Stops when
+// either list has fewer than four left; the caller merges the tails.
+int blockCount(const int *&p, const int *pe, const int *&q, const int *qe)
+{
+    int count = 0;
+    while (pe - p >= 4 && qe - q >= 4)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)p);
+        __m128i b = _mm_loadu_si128((const __m128i *)q);
+        __m128i hit = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(a, b), _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2))),
+                         _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 0, 3)))));
+        count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(hit)));
+        int lastA = p[3], lastB = q[3];
+        p += (lastA <= lastB) * 4;
+        q += (lastB <= lastA) * 4;
+    }
+    return count;
+}
+#endif
+
+// Sorted-row intersection: galloping when one row is much longer, otherwise
+// SSE2 blocks where available and a scalar merge for what is left.
+int FriendGraph::commonNeighbors(int a, int b) const
+{
+    const int *p = begin(a), *pe = end(a);
+    const int *q = begin(b), *qe = end(b);
+    if (pe - p > qe - q)
+    {
+        swap(p, q);
+        swap(pe, qe);
+    }
+    if (qe - q > GALLOP_RATIO * (pe - p))
+        return gallopCount(p, pe, q, qe);
+    int count = 0;
+#if defined(__SSE2__) && defined(__GNUC__)
+    count = blockCount(p, pe, q, qe);
+#endif
+    return count + mergeCount(p, pe, q, qe);
+}
+
+// One pass over the rows of me's friends; every path me-f-c with c two hops
+// out adds one to c's tally. The previous call's tallies are cleared first.
+void FriendGraph::countMutuals(int me, BfsScratch &scratch) const
+{
+    if ((int)scratch.tally.size() != size())
+        scratch.tally.assign(size(), 0);
+    else
+        for (int v : scratch.counted)
+            scratch.tally[v] = 0;
+    scratch.counted.clear();
+    for (const int *f = begin(me), *fe = end(me); f != fe; ++f)
+        for (const int *c = begin(*f), *ce = end(*f); c != ce; ++c)
+            if (scratch.dist[*c] == 2 && scratch.tally[*c]++ == 0)
+                scratch.counted.push_back(*c);
+}
@@ -1,9 +1,13 @@
 #include "../include/Graph.hpp"
 #include "../include/DirectChat.hpp"
+#include "../include/TextScan.hpp"
 #include <fstream>
 #include <sstream>
 #include <algorithm>
 #include <ctime>
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
 #include <queue>
 #include <set>
 #include <map>
@@ -33,6 +37,19 @@ string getCurrentTime()
     return string(buffer);
 }
 
+// Minutes since an "HH:MM" time from getCurrentTime, taking a time later
+// than now as yesterday's; -1 if it does not parse.
+int minutesSince(const string &hhmm)
+{
+    int hours, minutes;
+    if (sscanf(hhmm.c_str(), "%d:%d", &hours, &minutes) != 2)
+        return -1;
+    time_t now = time(0);
+    tm *ltm = localtime(&now);
+    int day = 24 * 60;
+    return ((ltm->tm_hour * 60 + ltm->tm_min) - (hours * 60 + minutes) + day) % day;
+}
+
 vector<string> globalSplit(const string &s, char delimiter)
 {
     vector<string> tokens;
@@ -52,36 +69,75 @@ string getDMKey(int u, int v)
     return to_string(v) + "_" + to_string(u);
 }
 
-string jsonEscape(const string &s)
-{
-    string output;
-    for (char c : s)
-    {
-        if (c == '"')
-            output += "\\\"";
-        else if (c == '\\')
-            output += "\\\\";
-        else if (c == '\b')
-            output += "\\b";
-        else if (c == '\f')
-            output += "\\f";
-        else if (c == '\n')
-            output += "\\n";
-        else if (c == '\r')
-            output += "\\r";
-        else if (c == '\t')
-            output += "\\t";
-        else
-            output += c;
+
+template <class T>
+void indexMessage(TextIndex &index, const T &m)
+{
+    if (index.ready() && isSearchable(m))
+        index.add(m.id, m.content);
+}
+
+template <class T>
+void unindexMessage(TextIndex &index, const T &m)
+{
+    if (index.ready() && isSearchable(m))
+        index.remove(m.id, m.content);
+}
+
+// A conversation's index is built the first time it is searched: one pass
+// over the whole log, spilled segments included, trimming as it goes so at
+// most a few segments are resident at once.
+template <class T>
+TextIndex &searchIndex(TextIndex &index, MessageLog<T> &log)
+{
+    if (index.ready())
+        return index;
+    index.markReady();
+    for (size_t slot = 0; slot < log.slotCount(); slot++)
+    {
+        if (log.isLive(slot))
+            indexMessage(index, log.view(slot));
+        if ((slot + 1) % MessageLog<T>::SEGMENT_SIZE == 0)
+            log.trim();
+    }
+    log.trim();
+    return index;
+}
+
+// Ids of messages holding every term of the query, newest first. Terms too
+// short or too long to be indexed are matched against the text of the
+// messages the indexed terms leave, so they narrow the result rather than
+// being dropped. Callers reject queries without any indexed term.
+template <class T>
+vector<int> searchLog(TextIndex &index, MessageLog<T> &log, const string &query, size_t limit)
+{
+    vector<string> unindexed;
+    for (const string &term : splitTerms(query))
+        if (!isIndexedTerm(term))
+            unindexed.push_back(term);
+    vector<int> ids = searchIndex(index, log).search(query, unindexed.empty() ? limit : 0);
+    if (unindexed.empty())
+        return ids;
+
+    vector<int> hits;
+    for (size_t i = 0; i < ids.size() && (limit == 0 || hits.size() < limit); i++)
+    {
+        const T *m = log.lookup(ids[i]);
+        if (!m)
+            continue;
+        vector<string> words = splitTerms(m->content);
+        if (all_of(unindexed.begin(), unindexed.end(), [&](const string &term)
+                   { return binary_search(words.begin(), words.end(), term); }))
+            hits.push_back(ids[i]);
+        if ((i + 1) % MessageLog<T>::SEGMENT_SIZE == 0)
+            log.trim();
     }
-    return output;
+    return hits;
 }
 
 string sanitize(string input)
 {
-    replace(input.begin(), input.end(), '\n', ' ');
-    replace(input.begin(), input.end(), '\r', ' ');
-    replace(input.begin(), input.end(), '|', ' ');
+    replaceSeparators(&input[0], input.size());
     return input;
 }
 
@@ -145,403 +201,643 @@ vector<string> NovaGraph::split(const string &s, char delimiter)
     return globalSplit(s, delimiter);
 }
 
-void NovaGraph::loadData()
+template <typename Ids>
+string joinIds(const Ids &ids, const string &emptyToken)
 {
-    string line;
+    if (ids.empty())
+        return emptyToken;
+    string s;
+    for (int id : ids)
+    {
+        if (!s.empty())
+            s += ",";
+        s += to_string(id);
+    }
+    return s;
+}
 
-    ifstream userFile("data/users.txt");
-    if (userFile.is_open())
-    {
-        while (getline(userFile, line))
+string formatUserRow(const User &u)
+{
+    string tagStr = "";
+    for (size_t i = 0; i < u.tags.size(); i++)
+        tagStr += u.tags[i] + (i < u.tags.size() - 1 ? "," : "");
+    if (tagStr.empty())
+        tagStr = "None";
+    return to_string(u.id) + "|" + u.username + "|" + u.email + "|" + u.password + "|" + (u.avatarUrl.empty() ? "NULL" : u.avatarUrl) + "|" + tagStr + "|" + to_string(u.karma) + "|" + joinIds(u.pendingRequests, "0");
+}
+
+string formatGraphRow(int id, const vector<int> &friends)
+{
+    string s = to_string(id);
+    for (int friendID : friends)
+        s += "," + to_string(friendID);
+    return s;
+}
+
+string formatCommunityRow(const Community &c)
+{
+    string s = to_string(c.id) + "|" + c.name + "|" + c.description + "|" + (c.coverUrl.empty() ? "NULL" : c.coverUrl) + "|";
+    for (size_t i = 0; i < c.tags.size(); i++)
+        s += c.tags[i] + (i < c.tags.size() - 1 ? "," : "");
+    s += "|" + joinIds(c.members, "NULL");
+    s += "|" + joinIds(c.moderators, "NULL");
+    s += "|" + joinIds(c.bannedUsers, "NULL");
+    s += "|" + joinIds(c.admins, "NULL");
+    return s;
+}
+
+string formatChatRow(int commId, const Message &msg)
+{
+    string s = to_string(commId) + "|" +
+               to_string(msg.id) + "|" +
+               to_string(msg.senderId) + "|" +
+               msg.senderName + "|" +
+               msg.timestamp + "|" +
+               joinIds(msg.upvoters, "0") + "|" +
+               (msg.isPinned ? "1" : "0") + "|" +
+               to_string(msg.replyToId) + "|" +
+               msg.type + "|" +
+               (msg.mediaUrl.empty() ? "NONE" : sanitize(msg.mediaUrl)) + "|";
+    if (msg.type == "poll")
+        s += serializePoll(msg.poll);
+    else
+        s += sanitize(msg.content);
+    return s;
+}
+
+string formatDMRow(const string &key, const DirectMessage &m)
+{
+    return key + "|" +
+           to_string(m.id) + "|" +
+           to_string(m.senderId) + "|" +
+           m.timestamp + "|" +
+           to_string(m.replyToMsgId) + "|" +
+           (m.reaction.empty() ? "NONE" : m.reaction) + "|" +
+           (m.isSeen ? "1" : "0") + "|" +
+           m.type + "|" +
+           (m.mediaUrl.empty() ? "NONE" : sanitize(m.mediaUrl)) + "|" +
+           sanitize(m.content);
+}
+
+void NovaGraph::loadUserRow(const string &line)
+{
+    auto parts = split(line, '|');
+    if (parts.size() >= 7)
+    {
+        User u;
+        u.id = safeStoi(parts[0]);
+        u.username = parts[1];
+        u.email = parts[2];
+        u.password = parts[3];
+        u.avatarUrl = loadMedia(parts[4]);
+        u.tags = split(parts[5], ',');
+        u.karma = safeStoi(parts[6]);
+        if (parts.size() > 7 && parts[7] != "0" && parts[7] != "")
         {
-            auto parts = split(line, '|');
-            if (parts.size() >= 7)
+            auto reqList = split(parts[7], ',');
+            for (auto r : reqList)
             {
-                User u;
-                u.id = safeStoi(parts[0]);
-                u.username = parts[1];
-                u.email = parts[2];
-                u.password = parts[3];
-                u.avatarUrl = parts[4];
-                u.tags = split(parts[5], ',');
-                u.karma = safeStoi(parts[6]);
-                if (parts.size() > 7 && parts[7] != "0" && parts[7] != "")
-                {
-                    auto reqList = split(parts[7], ',');
-                    for (auto r : reqList)
-                    {
-                        int rid = safeStoi(r);
-                        if (rid != 0)
-                            u.pendingRequests.insert(rid);
-                    }
-                }
-                if (u.id != 0)
-                {
-                    userDB[u.id] = u;
-                    usernameIndex[u.username] = u.id;
-                }
+                int rid = safeStoi(r);
+                if (rid != 0)
+                    u.pendingRequests.insert(rid);
             }
         }
-        userFile.close();
+        if (u.id != 0)
+        {
+            auto old = userDB.find(u.id);
+            if (old != userDB.end())
+                userIndex.remove(old->second);
+            userDB[u.id] = u;
+            usernameIndex[u.username] = u.id;
+            userIndex.add(u);
+        }
     }
+}
 
-    ifstream graphFile("data/graph.txt");
-    if (graphFile.is_open())
+void NovaGraph::loadGraphRow(const string &line)
+{
+    auto parts = split(line, ',');
+    if (parts.empty())
+        return;
+    int id = safeStoi(parts[0]);
+    vector<int> friends;
+    for (size_t i = 1; i < parts.size(); i++)
     {
-        while (getline(graphFile, line))
+        int fid = safeStoi(parts[i]);
+        if (fid != id && fid != 0)
+            friends.push_back(fid);
+    }
+    sort(friends.begin(), friends.end());
+    friends.erase(unique(friends.begin(), friends.end()), friends.end());
+    adjList[id] = friends;
+    friendGraph.markDirty();
+}
+
+void NovaGraph::loadCommunityRow(const string &line)
+{
+    auto parts = split(line, '|');
+    if (parts.size() >= 5)
+    {
+        Community c;
+        c.id = safeStoi(parts[0]);
+        c.name = parts[1];
+        c.description = parts[2];
+        c.coverUrl = loadMedia(parts[3]);
+        auto tagList = split(parts[4], ',');
+        for (auto t : tagList)
+            if (!t.empty())
+                c.tags.push_back(t);
+        if (parts.size() > 5 && parts[5] != "NULL")
         {
-            auto parts = split(line, ',');
-            int id = safeStoi(parts[0]);
-            vector<int> friends;
-            for (size_t i = 1; i < parts.size(); i++)
+            auto memList = split(parts[5], ',');
+            for (auto m : memList)
             {
-                int fid = safeStoi(parts[i]);
-                if (fid != id && fid != 0)
-                    friends.push_back(fid);
+                int mid = safeStoi(m);
+                if (mid != 0)
+                    c.members.insert(mid);
             }
-            sort(friends.begin(), friends.end());
-            friends.erase(unique(friends.begin(), friends.end()), friends.end());
-            adjList[id] = friends;
         }
-        graphFile.close();
-    }
-
-    ifstream commFile("data/communities.txt");
-    if (commFile.is_open())
-    {
-        while (getline(commFile, line))
+        if (parts.size() > 6 && parts[6] != "NULL")
         {
-            auto parts = split(line, '|');
-            if (parts.size() >= 5)
+            auto modList = split(parts[6], ',');
+            for (auto m : modList)
             {
-                Community c;
-                c.id = safeStoi(parts[0]);
-                c.name = parts[1];
-                c.description = parts[2];
-                c.coverUrl = parts[3];
-                auto tagList = split(parts[4], ',');
-                for (auto t : tagList)
-                    if (!t.empty())
-                        c.tags.push_back(t);
-                if (parts.size() > 5 && parts[5] != "NULL")
-                {
-                    auto memList = split(parts[5], ',');
-                    for (auto m : memList)
-                    {
-                        int mid = safeStoi(m);
-                        if (mid != 0)
-                            c.members.insert(mid);
-                    }
-                }
-                if (parts.size() > 6 && parts[6] != "NULL")
-                {
-                    auto modList = split(parts[6], ',');
-                    for (auto m : modList)
-                    {
-                        int mid = safeStoi(m);
-                        if (mid != 0)
-                            c.moderators.insert(mid);
-                    }
-                }
-                if (parts.size() > 7 && parts[7] != "NULL")
-                {
-                    auto banList = split(parts[7], ',');
-                    for (auto b : banList)
-                    {
-                        int bid = safeStoi(b);
-                        if (bid != 0)
-                            c.bannedUsers.insert(bid);
-                    }
-                }
-                if (parts.size() > 8 && parts[8] != "NULL")
-                {
-                    auto adminList = split(parts[8], ',');
-                    for (auto a : adminList)
-                    {
-                        int aid = safeStoi(a);
-                        if (aid != 0)
-                            c.admins.insert(aid);
-                    }
-                }
-                if (c.id != 0)
-                {
-                    communityDB[c.id] = c;
-                    if (c.id >= nextCommunityId)
-                        nextCommunityId = c.id + 1;
-                }
+                int mid = safeStoi(m);
+                if (mid != 0)
+                    c.moderators.insert(mid);
             }
         }
-        commFile.close();
-    }
-
-    ifstream chatFile("data/chats.txt");
-    if (chatFile.is_open())
-    {
-        while (getline(chatFile, line))
+        if (parts.size() > 7 && parts[7] != "NULL")
         {
-            auto parts = split(line, '|');
-
-            if (parts.size() >= 10)
+            auto banList = split(parts[7], ',');
+            for (auto b : banList)
             {
-                int commId = safeStoi(parts[0]);
-                if (communityDB.find(commId) != communityDB.end())
-                {
-                    Message m;
-                    m.id = safeStoi(parts[1]);
-                    m.senderId = safeStoi(parts[2]);
-                    m.senderName = parts[3];
-                    m.timestamp = parts[4];
-                    m.upvoters.clear();
-                    if (parts[5] != "0" && parts[5] != "")
-                    {
-                        auto voterList = split(parts[5], ',');
-                        for (auto v : voterList)
-                        {
-                            int vid = safeStoi(v);
-                            if (vid != 0)
-                                m.upvoters.insert(vid);
-                        }
-                    }
-                    m.isPinned = (parts[6] == "1");
-                    m.replyToId = safeStoi(parts[7]);
-                    m.type = parts[8];
-
-                    int contentIdx = 9;
-
-                    if (parts.size() >= 11)
-                    {
-                        m.mediaUrl = parts[9];
-                        contentIdx = 10;
-                    }
-                    else
-                    {
-                        m.mediaUrl = "";
-                    }
-
-                    string rawContent = parts[contentIdx];
-                    for (size_t i = contentIdx + 1; i < parts.size(); i++)
-                        rawContent += "|" + parts[i];
-
-                    if (m.type == "poll")
-                    {
-                        m.poll = parsePoll(rawContent);
-                        m.content = "Poll: " + m.poll.question;
-                    }
-                    else
-                    {
-                        m.content = rawContent;
-                    }
-
-                    communityDB[commId].chatHistory.push_back(m);
-                    if (m.id >= communityDB[commId].nextMsgId)
-                        communityDB[commId].nextMsgId = m.id + 1;
-                }
+                int bid = safeStoi(b);
+                if (bid != 0)
+                    c.bannedUsers.insert(bid);
             }
         }
-        chatFile.close();
+        if (parts.size() > 8 && parts[8] != "NULL")
+        {
+            auto adminList = split(parts[8], ',');
+            for (auto a : adminList)
+            {
+                int aid = safeStoi(a);
+                if (aid != 0)
+                    c.admins.insert(aid);
+            }
+        }
+        if (c.id != 0)
+        {
+            auto existing = communityDB.find(c.id);
+            if (existing != communityDB.end())
+            {
+                swap(c.chatHistory, existing->second.chatHistory);
+                c.nextMsgId = existing->second.nextMsgId;
+            }
+            else
+                attachHistory(c);
+            if (c.id >= nextCommunityId)
+                nextCommunityId = c.id + 1;
+            communityDB[c.id] = move(c);
+        }
     }
+}
 
-    ifstream dmFile("data/dms.txt");
-    if (dmFile.is_open())
+void NovaGraph::loadChatRow(const string &line)
+{
+    auto parts = split(line, '|');
+
+    if (parts.size() >= 10)
     {
-        string line;
-        while (getline(dmFile, line))
+        int commId = safeStoi(parts[0]);
+        if (communityDB.find(commId) != communityDB.end())
         {
-            auto parts = split(line, '|');
-
-            if (parts.size() >= 8)
+            Message m;
+            m.id = safeStoi(parts[1]);
+            m.senderId = safeStoi(parts[2]);
+            m.senderName = parts[3];
+            m.timestamp = parts[4];
+            m.upvoters.clear();
+            if (parts[5] != "0" && parts[5] != "")
             {
-                string key = parts[0];
-                DirectMessage m;
-                m.id = safeStoi(parts[1]);
-                m.senderId = safeStoi(parts[2]);
-                m.timestamp = parts[3];
-                m.replyToMsgId = safeStoi(parts[4]);
-                m.reaction = (parts[5] == "NONE") ? "" : parts[5];
-                m.isSeen = (parts[6] == "1");
-
-                int contentIdx = 7;
-
-                if (parts.size() >= 10)
-                {
-                    m.type = parts[7];
-                    m.mediaUrl = parts[8];
-                    contentIdx = 9;
-                }
-                else
+                auto voterList = split(parts[5], ',');
+                for (auto v : voterList)
                 {
-                    m.type = "text";
-                    m.mediaUrl = "";
+                    int vid = safeStoi(v);
+                    if (vid != 0)
+                        m.upvoters.insert(vid);
                 }
+            }
+            m.isPinned = (parts[6] == "1");
+            m.replyToId = safeStoi(parts[7]);
+            m.type = parts[8];
 
-                m.content = parts[contentIdx];
-                for (size_t i = contentIdx + 1; i < parts.size(); i++)
-                    m.content += " " + parts[i];
+            int contentIdx = 9;
 
-                dmDB[key].chatKey = key;
-                dmDB[key].messages.push_back(m);
-                if (m.id >= dmDB[key].nextMsgId)
-                    dmDB[key].nextMsgId = m.id + 1;
+            if (parts.size() >= 11)
+            {
+                m.mediaUrl = loadMedia(parts[9]);
+                contentIdx = 10;
+            }
+            else
+            {
+                m.mediaUrl = "";
             }
+
+            string rawContent = parts[contentIdx];
+            for (size_t i = contentIdx + 1; i < parts.size(); i++)
+                rawContent += "|" + parts[i];
+
+            if (m.type == "poll")
+            {
+                m.poll = parsePoll(rawContent);
+                m.content = "Poll: " + m.poll.question;
+            }
+            else
+            {
+                m.content = rawContent;
+            }
+
+            Community &c = communityDB[commId];
+            if (m.id >= c.nextMsgId)
+                c.nextMsgId = m.id + 1;
+            c.chatHistory.put(m);
         }
-        dmFile.close();
     }
 }
 
-void NovaGraph::saveData()
+void NovaGraph::loadDMRow(const string &line)
 {
-    ofstream userFile("data/users.txt");
-    for (auto const &[id, u] : userDB)
+    auto parts = split(line, '|');
+
+    if (parts.size() >= 8)
     {
-        string tagStr = "";
-        for (size_t i = 0; i < u.tags.size(); i++)
-            tagStr += u.tags[i] + (i < u.tags.size() - 1 ? "," : "");
-        if (tagStr.empty())
-            tagStr = "None";
-        userFile << u.id << "|" << u.username << "|" << u.email << "|" << u.password << "|" << (u.avatarUrl.empty() ? "NULL" : u.avatarUrl) << "|" << tagStr << "|" << u.karma << "|";
-        if (u.pendingRequests.empty())
-            userFile << "0";
+        string key = parts[0];
+        DirectMessage m;
+        m.id = safeStoi(parts[1]);
+        m.senderId = safeStoi(parts[2]);
+        m.timestamp = parts[3];
+        m.replyToMsgId = safeStoi(parts[4]);
+        m.reaction = (parts[5] == "NONE") ? "" : parts[5];
+        m.isSeen = (parts[6] == "1");
+
+        int contentIdx = 7;
+
+        if (parts.size() >= 10)
+        {
+            m.type = parts[7];
+            m.mediaUrl = loadMedia(parts[8]);
+            contentIdx = 9;
+        }
         else
         {
-            int i = 0;
-            for (int rid : u.pendingRequests)
-            {
-                userFile << rid << (i < u.pendingRequests.size() - 1 ? "," : "");
-                i++;
-            }
+            m.type = "text";
+            m.mediaUrl = "";
         }
-        userFile << "\n";
+
+        m.content = parts[contentIdx];
+        for (size_t i = contentIdx + 1; i < parts.size(); i++)
+            m.content += " " + parts[i];
+
+        DirectChat &chat = directChat(key);
+        if (m.id >= chat.nextMsgId)
+            chat.nextMsgId = m.id + 1;
+        chat.messages.put(m);
     }
-    userFile.close();
+}
 
-    ofstream graphFile("data/graph.txt");
-    for (auto &[id, friends] : adjList)
-    {
-        sort(friends.begin(), friends.end());
-        friends.erase(unique(friends.begin(), friends.end()), friends.end());
-        graphFile << id;
-        for (int friendID : friends)
-            graphFile << "," << friendID;
-        graphFile << "\n";
+string NovaGraph::loadMedia(const string &value)
+{
+    string ref = blobs.intern(value);
+    if (ref != value)
+        loadedInlineMedia = true;
+    return ref;
+}
+
+void NovaGraph::loadData()
+{
+    string line;
+    blobs.open("data/blobs");
+    history.open("data/history");
+    syncEpoch = to_string(chrono::system_clock::now().time_since_epoch().count());
+
+    // Once converted, data/snapshot.bin is authoritative and the .txt files are
+    // left untouched, so they are stale and the WAL only covers the time since
+    // the last snapshot. A snapshot that fails to load stops startup rather
+    // than rolling back to them.
+    if (filesystem::exists("data/snapshot.bin"))
+    {
+        if (!loadSnapshot("data/snapshot.bin"))
+            throw runtime_error("data/snapshot.bin could not be loaded; refusing to fall back to the .txt files");
+        binarySnapshot = true;
+        replayLog();
+        return;
     }
-    graphFile.close();
 
-    ofstream commFile("data/communities.txt");
-    for (auto const &[id, c] : communityDB)
-    {
-        commFile << c.id << "|" << c.name << "|" << c.description << "|" << (c.coverUrl.empty() ? "NULL" : c.coverUrl) << "|";
-        for (size_t i = 0; i < c.tags.size(); i++)
-            commFile << c.tags[i] << (i < c.tags.size() - 1 ? "," : "");
-        commFile << "|";
-        if (c.members.empty())
-            commFile << "NULL";
-        else
-        {
-            int i = 0;
-            for (int m : c.members)
-            {
-                commFile << m << (i < c.members.size() - 1 ? "," : "");
-                i++;
-            }
-        }
-        commFile << "|";
-        if (c.moderators.empty())
-            commFile << "NULL";
+    ifstream userFile("data/users.txt");
+    while (getline(userFile, line))
+        loadUserRow(line);
+
+    ifstream graphFile("data/graph.txt");
+    while (getline(graphFile, line))
+        loadGraphRow(line);
+
+    ifstream commFile("data/communities.txt");
+    while (getline(commFile, line))
+        loadCommunityRow(line);
+
+    ifstream chatFile("data/chats.txt");
+    while (getline(chatFile, line))
+        loadChatRow(line);
+
+    ifstream dmFile("data/dms.txt");
+    while (getline(dmFile, line))
+        loadDMRow(line);
+
+    replayLog();
+
+    // Rows written before the blob store existed carry media inline; rewrite
+    // them once so the text files only hold references from now on.
+    if (loadedInlineMedia)
+        saveData();
+}
+
+void NovaGraph::replayLog()
+{
+    restoreHistoryLogs();
+    wal.open("data/wal.txt");
+    for (const auto &rec : wal.readAll())
+    {
+        if (rec.type == "USER")
+            loadUserRow(rec.row);
+        else if (rec.type == "GRAPH")
+            loadGraphRow(rec.row);
+        else if (rec.type == "COMM")
+            loadCommunityRow(rec.row);
+        else if (rec.type == "CHAT")
+            loadChatRow(rec.row);
+        else if (rec.type == "DM")
+            loadDMRow(rec.row);
         else
         {
-            int i = 0;
-            for (int m : c.moderators)
+            auto parts = split(rec.row, '|');
+            if (parts.size() < 2)
+                continue;
+            if (rec.type == "DEL_CHAT" && communityDB.count(safeStoi(parts[0])))
             {
-                commFile << m << (i < c.moderators.size() - 1 ? "," : "");
-                i++;
+                communityDB[safeStoi(parts[0])].chatHistory.erase(safeStoi(parts[1]));
             }
-        }
-        commFile << "|";
-        if (c.bannedUsers.empty())
-            commFile << "NULL";
-        else
-        {
-            int i = 0;
-            for (int m : c.bannedUsers)
+            else if (rec.type == "DEL_DM" && dmDB.count(parts[0]))
             {
-                commFile << m << (i < c.bannedUsers.size() - 1 ? "," : "");
-                i++;
+                dmDB[parts[0]].messages.erase(safeStoi(parts[1]));
             }
-        }
-        commFile << "|";
-        if (c.admins.empty())
-            commFile << "NULL";
-        else
-        {
-            int i = 0;
-            for (int a : c.admins)
+            else if (rec.type == "SEEN" && dmDB.count(parts[0]))
             {
-                commFile << a << (i < c.admins.size() - 1 ? "," : "");
-                i++;
+                // Read through view() so only segments where a message flips
+                // are marked dirty; unseen ones are the sender's newest.
+                int senderId = safeStoi(parts[1]);
+                MessageLog<DirectMessage> &messages = dmDB[parts[0]].messages;
+                for (size_t slot = messages.slotCount(); slot-- > 0;)
+                {
+                    if (!messages.isLive(slot) || messages.view(slot).senderId != senderId)
+                        continue;
+                    if (messages.view(slot).isSeen)
+                        break;
+                    messages.at(slot).isSeen = true;
+                }
             }
         }
-        commFile << "\n";
     }
-    commFile.close();
+    rebuildCommunityIndex();
+    rebuildDMIndex();
+    trimHistory();
+    // Segments sealed while loading (or by a run that stopped before its
+    // next save) are on disk but not yet in the manifest.
+    if (wal.size() > WAL_COMPACT_BYTES || history.manifestBehind())
+        saveData();
+}
 
-    ofstream chatFile("data/chats.txt");
-    for (auto const &[commId, comm] : communityDB)
+void NovaGraph::attachHistory(Community &c)
+{
+    c.chatHistory.attach(&history, "c" + to_string(c.id));
+    c.nextMsgId = max(c.nextMsgId, c.chatHistory.highestId() + 1);
+}
+
+void NovaGraph::attachHistory(DirectChat &chat)
+{
+    chat.messages.attach(&history, "d" + chat.chatKey);
+    chat.nextMsgId = max(chat.nextMsgId, chat.messages.highestId() + 1);
+}
+
+DirectChat &NovaGraph::directChat(const string &key)
+{
+    DirectChat &chat = dmDB[key];
+    if (chat.chatKey.empty())
     {
-        for (const auto &msg : comm.chatHistory)
-        {
-            chatFile << commId << "|"
-                     << msg.id << "|"
-                     << msg.senderId << "|"
-                     << msg.senderName << "|"
-                     << msg.timestamp << "|";
-
-            if (msg.upvoters.empty())
-                chatFile << "0";
-            else
-            {
-                int i = 0;
-                for (int uid : msg.upvoters)
-                {
-                    chatFile << uid << (i < msg.upvoters.size() - 1 ? "," : "");
-                    i++;
-                }
-            }
+        chat.chatKey = key;
+        attachHistory(chat);
+    }
+    return chat;
+}
 
-            chatFile << "|"
-                     << (msg.isPinned ? "1" : "0") << "|"
-                     << msg.replyToId << "|"
-                     << msg.type << "|"
+// A DM whose unspilled tail was deleted entirely has no rows left; bring it
+// back from its spilled segments before the log is replayed against it.
+void NovaGraph::restoreHistoryLogs()
+{
+    for (const string &log : history.logs())
+        if (log[0] == 'd')
+            directChat(log.substr(1));
+}
 
-                     << (msg.mediaUrl.empty() ? "NONE" : sanitize(msg.mediaUrl)) << "|";
+void NovaGraph::trimHistory()
+{
+    for (auto &[id, c] : communityDB)
+        c.chatHistory.trim();
+    for (auto &[key, chat] : dmDB)
+        chat.messages.trim();
+}
 
-            if (msg.type == "poll")
-                chatFile << serializePoll(msg.poll);
-            else
-                chatFile << sanitize(msg.content);
+// Segment files first, then the manifest that lists them; the row files and
+// snapshot written after this only hold the unspilled tails.
+void NovaGraph::saveHistory()
+{
+    map<string, vector<SegmentMeta>> logs;
+    for (auto &[id, c] : communityDB)
+    {
+        vector<SegmentMeta> listing = c.chatHistory.flush();
+        if (!listing.empty())
+            logs["c" + to_string(id)] = move(listing);
+    }
+    for (auto &[key, chat] : dmDB)
+    {
+        vector<SegmentMeta> listing = chat.messages.flush();
+        if (!listing.empty())
+            logs["d" + key] = move(listing);
+    }
+    history.commitManifest(logs);
+}
 
-            chatFile << "\n";
-        }
+void NovaGraph::rebuildCommunityIndex()
+{
+    communityRoles.clear();
+    communityRanking.clear();
+    for (auto &[id, c] : communityDB)
+    {
+        communityRanking.update(id, c.members.size());
+        // Messages only carry a time of day, so activity is seeded from how
+        // long ago in the last 24 hours the newest one was posted.
+        const Message *newest = c.chatHistory.back();
+        int age = newest ? minutesSince(newest->timestamp) : -1;
+        if (age >= 0)
+            communityRanking.seed(id, 24 * 60 - age);
+        // Pinned messages are sticky, so every one of them is resident here.
+        c.pinnedIds.clear();
+        for (const Message &m : as_const(c.chatHistory))
+            if (m.isPinned)
+                c.pinnedIds.insert(m.id);
+        for (int uid : c.members)
+            communityRoles[uid].joined.insert(id);
+        for (int uid : c.moderators)
+            communityRoles[uid].moderated.insert(id);
+        for (int uid : c.admins)
+            communityRoles[uid].admin.insert(id);
+        for (int uid : c.bannedUsers)
+            communityRoles[uid].banned.insert(id);
     }
-    chatFile.close();
+}
 
-    ofstream dmOut("data/dms.txt");
-    for (auto const &[key, chat] : dmDB)
+void NovaGraph::rebuildDMIndex()
+{
+    dmIndex.clear();
+    for (auto &[key, chat] : dmDB)
     {
-        for (const auto &m : chat.messages)
-        {
-            dmOut << key << "|"
-                  << m.id << "|"
-                  << m.senderId << "|"
-                  << m.timestamp << "|"
-                  << m.replyToMsgId << "|"
-                  << (m.reaction.empty() ? "NONE" : m.reaction) << "|"
-                  << (m.isSeen ? "1" : "0") << "|"
-                  << m.type << "|"
-                  << (m.mediaUrl.empty() ? "NONE" : sanitize(m.mediaUrl)) << "|"
-                  << sanitize(m.content) << "\n";
-        }
+        size_t underscore = key.find('_');
+        if (underscore == string::npos)
+            continue;
+        chat.lowId = safeStoi(key.substr(0, underscore));
+        chat.highId = safeStoi(key.substr(underscore + 1));
+        chat.unseenFromLow = 0;
+        chat.unseenFromHigh = 0;
+        for (const auto &m : as_const(chat.messages))
+            if (!m.isSeen)
+                chat.unseenFrom(m.senderId)++;
+        dmIndex[chat.lowId].insert(key);
+        dmIndex[chat.highId].insert(key);
+    }
+}
+
+void setRole(set<int> &roles, int commId, bool on)
+{
+    if (on)
+        roles.insert(commId);
+    else
+        roles.erase(commId);
+}
+
+void NovaGraph::syncCommunityRoles(const Community &c, int userId)
+{
+    CommunityRoles &r = communityRoles[userId];
+    setRole(r.joined, c.id, c.members.count(userId));
+    setRole(r.moderated, c.id, c.moderators.count(userId));
+    setRole(r.admin, c.id, c.admins.count(userId));
+    setRole(r.banned, c.id, c.bannedUsers.count(userId));
+    communityRanking.update(c.id, c.members.size());
+    if (r.joined.empty() && r.moderated.empty() && r.admin.empty() && r.banned.empty())
+        communityRoles.erase(userId);
+}
+
+void NovaGraph::logRecord(const string &type, const string &row)
+{
+    wal.append(type, row);
+    if (wal.size() > WAL_COMPACT_BYTES)
+        saveData();
+}
+
+// Topics a mutation wakes in serve mode; drained after each command.
+void NovaGraph::publish(const Community &c)
+{
+    events.insert("community:" + to_string(c.id));
+}
+
+void NovaGraph::publish(const DirectChat &chat)
+{
+    events.insert("dm:" + chat.chatKey);
+    events.insert("inbox:" + to_string(chat.lowId));
+    events.insert("inbox:" + to_string(chat.highId));
+}
+
+vector<string> NovaGraph::takeEvents()
+{
+    vector<string> topics(events.begin(), events.end());
+    events.clear();
+    return topics;
+}
+
+void commitFile(const string &path)
+{
+#ifdef _WIN32
+    remove(path.c_str());
+#endif
+    rename((path + ".tmp").c_str(), path.c_str());
+}
+
+void NovaGraph::convertToSnapshot()
+{
+    binarySnapshot = true;
+    saveData();
+}
+
+void NovaGraph::saveData()
+{
+    saveHistory();
+    if (binarySnapshot)
+    {
+        saveSnapshot("data/snapshot.bin");
+        wal.reset();
+        return;
     }
+
+    ofstream userFile("data/users.txt.tmp");
+    for (auto const &[id, u] : userDB)
+        userFile << formatUserRow(u) << "\n";
+    userFile.close();
+
+    ofstream graphFile("data/graph.txt.tmp");
+    for (auto &[id, friends] : adjList)
+    {
+        sort(friends.begin(), friends.end());
+        friends.erase(unique(friends.begin(), friends.end()), friends.end());
+        graphFile << formatGraphRow(id, friends) << "\n";
+    }
+    graphFile.close();
+
+    ofstream commFile("data/communities.txt.tmp");
+    for (auto const &[id, c] : communityDB)
+        commFile << formatCommunityRow(c) << "\n";
+    commFile.close();
+
+    ofstream chatFile("data/chats.txt.tmp");
+    for (auto const &[commId, comm] : communityDB)
+        for (const auto &msg : comm.chatHistory.tail())
+            chatFile << formatChatRow(commId, msg) << "\n";
+    chatFile.close();
+
+    ofstream dmOut("data/dms.txt.tmp");
+    for (auto const &[key, chat] : dmDB)
+        for (const auto &m : chat.messages.tail())
+            dmOut << formatDMRow(key, m) << "\n";
     dmOut.close();
+
+    // Every row is on disk in its .tmp file before any live file is replaced,
+    // and the log is only cleared once all five have been swapped in. Replaying
+    // the log over a half-committed snapshot is harmless: records are upserts.
+    commitFile("data/users.txt");
+    commitFile("data/graph.txt");
+    commitFile("data/communities.txt");
+    commitFile("data/chats.txt");
+    commitFile("data/dms.txt");
+    wal.reset();
 }
 
 string NovaGraph::sendConnectionRequest(int senderId, int targetId)
@@ -550,14 +846,15 @@ string NovaGraph::sendConnectionRequest(int senderId, int targetId)
         return "error_user_not_found";
     if (senderId == targetId)
         return "error_self";
-    vector<int> &friends = adjList[senderId];
-    if (find(friends.begin(), friends.end(), targetId) != friends.end())
+    const FriendGraph &g = friendView();
+    int a = g.indexOf(senderId), b = g.indexOf(targetId);
+    if (a >= 0 && b >= 0 && binary_search(g.begin(a), g.end(a), b))
         return "already_friends";
     User &target = userDB[targetId];
     if (target.pendingRequests.count(senderId))
         return "request_pending";
     target.pendingRequests.insert(senderId);
-    saveData();
+    logRecord("USER", formatUserRow(target));
     return "request_sent";
 }
 
@@ -570,7 +867,9 @@ void NovaGraph::acceptConnectionRequest(int userId, int requesterId)
     {
         me.pendingRequests.erase(requesterId);
         addFriendship(userId, requesterId);
-        saveData();
+        logRecord("USER", formatUserRow(me));
+        logRecord("GRAPH", formatGraphRow(userId, adjList[userId]));
+        logRecord("GRAPH", formatGraphRow(requesterId, adjList[requesterId]));
     }
 }
 
@@ -582,38 +881,40 @@ void NovaGraph::declineConnectionRequest(int userId, int requesterId)
     if (me.pendingRequests.count(requesterId))
     {
         me.pendingRequests.erase(requesterId);
-        saveData();
+        logRecord("USER", formatUserRow(me));
     }
 }
 
-string NovaGraph::getPendingRequestsJSON(int userId)
+void NovaGraph::getPendingRequestsJSON(JsonWriter &json, int userId)
 {
-    if (userDB.find(userId) == userDB.end())
-        return "[]";
-    User &me = userDB[userId];
-    string json = "[";
-    int count = 0;
-    for (int rid : me.pendingRequests)
+    json.beginArray();
+    if (userDB.find(userId) != userDB.end())
     {
-        if (userDB.find(rid) != userDB.end())
+        User &me = userDB[userId];
+        for (int rid : me.pendingRequests)
         {
-            User &r = userDB[rid];
-            if (count > 0)
-                json += ", ";
-            json += "{ \"id\": " + to_string(r.id) + ", \"name\": \"" + jsonEscape(r.username) + "\", \"avatar\": \"" + jsonEscape(r.avatarUrl) + "\", \"karma\": " + to_string(r.karma) + " }";
-            count++;
+            if (userDB.find(rid) != userDB.end())
+            {
+                User &r = userDB[rid];
+                json.beginObject()
+                    .field("id", r.id)
+                    .field("name", r.username)
+                    .field("avatar", r.avatarUrl)
+                    .field("karma", r.karma)
+                    .endObject();
+            }
         }
     }
-    json += "]";
-    return json;
+    json.endArray();
 }
 
 string NovaGraph::getRelationshipStatus(int me, int target)
 {
     if (me == target)
         return "self";
-    vector<int> &friends = adjList[me];
-    if (find(friends.begin(), friends.end(), target) != friends.end())
+    const FriendGraph &g = friendView();
+    int a = g.indexOf(me), b = g.indexOf(target);
+    if (a >= 0 && b >= 0 && binary_search(g.begin(a), g.end(a), b))
         return "friend";
     if (userDB[target].pendingRequests.count(me))
         return "pending_sent";
@@ -625,9 +926,10 @@ string NovaGraph::getRelationshipStatus(int me, int target)
 void NovaGraph::sendDirectMessage(int senderId, int receiverId, string content, int replyToId, string type, string mediaUrl)
 {
     string key = getDMKey(senderId, receiverId);
+    DirectChat &chat = directChat(key);
 
     DirectMessage m;
-    m.id = dmDB[key].nextMsgId++;
+    m.id = chat.nextMsgId++;
     m.senderId = senderId;
     m.content = sanitize(content);
     m.timestamp = getCurrentTime();
@@ -635,168 +937,308 @@ void NovaGraph::sendDirectMessage(int senderId, int receiverId, string content,
     m.reaction = "";
     m.isSeen = false;
     m.type = type;
-    m.mediaUrl = (mediaUrl.empty() ? "NONE" : sanitize(mediaUrl));
+    m.mediaUrl = (mediaUrl.empty() ? "NONE" : blobs.intern(sanitize(mediaUrl)));
+
+    chat.lowId = min(senderId, receiverId);
+    chat.highId = max(senderId, receiverId);
+    chat.messages.append(m);
+    indexMessage(chat.textIndex, m);
+    chat.unseenFrom(senderId)++;
+    chat.changes.touch();
+    publish(chat);
+    dmIndex[senderId].insert(key);
+    dmIndex[receiverId].insert(key);
+    logRecord("DM", formatDMRow(key, m));
+}
 
-    dmDB[key].chatKey = key;
-    dmDB[key].messages.push_back(m);
-    saveData();
+void NovaGraph::reactToDirectMessage(int senderId, int receiverId, int msgId, string reaction)
+{
+    string key = getDMKey(senderId, receiverId);
+    auto found = dmDB.find(key);
+    if (found == dmDB.end())
+        return;
+    DirectChat &chat = found->second;
+    DirectMessage *m = chat.messages.find(msgId);
+    if (m)
+    {
+        m->reaction = reaction;
+        chat.changes.edited(msgId);
+        publish(chat);
+        logRecord("DM", formatDMRow(key, *m));
+    }
+}
+
+// Live slots of the messages newer than lastId, oldest first; fails when
+// there are more than `limit` of them.
+template <class T>
+bool slotsAfter(MessageLog<T> &log, int lastId, size_t limit, vector<size_t> &slots)
+{
+    for (size_t slot = log.slotCount(); slot-- > 0;)
+    {
+        if (!log.isLive(slot))
+            continue;
+        if (log.view(slot).id <= lastId)
+            break;
+        if (slots.size() == limit)
+            return false;
+        slots.push_back(slot);
+    }
+    reverse(slots.begin(), slots.end());
+    return true;
+}
+
+// Messages the client already holds (id <= lastId) that were edited or
+// deleted after version `since`.
+set<int> editedSince(const ChangeRing &ring, uint64_t since, int lastId)
+{
+    set<int> ids;
+    for (auto it = ring.edits.rbegin(); it != ring.edits.rend() && it->first > since; ++it)
+        if (it->second <= lastId)
+            ids.insert(it->second);
+    return ids;
+}
+
+string NovaGraph::syncToken(const ChangeRing &ring) const
+{
+    return syncEpoch + ":" + to_string(ring.version);
+}
+
+// Versions restart with the process, so a token from an earlier run (or one
+// older than the ring remembers) cannot be answered with a delta.
+bool NovaGraph::readSyncToken(const string &token, const ChangeRing &ring, uint64_t &since) const
+{
+    size_t colon = token.find(':');
+    if (colon == string::npos || token.substr(0, colon) != syncEpoch)
+        return false;
+    try
+    {
+        since = stoull(token.substr(colon + 1));
+    }
+    catch (...)
+    {
+        return false;
+    }
+    return ring.covers(since);
+}
+
+// Unseen messages are always the newest ones from that sender.
+void NovaGraph::markSeen(DirectChat &chat, int friendId)
+{
+    int remaining = chat.unseenFrom(friendId);
+    if (remaining == 0)
+        return;
+    for (size_t slot = chat.messages.slotCount(); slot-- > 0 && remaining > 0;)
+    {
+        if (!chat.messages.isLive(slot))
+            continue;
+        DirectMessage &m = chat.messages.at(slot);
+        if (m.senderId == friendId && !m.isSeen)
+        {
+            m.isSeen = true;
+            chat.changes.edited(m.id);
+            publish(chat);
+            remaining--;
+        }
+    }
+    chat.unseenFrom(friendId) = 0;
+    logRecord("SEEN", chat.chatKey + "|" + to_string(friendId));
 }
 
-void NovaGraph::reactToDirectMessage(int senderId, int receiverId, int msgId, string reaction)
+void NovaGraph::writeDirectMessageJSON(JsonWriter &json, DirectChat &chat, const DirectMessage &m)
 {
-    string key = getDMKey(senderId, receiverId);
-    if (dmDB.find(key) != dmDB.end())
+    string replyPreview = "";
+    const DirectMessage *orig = (m.replyToMsgId != -1) ? chat.messages.lookup(m.replyToMsgId) : nullptr;
+    if (orig)
     {
-        for (auto &m : dmDB[key].messages)
-        {
-            if (m.id == msgId)
-            {
-                m.reaction = reaction;
-                saveData();
-                return;
-            }
-        }
+        string previewText = (orig->type == "image") ? "[Image]" : orig->content;
+        replyPreview = sanitize(previewText.substr(0, 30));
     }
+
+    json.beginObject()
+        .field("id", m.id)
+        .field("senderId", m.senderId)
+        .field("content", m.content)
+        .field("time", m.timestamp)
+        .field("replyTo", m.replyToMsgId)
+        .field("replyPreview", replyPreview)
+        .field("reaction", m.reaction)
+        .field("isSeen", m.isSeen)
+        .field("type", m.type)
+        .field("mediaUrl", m.mediaUrl)
+        .endObject();
 }
 
-string NovaGraph::getDirectChatJSON(int viewerId, int friendId, int offset, int limit)
+void NovaGraph::getDirectChatJSON(JsonWriter &json, int viewerId, int friendId, int offset, int limit)
 {
     string key = getDMKey(viewerId, friendId);
 
-    bool stateChanged = false;
-    if (dmDB.find(key) != dmDB.end())
+    json.beginObject().field("friend_id", friendId);
+    auto found = dmDB.find(key);
+    if (found == dmDB.end())
     {
-        for (auto &m : dmDB[key].messages)
-        {
-            if (m.senderId == friendId && !m.isSeen)
-            {
-                m.isSeen = true;
-                stateChanged = true;
-            }
-        }
+        json.field("total_msgs", 0).key("messages").beginArray().endArray().endObject();
+        return;
     }
-    if (stateChanged)
-        saveData();
 
-    if (dmDB.find(key) == dmDB.end())
+    DirectChat &chat = found->second;
+    markSeen(chat, friendId);
+    vector<size_t> window = chat.messages.page(max(offset, 0), max(limit, 0));
+    json.field("total_msgs", chat.messages.size())
+        .field("sync_token", syncToken(chat.changes))
+        .key("messages")
+        .beginArray();
+    for (size_t slot : window)
+        writeDirectMessageJSON(json, chat, chat.messages.view(slot));
+    json.endArray().endObject();
+    chat.messages.trim();
+}
+
+void NovaGraph::getDirectSyncJSON(JsonWriter &json, int viewerId, int friendId, const string &token, int lastId)
+{
+    json.beginObject();
+    auto found = dmDB.find(getDMKey(viewerId, friendId));
+    if (found == dmDB.end())
     {
-        return "{ \"friend_id\": " + to_string(friendId) + ", \"total_msgs\": 0, \"messages\": [] }";
+        json.field("status", "resync").endObject();
+        return;
     }
 
-    const auto &allMsgs = dmDB[key].messages;
-    int total = allMsgs.size();
-    int end = total - offset;
-    int start = max(0, end - limit);
-
-    string json = "{ \"friend_id\": " + to_string(friendId) +
-                  ", \"total_msgs\": " + to_string(total) +
-                  ", \"messages\": [";
-
-    for (int i = start; i < end; i++)
+    DirectChat &chat = found->second;
+    markSeen(chat, friendId);
+    uint64_t since = 0;
+    if (!readSyncToken(token, chat.changes, since))
     {
-        if (i < 0 || i >= total)
-            continue;
-        const auto &m = allMsgs[i];
-
-        string replyPreview = "";
-        if (m.replyToMsgId != -1)
-        {
-            for (const auto &orig : allMsgs)
-            {
-                if (orig.id == m.replyToMsgId)
-                {
-                    string previewText = (orig.type == "image") ? "[Image]" : orig.content;
-                    replyPreview = sanitize(previewText.substr(0, 30));
-                    break;
-                }
-            }
-        }
+        json.field("status", "resync").endObject();
+        return;
+    }
+    if (since == chat.changes.version)
+    {
+        json.field("status", "not_modified").field("token", syncToken(chat.changes)).endObject();
+        return;
+    }
+    vector<size_t> fresh;
+    if (!slotsAfter(chat.messages, lastId, SYNC_NEW_LIMIT, fresh))
+    {
+        json.field("status", "resync").endObject();
+        return;
+    }
 
-        json += "{ \"id\": " + to_string(m.id) +
-                ", \"senderId\": " + to_string(m.senderId) +
-                ", \"content\": \"" + jsonEscape(m.content) + "\"" +
-                ", \"time\": \"" + m.timestamp + "\"" +
-                ", \"replyTo\": " + to_string(m.replyToMsgId) +
-                ", \"replyPreview\": \"" + jsonEscape(replyPreview) + "\"" +
-                ", \"reaction\": \"" + m.reaction + "\"" +
-                ", \"isSeen\": " + (m.isSeen ? "true" : "false") +
-                ", \"type\": \"" + m.type + "\"" +
-                ", \"mediaUrl\": \"" + jsonEscape(m.mediaUrl) + "\" }";
+    vector<int> deleted;
+    json.field("status", "delta")
+        .field("token", syncToken(chat.changes))
+        .field("friend_id", friendId)
+        .field("total_msgs", chat.messages.size())
+        .key("messages")
+        .beginArray();
+    for (int id : editedSince(chat.changes, since, lastId))
+    {
+        const DirectMessage *m = chat.messages.lookup(id);
+        if (m)
+            writeDirectMessageJSON(json, chat, *m);
+        else
+            deleted.push_back(id);
+    }
+    for (size_t slot : fresh)
+        writeDirectMessageJSON(json, chat, chat.messages.view(slot));
+    json.endArray().key("deleted").beginArray();
+    for (int id : deleted)
+        json.value(id);
+    json.endArray().endObject();
+    chat.messages.trim();
+}
 
-        if (i < end - 1)
-            json += ", ";
+void NovaGraph::searchDirectMessagesJSON(JsonWriter &json, int viewerId, int friendId, const string &query, size_t limit)
+{
+    json.beginArray();
+    auto found = dmDB.find(getDMKey(viewerId, friendId));
+    if (found == dmDB.end())
+    {
+        json.endArray();
+        return;
+    }
+    DirectChat &chat = found->second;
+    for (int id : searchLog(chat.textIndex, chat.messages, query, limit))
+    {
+        const DirectMessage *m = chat.messages.lookup(id);
+        if (m)
+            writeDirectMessageJSON(json, chat, *m);
     }
-    json += "] }";
-    return json;
+    json.endArray();
+    chat.messages.trim();
 }
 
 void NovaGraph::deleteDirectMessage(int userId, int friendId, int msgId)
 {
     string key = getDMKey(userId, friendId);
 
-    if (dmDB.find(key) != dmDB.end())
-    {
-        auto &msgs = dmDB[key].messages;
-        for (auto it = msgs.begin(); it != msgs.end(); ++it)
-        {
-            if (it->id == msgId)
-            {
-                if (it->senderId == userId)
-                {
-                    msgs.erase(it);
-                    saveData();
-                }
-                return;
-            }
-        }
+    auto found = dmDB.find(key);
+    if (found == dmDB.end())
+        return;
+    DirectChat &chat = found->second;
+    DirectMessage *m = chat.messages.find(msgId);
+    if (m && m->senderId == userId)
+    {
+        if (!m->isSeen)
+            chat.unseenFrom(userId)--;
+        unindexMessage(chat.textIndex, *m);
+        chat.messages.erase(msgId);
+        chat.changes.edited(msgId);
+        publish(chat);
+        logRecord("DEL_DM", key + "|" + to_string(msgId));
     }
 }
 
-string NovaGraph::getActiveDMsJSON(int userId)
+void NovaGraph::getActiveDMsJSON(JsonWriter &json, int userId)
 {
-    string json = "[";
-    int count = 0;
-    for (auto const &[key, chat] : dmDB)
+    json.beginArray();
+    auto keys = dmIndex.find(userId);
+    if (keys == dmIndex.end())
     {
-        size_t underscore = key.find('_');
-        if (underscore == string::npos)
+        json.endArray();
+        return;
+    }
+    for (const string &key : keys->second)
+    {
+        auto found = dmDB.find(key);
+        if (found == dmDB.end())
             continue;
-        int u = safeStoi(key.substr(0, underscore));
-        int v = safeStoi(key.substr(underscore + 1));
-        int otherId = (u == userId) ? v : (v == userId ? u : -1);
-        if (otherId != -1 && userDB.find(otherId) != userDB.end())
+        DirectChat &chat = found->second;
+        int otherId = chat.partnerOf(userId);
+        auto otherIt = userDB.find(otherId);
+        if (otherIt == userDB.end())
+            continue;
+        const User &other = otherIt->second;
+        string lastMsg = "No messages";
+        string time = "";
+        int lastSenderId = -1;
+        bool isLastSeen = false;
+        if (!chat.messages.empty())
         {
-            User &other = userDB[otherId];
-            string lastMsg = "No messages";
-            string time = "";
-            int unreadCount = 0;
-            int lastSenderId = -1;
-            bool isLastSeen = false;
-            if (!chat.messages.empty())
-            {
-                const auto &last = chat.messages.back();
-                lastMsg = last.content;
-                time = last.timestamp;
-                lastSenderId = last.senderId;
-                isLastSeen = last.isSeen;
-                if (lastMsg.length() > 30)
-                    lastMsg = lastMsg.substr(0, 30) + "...";
-                for (const auto &m : chat.messages)
-                    if (m.senderId == otherId && !m.isSeen)
-                        unreadCount++;
-            }
-            if (count > 0)
-                json += ", ";
-            json += "{ \"id\": " + to_string(other.id) + ", \"name\": \"" + jsonEscape(other.username) + "\", \"avatar\": \"" + jsonEscape(other.avatarUrl) + "\", \"last_msg\": \"" + jsonEscape(lastMsg) + "\", \"time\": \"" + time + "\", \"unread\": " + to_string(unreadCount) + ", \"lastSender\": " + to_string(lastSenderId) + ", \"lastSeen\": " + (isLastSeen ? "true" : "false") + " }";
-            count++;
+            const auto &last = *chat.messages.back();
+            lastMsg = last.content;
+            time = last.timestamp;
+            lastSenderId = last.senderId;
+            isLastSeen = last.isSeen;
+            if (lastMsg.length() > 30)
+                lastMsg = lastMsg.substr(0, 30) + "...";
         }
+        json.beginObject()
+            .field("id", other.id)
+            .field("name", other.username)
+            .field("avatar", other.avatarUrl)
+            .field("last_msg", lastMsg)
+            .field("time", time)
+            .field("unread", chat.unseenFrom(otherId))
+            .field("lastSender", lastSenderId)
+            .field("lastSeen", isLastSeen)
+            .endObject();
     }
-    json += "]";
-    return json;
+    json.endArray();
 }
 
 void NovaGraph::removeFriendship(int u, int v)
 {
+    friendshipChanged(u, v);
     if (adjList.find(u) != adjList.end())
     {
         auto &friends = adjList[u];
@@ -807,7 +1249,11 @@ void NovaGraph::removeFriendship(int u, int v)
         auto &friends = adjList[v];
         friends.erase(remove(friends.begin(), friends.end(), u), friends.end());
     }
-    saveData();
+    friendGraph.removeEdge(u, v);
+    if (adjList.count(u))
+        logRecord("GRAPH", formatGraphRow(u, adjList[u]));
+    if (adjList.count(v))
+        logRecord("GRAPH", formatGraphRow(v, adjList[v]));
 }
 
 int NovaGraph::registerUser(string username, string email, string password, string avatar, string tags)
@@ -828,12 +1274,13 @@ int NovaGraph::registerUser(string username, string email, string password, stri
     u.username = username;
     u.email = email;
     u.password = password;
-    u.avatarUrl = avatar;
+    u.avatarUrl = blobs.intern(avatar);
     u.tags = split(tags, ',');
     u.karma = 0;
     userDB[newId] = u;
     usernameIndex[username] = newId;
-    saveData();
+    userIndex.add(u);
+    logRecord("USER", formatUserRow(u));
     return newId;
 }
 
@@ -851,10 +1298,12 @@ void NovaGraph::updateUserProfile(int id, string email, string avatar, string ta
 {
     if (userDB.find(id) != userDB.end())
     {
+        userIndex.remove(userDB[id]);
         userDB[id].email = email;
-        userDB[id].avatarUrl = avatar;
+        userDB[id].avatarUrl = blobs.intern(avatar);
         userDB[id].tags = split(tags, ',');
-        saveData();
+        userIndex.add(userDB[id]);
+        logRecord("USER", formatUserRow(userDB[id]));
     }
 }
 
@@ -867,6 +1316,7 @@ void NovaGraph::addUser(int id, string username)
     u.username = username;
     u.karma = 0;
     userDB[id] = u;
+    userIndex.add(u);
 }
 
 void NovaGraph::deleteUser(int id)
@@ -875,6 +1325,7 @@ void NovaGraph::deleteUser(int id)
         return;
     string username = userDB[id].username;
     usernameIndex.erase(username);
+    userIndex.remove(userDB[id]);
     userDB.erase(id);
     adjList.erase(id);
     for (auto &[otherId, friends] : adjList)
@@ -883,13 +1334,34 @@ void NovaGraph::deleteUser(int id)
         if (it != friends.end())
             friends.erase(it, friends.end());
     }
-    for (auto &[commId, c] : communityDB)
-    {
-        c.members.erase(id);
-        c.moderators.erase(id);
-        c.admins.erase(id);
-        c.bannedUsers.erase(id);
+    friendGraph.markDirty();
+    auto roles = communityRoles.find(id);
+    if (roles != communityRoles.end())
+    {
+        set<int> touched = roles->second.joined;
+        touched.insert(roles->second.moderated.begin(), roles->second.moderated.end());
+        touched.insert(roles->second.admin.begin(), roles->second.admin.end());
+        touched.insert(roles->second.banned.begin(), roles->second.banned.end());
+        for (int commId : touched)
+        {
+            auto it = communityDB.find(commId);
+            if (it == communityDB.end())
+                continue;
+            Community &c = it->second;
+            c.members.erase(id);
+            c.moderators.erase(id);
+            c.admins.erase(id);
+            c.bannedUsers.erase(id);
+            communityRanking.update(commId, c.members.size());
+            c.changes.touch();
+            publish(c);
+        }
+        communityRoles.erase(roles);
     }
+    recCache.clear();
+    recMembershipsDirty = true;
+    graphChanges++;
+    // Deleting a user cascades through every row type; compact instead of logging each touched row.
     saveData();
 }
 
@@ -902,19 +1374,34 @@ void NovaGraph::addFriendship(int u, int v)
         return;
     adjList[u].push_back(v);
     adjList[v].push_back(u);
+    friendGraph.addEdge(u, v);
+    friendshipChanged(u, v);
+}
+
+const FriendGraph &NovaGraph::friendView()
+{
+    if (friendGraph.isDirty())
+        friendGraph.build(adjList);
+    return friendGraph;
 }
 
 void NovaGraph::createCommunity(string name, string desc, string tags, int creatorId, string coverUrl)
 {
-    Community c;
-    c.id = nextCommunityId++;
+    int id = nextCommunityId++;
+    Community &c = communityDB[id];
+    c.id = id;
     c.name = name;
     c.description = desc;
-    c.coverUrl = coverUrl;
+    c.coverUrl = blobs.intern(coverUrl);
     c.tags = split(tags, ',');
     c.members.insert(creatorId);
     c.moderators.insert(creatorId);
-    communityDB[c.id] = c;
+    attachHistory(c);
+    syncCommunityRoles(c, creatorId);
+    c.changes.touch();
+    publish(c);
+    logRecord("COMM", formatCommunityRow(c));
+    membershipChanged(creatorId);
 }
 
 void NovaGraph::joinCommunity(int userId, int commId)
@@ -927,6 +1414,11 @@ void NovaGraph::joinCommunity(int userId, int commId)
         c.members.insert(userId);
         if (c.moderators.empty())
             c.moderators.insert(userId);
+        syncCommunityRoles(c, userId);
+        c.changes.touch();
+        publish(c);
+        logRecord("COMM", formatCommunityRow(c));
+        membershipChanged(userId);
     }
 }
 
@@ -942,8 +1434,16 @@ void NovaGraph::leaveCommunity(int userId, int commId)
         {
             c.moderators.erase(userId);
             if (c.moderators.empty() && !c.members.empty())
+            {
                 c.moderators.insert(*c.members.begin());
+                syncCommunityRoles(c, *c.members.begin());
+            }
         }
+        syncCommunityRoles(c, userId);
+        c.changes.touch();
+        publish(c);
+        logRecord("COMM", formatCommunityRow(c));
+        membershipChanged(userId);
     }
 }
 
@@ -963,23 +1463,28 @@ void NovaGraph::addMessage(int commId, int senderId, string content, string type
             m.upvoters.clear();
             m.isPinned = false;
             m.type = type;
-            m.mediaUrl = (mediaUrl.empty() ? "NONE" : sanitize(mediaUrl));
+            m.mediaUrl = (mediaUrl.empty() ? "NONE" : blobs.intern(sanitize(mediaUrl)));
             m.replyToId = replyToId;
 
-            c.chatHistory.push_back(m);
-            saveData();
+            c.chatHistory.append(m);
+            indexMessage(c.textIndex, m);
+            communityRanking.touch(commId);
+            c.changes.touch();
+            publish(c);
+            logRecord("CHAT", formatChatRow(commId, m));
         }
     }
 }
 
-void NovaGraph::votePoll(int commId, int userId, int msgIndex, int optionIndex)
+void NovaGraph::votePoll(int commId, int userId, int msgId, int optionIndex)
 {
     if (communityDB.find(commId) != communityDB.end())
     {
         Community &c = communityDB[commId];
-        if (msgIndex >= 0 && msgIndex < c.chatHistory.size())
+        Message *found = c.chatHistory.find(msgId);
+        if (found)
         {
-            Message &m = c.chatHistory[msgIndex];
+            Message &m = *found;
             if (m.type != "POLL")
                 return;
             size_t pipePos = m.content.find('|');
@@ -1001,7 +1506,9 @@ void NovaGraph::votePoll(int commId, int userId, int msgIndex, int optionIndex)
             for (size_t i = 0; i < opts.size(); i++)
                 newC += opts[i] + (i < opts.size() - 1 ? "," : "");
             m.content = newC;
-            saveData();
+            c.changes.edited(msgId);
+            publish(c);
+            logRecord("CHAT", formatChatRow(commId, m));
         }
     }
 }
@@ -1014,7 +1521,10 @@ void NovaGraph::promoteToAdmin(int commId, int actorId, int targetId)
         if (c.moderators.count(actorId))
         {
             c.admins.insert(targetId);
-            saveData();
+            syncCommunityRoles(c, targetId);
+            c.changes.touch();
+            publish(c);
+            logRecord("COMM", formatCommunityRow(c));
         }
     }
 }
@@ -1027,7 +1537,10 @@ void NovaGraph::demoteAdmin(int commId, int actorId, int targetId)
         if (c.moderators.count(actorId))
         {
             c.admins.erase(targetId);
-            saveData();
+            syncCommunityRoles(c, targetId);
+            c.changes.touch();
+            publish(c);
+            logRecord("COMM", formatCommunityRow(c));
         }
     }
 }
@@ -1042,7 +1555,11 @@ void NovaGraph::transferOwnership(int commId, int actorId, int targetId)
             c.moderators.erase(actorId);
             c.moderators.insert(targetId);
             c.admins.erase(targetId);
-            saveData();
+            syncCommunityRoles(c, actorId);
+            syncCommunityRoles(c, targetId);
+            c.changes.touch();
+            publish(c);
+            logRecord("COMM", formatCommunityRow(c));
         }
     }
 }
@@ -1062,7 +1579,11 @@ void NovaGraph::banUser(int commId, int actorId, int targetId)
             c.members.erase(targetId);
             c.admins.erase(targetId);
             c.bannedUsers.insert(targetId);
-            saveData();
+            syncCommunityRoles(c, targetId);
+            c.changes.touch();
+            publish(c);
+            logRecord("COMM", formatCommunityRow(c));
+            membershipChanged(targetId);
         }
         else if (isAdmin)
         {
@@ -1070,7 +1591,11 @@ void NovaGraph::banUser(int commId, int actorId, int targetId)
             {
                 c.members.erase(targetId);
                 c.bannedUsers.insert(targetId);
-                saveData();
+                syncCommunityRoles(c, targetId);
+                c.changes.touch();
+                publish(c);
+                logRecord("COMM", formatCommunityRow(c));
+                membershipChanged(targetId);
             }
         }
     }
@@ -1086,79 +1611,98 @@ void NovaGraph::unbanUser(int commId, int adminId, int targetId)
         if (isMod || isAdmin)
         {
             c.bannedUsers.erase(targetId);
-            saveData();
+            syncCommunityRoles(c, targetId);
+            c.changes.touch();
+            publish(c);
+            logRecord("COMM", formatCommunityRow(c));
         }
     }
 }
 
-void NovaGraph::deleteMessage(int commId, int adminId, int msgIndex)
+void NovaGraph::deleteMessage(int commId, int adminId, int msgId)
 {
     if (communityDB.find(commId) != communityDB.end())
     {
         Community &c = communityDB[commId];
         bool isMod = c.moderators.count(adminId);
         bool isAdmin = c.admins.count(adminId);
-        if ((isMod || isAdmin) && msgIndex >= 0 && msgIndex < c.chatHistory.size())
+        const Message *target = (isMod || isAdmin) ? c.chatHistory.lookup(msgId) : nullptr;
+        if (target)
         {
-            c.chatHistory.erase(c.chatHistory.begin() + msgIndex);
-            saveData();
+            unindexMessage(c.textIndex, *target);
+            c.chatHistory.erase(msgId);
+            c.pinnedIds.erase(msgId);
+            c.changes.edited(msgId);
+            publish(c);
+            logRecord("DEL_CHAT", to_string(commId) + "|" + to_string(msgId));
         }
     }
 }
 
-void NovaGraph::pinMessage(int commId, int adminId, int msgIndex)
+void NovaGraph::pinMessage(int commId, int adminId, int msgId)
 {
     if (communityDB.find(commId) != communityDB.end())
     {
         Community &c = communityDB[commId];
         bool isMod = c.moderators.count(adminId);
         bool isAdmin = c.admins.count(adminId);
-        if ((isMod || isAdmin) && msgIndex >= 0 && msgIndex < c.chatHistory.size())
+        Message *target = (isMod || isAdmin) ? c.chatHistory.find(msgId) : nullptr;
+        if (target)
         {
-            Message &targetMsg = c.chatHistory[msgIndex];
+            Message &targetMsg = *target;
             if (!targetMsg.isPinned)
             {
-                int pinCount = 0;
-                int firstPinIndex = -1;
-                for (int i = 0; i < c.chatHistory.size(); i++)
+                if (c.pinnedIds.size() >= 2)
                 {
-                    if (c.chatHistory[i].isPinned)
+                    int firstId = *c.pinnedIds.begin();
+                    c.pinnedIds.erase(c.pinnedIds.begin());
+                    Message *firstPin = c.chatHistory.find(firstId);
+                    if (firstPin)
                     {
-                        pinCount++;
-                        if (firstPinIndex == -1)
-                            firstPinIndex = i;
+                        firstPin->isPinned = false;
+                        c.changes.edited(firstId);
+                        publish(c);
+                        logRecord("CHAT", formatChatRow(commId, *firstPin));
                     }
                 }
-                if (pinCount >= 2 && firstPinIndex != -1)
-                    c.chatHistory[firstPinIndex].isPinned = false;
                 targetMsg.isPinned = true;
+                c.pinnedIds.insert(msgId);
             }
             else
             {
                 targetMsg.isPinned = false;
+                c.pinnedIds.erase(msgId);
             }
-            saveData();
+            c.changes.edited(msgId);
+            publish(c);
+            logRecord("CHAT", formatChatRow(commId, targetMsg));
         }
     }
 }
 
-void NovaGraph::upvoteMessage(int commId, int userId, int msgIndex)
+void NovaGraph::upvoteMessage(int commId, int userId, int msgId)
 {
     if (communityDB.find(commId) != communityDB.end())
     {
         Community &c = communityDB[commId];
-        if (msgIndex >= 0 && msgIndex < c.chatHistory.size())
+        Message *found = c.chatHistory.find(msgId);
+        if (found)
         {
-            Message &m = c.chatHistory[msgIndex];
+            Message &m = *found;
             if (m.upvoters.count(userId))
                 m.upvoters.erase(userId);
             else
             {
                 m.upvoters.insert(userId);
                 if (userDB.find(m.senderId) != userDB.end())
+                {
                     userDB[m.senderId].karma += 5;
+                    logRecord("USER", formatUserRow(userDB[m.senderId]));
+                }
             }
-            saveData();
+            c.changes.edited(msgId);
+            publish(c);
+            logRecord("CHAT", formatChatRow(commId, m));
         }
     }
 }
@@ -1187,8 +1731,12 @@ void NovaGraph::createPoll(int commId, int senderId, string question, bool allow
                 o.text = txt;
                 m.poll.options.push_back(o);
             }
-            c.chatHistory.push_back(m);
-            saveData();
+            c.chatHistory.append(m);
+            indexMessage(c.textIndex, m);
+            communityRanking.touch(commId);
+            c.changes.touch();
+            publish(c);
+            logRecord("CHAT", formatChatRow(commId, m));
         }
     }
 }
@@ -1198,60 +1746,61 @@ void NovaGraph::togglePollVote(int commId, int userId, int msgId, int optionId)
     if (communityDB.find(commId) == communityDB.end())
         return;
     Community &c = communityDB[commId];
-    for (auto &m : c.chatHistory)
-    {
-        if (m.id == msgId && m.type == "poll")
+    Message *found = c.chatHistory.find(msgId);
+    if (!found || found->type != "poll")
+        return;
+    Message &m = *found;
+    bool alreadyVotedThis = false;
+    for (auto &opt : m.poll.options)
+        if (opt.id == optionId && opt.voterIds.count(userId))
         {
-            bool alreadyVotedThis = false;
-            for (auto &opt : m.poll.options)
-                if (opt.id == optionId && opt.voterIds.count(userId))
-                {
-                    alreadyVotedThis = true;
-                    break;
-                }
-            if (alreadyVotedThis)
-            {
-                for (auto &opt : m.poll.options)
-                    if (opt.id == optionId)
-                        opt.voterIds.erase(userId);
-            }
-            else
-            {
-                if (!m.poll.allowMultiple)
-                    for (auto &opt : m.poll.options)
-                        opt.voterIds.erase(userId);
-                for (auto &opt : m.poll.options)
-                    if (opt.id == optionId)
-                        opt.voterIds.insert(userId);
-            }
-            saveData();
-            return;
+            alreadyVotedThis = true;
+            break;
         }
+    if (alreadyVotedThis)
+    {
+        for (auto &opt : m.poll.options)
+            if (opt.id == optionId)
+                opt.voterIds.erase(userId);
+    }
+    else
+    {
+        if (!m.poll.allowMultiple)
+            for (auto &opt : m.poll.options)
+                opt.voterIds.erase(userId);
+        for (auto &opt : m.poll.options)
+            if (opt.id == optionId)
+                opt.voterIds.insert(userId);
     }
+    c.changes.edited(msgId);
+    publish(c);
+    logRecord("CHAT", formatChatRow(commId, m));
 }
 
-string NovaGraph::getCommunityMembersJSON(int commId)
+void NovaGraph::getCommunityMembersJSON(JsonWriter &json, int commId)
 {
+    json.beginArray();
     if (communityDB.find(commId) == communityDB.end())
-        return "[]";
+    {
+        json.endArray();
+        return;
+    }
     Community &c = communityDB[commId];
-    string json = "[";
-    int count = 0;
 
     auto addUserToJSON = [&](int uid, bool isBanned)
     {
         if (userDB.find(uid) != userDB.end())
         {
             User &u = userDB[uid];
-            bool isMod = c.moderators.count(uid);
-            bool isAdmin = c.admins.count(uid);
-            if (count > 0)
-                json += ", ";
-            json += "{ \"id\": " + to_string(u.id) + ", \"name\": \"" + jsonEscape(u.username) + "\", \"avatar\": \"" + jsonEscape(u.avatarUrl) + "\", \"karma\": " + to_string(u.karma) +
-                    ", \"is_mod\": " + (isMod ? "true" : "false") +
-                    ", \"is_admin\": " + (isAdmin ? "true" : "false") +
-                    ", \"is_banned\": " + (isBanned ? "true" : "false") + " }";
-            count++;
+            json.beginObject()
+                .field("id", u.id)
+                .field("name", u.username)
+                .field("avatar", u.avatarUrl)
+                .field("karma", u.karma)
+                .field("is_mod", c.moderators.count(uid) > 0)
+                .field("is_admin", c.admins.count(uid) > 0)
+                .field("is_banned", isBanned)
+                .endObject();
         }
     };
 
@@ -1260,480 +1809,542 @@ string NovaGraph::getCommunityMembersJSON(int commId)
     for (int bid : c.bannedUsers)
         addUserToJSON(bid, true);
 
-    json += "]";
-    return json;
+    json.endArray();
 }
 
-string NovaGraph::getUserJSON(int id)
+void NovaGraph::getBlobJSON(JsonWriter &json, string key)
 {
-    if (userDB.find(id) == userDB.end())
-        return "{}";
-    User &u = userDB[id];
-    string tagJson = "[";
-    for (size_t i = 0; i < u.tags.size(); i++)
-        tagJson += "\"" + jsonEscape(u.tags[i]) + "\"" + (i < u.tags.size() - 1 ? "," : "");
-    tagJson += "]";
-    return "{ \"id\": " + to_string(id) + ", \"name\": \"" + jsonEscape(u.username) + "\", \"email\": \"" + jsonEscape(u.email) + "\", \"avatar\": \"" + jsonEscape(u.avatarUrl) + "\", \"karma\": " + to_string(u.karma) + ", \"tags\": " + tagJson + " }";
+    string payload;
+    json.beginObject();
+    if (!blobs.get(key, payload))
+        json.field("error", "Blob not found");
+    else
+        json.field("key", key).field("data", payload);
+    json.endObject();
+}
+
+void NovaGraph::getUserJSON(JsonWriter &json, int id)
+{
+    json.beginObject();
+    if (userDB.find(id) != userDB.end())
+    {
+        User &u = userDB[id];
+        json.field("id", id)
+            .field("name", u.username)
+            .field("email", u.email)
+            .field("avatar", u.avatarUrl)
+            .field("karma", u.karma)
+            .key("tags")
+            .beginArray();
+        for (const string &t : u.tags)
+            json.value(t);
+        json.endArray();
+    }
+    json.endObject();
 }
 
-string NovaGraph::getFriendListJSON(int id)
+void NovaGraph::getFriendListJSON(JsonWriter &json, int id)
 {
-    string json = "[";
+    json.beginArray();
     if (adjList.find(id) != adjList.end())
     {
         vector<int> friends = adjList[id];
         sort(friends.begin(), friends.end());
         friends.erase(unique(friends.begin(), friends.end()), friends.end());
-        vector<int> validFriends;
-        for (int f : friends)
-            if (userDB.find(f) != userDB.end())
-                validFriends.push_back(f);
-
-        for (size_t i = 0; i < validFriends.size(); ++i)
+        for (int fid : friends)
         {
-            User &f = userDB[validFriends[i]];
-            json += "{ \"id\": " + to_string(f.id) + ", \"name\": \"" + jsonEscape(f.username) + "\", \"avatar\": \"" + jsonEscape(f.avatarUrl) + "\", \"karma\": " + to_string(f.karma) + " }";
-            if (i < validFriends.size() - 1)
-                json += ", ";
+            if (userDB.find(fid) == userDB.end())
+                continue;
+            User &f = userDB[fid];
+            json.beginObject()
+                .field("id", f.id)
+                .field("name", f.username)
+                .field("avatar", f.avatarUrl)
+                .field("karma", f.karma)
+                .endObject();
         }
     }
-    json += "]";
-    return json;
+    json.endArray();
 }
 
-string NovaGraph::getAllCommunitiesJSON()
+void NovaGraph::getAllCommunitiesJSON(JsonWriter &json)
 {
-    string json = "[";
-    int count = 0;
+    json.beginArray();
     for (auto const &[id, c] : communityDB)
     {
-        if (count > 0)
-            json += ", ";
-        json += "{ \"id\": " + to_string(c.id) + ", \"name\": \"" + jsonEscape(c.name) + "\", \"desc\": \"" + jsonEscape(c.description) + "\", \"cover\": \"" + jsonEscape(c.coverUrl) + "\", \"members\": " + to_string(c.members.size()) + ", \"tags\": [";
-        for (size_t i = 0; i < c.tags.size(); i++)
-            json += "\"" + jsonEscape(c.tags[i]) + "\"" + (i < c.tags.size() - 1 ? "," : "");
-        json += "] }";
-        count++;
+        json.beginObject()
+            .field("id", c.id)
+            .field("name", c.name)
+            .field("desc", c.description)
+            .field("cover", c.coverUrl)
+            .field("members", c.members.size())
+            .key("tags")
+            .beginArray();
+        for (const string &t : c.tags)
+            json.value(t);
+        json.endArray().endObject();
     }
-    json += "]";
-    return json;
+    json.endArray();
 }
 
-string NovaGraph::getCommunityDetailsJSON(int commId, int userId, int offset, int limit)
+void NovaGraph::writeMessageJSON(JsonWriter &json, Community &c, const Message &m, int userId)
 {
-    if (communityDB.find(commId) == communityDB.end())
-        return "{}";
-    Community &c = communityDB[commId];
-    bool isMember = c.members.count(userId);
-    bool isMod = c.moderators.count(userId);
-    bool isAdmin = c.admins.count(userId);
-
-    string json = "{ \"id\": " + to_string(c.id) +
-                  ", \"name\": \"" + jsonEscape(c.name) + "\"" +
-                  ", \"desc\": \"" + jsonEscape(c.description) + "\"" +
-                  ", \"is_member\": " + (isMember ? "true" : "false") +
-                  ", \"is_mod\": " + (isMod ? "true" : "false") +
-                  ", \"is_admin\": " + (isAdmin ? "true" : "false") +
-                  ", \"total_msgs\": " + to_string(c.chatHistory.size()) + ", \"messages\": [";
+    auto sender = userDB.find(m.senderId);
+    const string &avatar = (sender != userDB.end()) ? sender->second.avatarUrl : "";
 
-    int total = c.chatHistory.size();
-    int end = total - offset;
-    int start = max(0, end - limit);
-
-    for (int i = start; i < end; i++)
+    string replyPreview = "";
+    const Message *orig = (m.replyToId != -1) ? c.chatHistory.lookup(m.replyToId) : nullptr;
+    if (orig)
     {
-        if (i < 0 || i >= total)
-            continue;
-        Message &m = c.chatHistory[i];
-        bool hasVoted = m.upvoters.count(userId);
-
-        string avatar = "";
-        if (userDB.find(m.senderId) != userDB.end())
-            avatar = userDB[m.senderId].avatarUrl;
-
-        string pollJson = "null";
-        if (m.type == "poll")
-        {
-            pollJson = "{ \"question\": \"" + jsonEscape(m.poll.question) + "\", \"multi\": " + (m.poll.allowMultiple ? "true" : "false") + ", \"options\": [";
-            for (size_t k = 0; k < m.poll.options.size(); k++)
-            {
-                const auto &opt = m.poll.options[k];
-                bool userVoted = opt.voterIds.count(userId);
-                pollJson += "{ \"id\": " + to_string(opt.id) + ", \"text\": \"" + jsonEscape(opt.text) + "\", \"count\": " + to_string(opt.voterIds.size()) + ", \"voted\": " + (userVoted ? "true" : "false") + " }";
-                if (k < m.poll.options.size() - 1)
-                    pollJson += ", ";
-            }
-            pollJson += "] }";
-        }
+        string txt = (orig->type == "image") ? "[Image]" : orig->content;
+        replyPreview = sanitize(txt.substr(0, 30));
+    }
 
-        string replyPreview = "";
-        if (m.replyToId != -1)
+    json.beginObject()
+        .field("id", m.id)
+        .field("sender", m.senderName)
+        .field("senderId", m.senderId)
+        .field("senderAvatar", avatar)
+        .field("content", m.content)
+        .field("type", m.type)
+        .field("mediaUrl", m.mediaUrl)
+        .key("poll");
+    if (m.type == "poll")
+    {
+        json.beginObject()
+            .field("question", m.poll.question)
+            .field("multi", m.poll.allowMultiple)
+            .key("options")
+            .beginArray();
+        for (const auto &opt : m.poll.options)
         {
-            for (const auto &orig : c.chatHistory)
-            {
-                if (orig.id == m.replyToId)
-                {
-                    string txt = (orig.type == "image") ? "[Image]" : orig.content;
-                    replyPreview = sanitize(txt.substr(0, 30));
-                    break;
-                }
-            }
+            json.beginObject()
+                .field("id", opt.id)
+                .field("text", opt.text)
+                .field("count", opt.voterIds.size())
+                .field("voted", opt.voterIds.count(userId) > 0)
+                .endObject();
         }
-
-        json += "{ \"index\": " + to_string(i) +
-                ", \"id\": " + to_string(m.id) +
-                ", \"sender\": \"" + jsonEscape(m.senderName) + "\"" +
-                ", \"senderId\": " + to_string(m.senderId) +
-                ", \"senderAvatar\": \"" + jsonEscape(avatar) + "\"" +
-                ", \"content\": \"" + jsonEscape(m.content) + "\"" +
-                ", \"type\": \"" + m.type + "\"" +
-                ", \"mediaUrl\": \"" + jsonEscape(m.mediaUrl) + "\"" +
-                ", \"poll\": " + pollJson +
-                ", \"time\": \"" + m.timestamp + "\"" +
-                ", \"votes\": " + to_string(m.upvoters.size()) +
-                ", \"has_voted\": " + (hasVoted ? "true" : "false") +
-                ", \"pinned\": " + (m.isPinned ? "true" : "false") +
-                ", \"replyTo\": " + to_string(m.replyToId) +
-                ", \"replyPreview\": \"" + jsonEscape(replyPreview) + "\" }";
-        if (i < end - 1)
-            json += ", ";
-    }
-    json += "] }";
-    return json;
-}
-
-string NovaGraph::getJoinedCommunitiesJSON(int userId)
-{
-    string json = "[";
-    int count = 0;
-
-    for (auto const &[id, c] : communityDB)
+        json.endArray().endObject();
+    }
+    else
     {
-        if (c.members.count(userId))
-        {
-            if (count > 0)
-                json += ", ";
-            json += "{ \"id\": " + to_string(c.id) +
-                    ", \"name\": \"" + jsonEscape(c.name) + "\" }";
-            count++;
-        }
+        json.null();
     }
-    json += "]";
-    return json;
+    json.field("time", m.timestamp)
+        .field("votes", m.upvoters.size())
+        .field("has_voted", m.upvoters.count(userId) > 0)
+        .field("pinned", m.isPinned)
+        .field("replyTo", m.replyToId)
+        .field("replyPreview", replyPreview)
+        .endObject();
 }
 
-string NovaGraph::getConnectionsByDegreeJSON(int startNode, int targetDegree)
+void NovaGraph::writePinnedJSON(JsonWriter &json, Community &c)
 {
-    if (userDB.find(startNode) == userDB.end())
-        return "[]";
-    queue<pair<int, int>> q;
-    q.push({startNode, 0});
-    set<int> visited;
-    visited.insert(startNode);
-    vector<int> resultIDs;
-    while (!q.empty())
+    json.key("pinned_msgs").beginArray();
+    for (int pinId : c.pinnedIds)
     {
-        auto [currentUser, depth] = q.front();
-        q.pop();
-        if (depth == targetDegree)
-        {
-            resultIDs.push_back(currentUser);
-            continue;
-        }
-        if (depth > targetDegree)
+        const Message *pin = c.chatHistory.lookup(pinId);
+        if (!pin)
             continue;
-        for (int neighbor : adjList[currentUser])
-            if (visited.find(neighbor) == visited.end())
-            {
-                visited.insert(neighbor);
-                q.push({neighbor, depth + 1});
-            }
-    }
-    string json = "[";
-    for (size_t i = 0; i < resultIDs.size(); ++i)
-    {
-        User &u = userDB[resultIDs[i]];
-        json += "{ \"id\": " + to_string(u.id) + ", \"name\": \"" + jsonEscape(u.username) + "\", \"degree\": " + to_string(targetDegree) + " }";
-        if (i < resultIDs.size() - 1)
-            json += ", ";
+        json.beginObject()
+            .field("id", pin->id)
+            .field("sender", pin->senderName)
+            .field("senderId", pin->senderId)
+            .field("content", pin->content)
+            .field("type", pin->type)
+            .endObject();
     }
-    json += "]";
-    return json;
+    json.endArray();
 }
 
-string NovaGraph::getRecommendationsJSON(int userId)
+void NovaGraph::getCommunityDetailsJSON(JsonWriter &json, int commId, int userId, int offset, int limit)
 {
-    if (adjList.find(userId) == adjList.end())
-        return "[]";
-    map<int, int> frequencyMap;
-
-    const vector<int> &myFriends = adjList[userId];
-    set<int> existingFriends(myFriends.begin(), myFriends.end());
-    existingFriends.insert(userId);
-
-    for (int friendId : myFriends)
-        for (int candidate : adjList[friendId])
-            if (existingFriends.find(candidate) == existingFriends.end())
-                frequencyMap[candidate]++;
-    vector<pair<int, int>> candidates;
-
-    for (auto const &[id, count] : frequencyMap)
-        candidates.push_back({id, count});
-    sort(candidates.begin(), candidates.end(), [](const pair<int, int> &a, const pair<int, int> &b)
-         { return a.second > b.second; });
-    string json = "[";
-
-    for (size_t i = 0; i < candidates.size(); ++i)
+    json.beginObject();
+    if (communityDB.find(commId) == communityDB.end())
     {
-        int id = candidates[i].first;
-        string name = userDB[id].username;
-        json += "{ \"id\": " + to_string(id) + ", \"name\": \"" + jsonEscape(name) + "\", \"mutual_friends\": " + to_string(candidates[i].second) + " }";
-        if (i < candidates.size() - 1)
-            json += ", ";
+        json.endObject();
+        return;
     }
-    json += "]";
-    return json;
+    Community &c = communityDB[commId];
+    vector<size_t> window = c.chatHistory.page(max(offset, 0), max(limit, 0));
+
+    json.field("id", c.id)
+        .field("name", c.name)
+        .field("desc", c.description)
+        .field("is_member", c.members.count(userId) > 0)
+        .field("is_mod", c.moderators.count(userId) > 0)
+        .field("is_admin", c.admins.count(userId) > 0)
+        .field("total_msgs", c.chatHistory.size())
+        .field("sync_token", syncToken(c.changes));
+    writePinnedJSON(json, c);
+    json.key("messages").beginArray();
+    for (size_t slot : window)
+        writeMessageJSON(json, c, c.chatHistory.view(slot), userId);
+    json.endArray().endObject();
+    c.chatHistory.trim();
 }
 
-string NovaGraph::getGraphVisualJSON()
+void NovaGraph::getCommunitySyncJSON(JsonWriter &json, int commId, int userId, const string &token, int lastId)
 {
-    string json = "{ \"nodes\": [";
-    int count = 0;
-    for (auto const &[id, u] : userDB)
+    json.beginObject();
+    auto found = communityDB.find(commId);
+    uint64_t since = 0;
+    if (found == communityDB.end() || !readSyncToken(token, found->second.changes, since))
     {
-        if (count > 0)
-            json += ", ";
-        int friendCount = adjList[id].size();
+        json.field("status", "resync").endObject();
+        return;
+    }
 
-        json += "{ \"id\": " + to_string(id) +
-                ", \"name\": \"" + jsonEscape(u.username) + "\"" +
-                ", \"avatar\": \"" + jsonEscape(u.avatarUrl) + "\"" +
-                ", \"val\": " + to_string(friendCount + 1) + " }";
-        count++;
+    Community &c = found->second;
+    if (since == c.changes.version)
+    {
+        json.field("status", "not_modified").field("token", syncToken(c.changes)).endObject();
+        return;
     }
-    json += "], \"links\": [";
-    count = 0;
-    set<string> pe;
-    for (auto const &[u, friends] : adjList)
+    vector<size_t> fresh;
+    if (!slotsAfter(c.chatHistory, lastId, SYNC_NEW_LIMIT, fresh))
     {
-        for (int v : friends)
-        {
-            int mi = min(u, v);
-            int ma = max(u, v);
-            string ek = to_string(mi) + "-" + to_string(ma);
-            if (pe.find(ek) == pe.end())
-            {
-                if (count > 0)
-                    json += ", ";
-                json += "{ \"source\": " + to_string(u) + ", \"target\": " + to_string(v) + " }";
-                pe.insert(ek);
-                count++;
-            }
-        }
+        json.field("status", "resync").endObject();
+        return;
     }
-    return json + "] }";
+
+    vector<int> deleted;
+    json.field("status", "delta")
+        .field("token", syncToken(c.changes))
+        .field("name", c.name)
+        .field("desc", c.description)
+        .field("is_member", c.members.count(userId) > 0)
+        .field("is_mod", c.moderators.count(userId) > 0)
+        .field("is_admin", c.admins.count(userId) > 0)
+        .field("total_msgs", c.chatHistory.size());
+    writePinnedJSON(json, c);
+    json.key("messages").beginArray();
+    for (int id : editedSince(c.changes, since, lastId))
+    {
+        const Message *m = c.chatHistory.lookup(id);
+        if (m)
+            writeMessageJSON(json, c, *m, userId);
+        else
+            deleted.push_back(id);
+    }
+    for (size_t slot : fresh)
+        writeMessageJSON(json, c, c.chatHistory.view(slot), userId);
+    json.endArray().key("deleted").beginArray();
+    for (int id : deleted)
+        json.value(id);
+    json.endArray().endObject();
+    c.chatHistory.trim();
 }
 
-int NovaGraph::getRelationDegree(int startNode, int targetNode)
+// Same visibility as the chat itself: members only, and not while banned.
+void NovaGraph::searchCommunityMessagesJSON(JsonWriter &json, int commId, int userId, const string &query, size_t limit)
 {
-    if (startNode == targetNode)
-        return 0;
-    if (adjList.find(startNode) == adjList.end())
-        return -1;
-    queue<pair<int, int>> q;
-    q.push({startNode, 0});
-    set<int> visited;
-    visited.insert(startNode);
-    while (!q.empty())
-    {
-        auto [currentUser, depth] = q.front();
-        q.pop();
-        if (currentUser == targetNode)
-            return depth;
-        if (depth >= 3)
-            continue;
-        for (int neighbor : adjList[currentUser])
-            if (visited.find(neighbor) == visited.end())
-            {
-                visited.insert(neighbor);
-                q.push({neighbor, depth + 1});
-            }
+    json.beginArray();
+    auto found = communityDB.find(commId);
+    if (found == communityDB.end() || !found->second.members.count(userId) || found->second.bannedUsers.count(userId))
+    {
+        json.endArray();
+        return;
     }
-    return -1;
+    Community &c = found->second;
+    for (int id : searchLog(c.textIndex, c.chatHistory, query, limit))
+    {
+        const Message *m = c.chatHistory.lookup(id);
+        if (m)
+            writeMessageJSON(json, c, *m, userId);
+    }
+    json.endArray();
+    c.chatHistory.trim();
 }
 
-string NovaGraph::searchUsersJSON(string query, string tagFilter)
+void NovaGraph::getJoinedCommunitiesJSON(JsonWriter &json, int userId)
 {
-    string json = "[";
-    int count = 0;
-    transform(query.begin(), query.end(), query.begin(), ::tolower);
-    for (auto const &[id, u] : userDB)
-    {
-        string nameLower = u.username;
-        transform(nameLower.begin(), nameLower.end(), nameLower.begin(), ::tolower);
-        bool nameMatch = query.empty() || (nameLower.find(query) != string::npos);
-        bool tagMatch = (tagFilter == "All");
-        if (!tagMatch)
-            for (const string &t : u.tags)
-                if (t == tagFilter)
-                {
-                    tagMatch = true;
-                    break;
-                }
-        if (nameMatch && tagMatch)
+    json.beginArray();
+    auto roles = communityRoles.find(userId);
+    if (roles != communityRoles.end())
+        for (int commId : roles->second.joined)
         {
-            if (count > 0)
-                json += ", ";
-            json += "{ \"id\": " + to_string(u.id) + ", \"name\": \"" + jsonEscape(u.username) + "\", \"avatar\": \"" + jsonEscape(u.avatarUrl) + "\", \"karma\": " + to_string(u.karma) + " }";
-            count++;
+            auto it = communityDB.find(commId);
+            if (it != communityDB.end())
+                json.beginObject().field("id", it->second.id).field("name", it->second.name).endObject();
         }
-    }
-    json += "]";
-    return json;
+    json.endArray();
 }
 
-string NovaGraph::getPopularCommunitiesJSON()
+void NovaGraph::getConnectionsByDegreeJSON(JsonWriter &json, int startNode, int targetDegree)
 {
-    vector<Community> comms;
-    for (auto const &[id, c] : communityDB)
-        comms.push_back(c);
-    sort(comms.begin(), comms.end(), [](const Community &a, const Community &b)
-         { return a.members.size() > b.members.size(); });
-    string json = "[";
-    for (size_t i = 0; i < comms.size() && i < 5; i++)
+    json.beginArray();
+    if (userDB.find(startNode) == userDB.end())
+    {
+        json.endArray();
+        return;
+    }
+    const FriendGraph &g = friendView();
+    int start = g.indexOf(startNode);
+    vector<int> resultIDs;
+    if (start < 0)
+    {
+        if (targetDegree == 0)
+            resultIDs.push_back(startNode);
+    }
+    else
     {
-        Community &c = comms[i];
-        if (i > 0)
-            json += ", ";
-        json += "{ \"id\": " + to_string(c.id) + ", \"name\": \"" + jsonEscape(c.name) + "\", \"members\": " + to_string(c.members.size()) + ", \"cover\": \"" + jsonEscape(c.coverUrl) + "\" }";
+        g.bfs(start, targetDegree, bfsScratch);
+        for (int v : bfsScratch.order)
+            if (bfsScratch.dist[v] == targetDegree)
+                resultIDs.push_back(g.idAt(v));
     }
-    json += "]";
-    return json;
+    for (int rid : resultIDs)
+    {
+        User &u = userDB[rid];
+        json.beginObject().field("id", u.id).field("name", u.username).field("degree", targetDegree).endObject();
+    }
+    json.endArray();
 }
 
-map<int, int> NovaGraph::getDistancesBFS(int startId)
+void NovaGraph::getRecommendationsJSON(JsonWriter &json, int userId)
 {
-    map<int, int> distances;
-    queue<pair<int, int>> q;
-
-    q.push({startId, 0});
-    distances[startId] = 0;
-
-    while (!q.empty())
+    json.beginArray();
+    const FriendGraph &g = friendView();
+    int me = g.indexOf(userId);
+    if (me < 0)
     {
-        auto [currentId, dist] = q.front();
-        q.pop();
-
-        if (dist >= 3)
-            continue;
-
-        if (adjList.count(currentId))
-        {
-            for (int neighbor : adjList[currentId])
-            {
-                if (distances.find(neighbor) == distances.end())
-                {
-                    distances[neighbor] = dist + 1;
-                    q.push({neighbor, dist + 1});
-                }
-            }
-        }
+        json.endArray();
+        return;
     }
-    return distances;
+    g.bfs(me, 2, bfsScratch);
+    g.countMutuals(me, bfsScratch);
+
+    vector<pair<int, int>> candidates;
+    for (int v : bfsScratch.counted)
+        candidates.push_back({g.idAt(v), bfsScratch.tally[v]});
+    sort(candidates.begin(), candidates.end());
+    sort(candidates.begin(), candidates.end(), [](const pair<int, int> &a, const pair<int, int> &b)
+         { return a.second > b.second; });
+    for (auto const &[id, mutual] : candidates)
+        json.beginObject().field("id", id).field("name", userDB[id].username).field("mutual_friends", mutual).endObject();
+    json.endArray();
 }
 
-string NovaGraph::getSmartUserRecommendations(int userId)
+void NovaGraph::writeGraphNodeJSON(JsonWriter &json, const User &u, int degree)
 {
-    map<int, int> distMap = getDistancesBFS(userId);
-    map<int, double> scoreMap;
+    json.beginObject()
+        .field("id", u.id)
+        .field("name", u.username)
+        .field("avatar", u.avatarUrl)
+        .field("val", degree + 1);
+}
 
-    for (auto const &[targetId, dist] : distMap)
+// Full export, paged by user id. Each link is sent with its higher endpoint,
+// so both ends of every link are already in the pages received so far.
+void NovaGraph::getGraphVisualJSON(JsonWriter &json, int afterId, size_t limit)
+{
+    const FriendGraph &g = friendView();
+    json.beginObject().key("nodes").beginArray();
+    auto first = userDB.upper_bound(afterId);
+    auto it = first;
+    for (size_t n = 0; it != userDB.end() && (!limit || n < limit); ++it, n++)
+    {
+        int index = g.indexOf(it->first);
+        writeGraphNodeJSON(json, it->second, index < 0 ? 0 : g.degree(index));
+        json.endObject();
+    }
+    json.endArray().key("links").beginArray();
+    for (auto page = first; page != it; ++page)
     {
-        if (dist == 0 || dist == 1)
+        int u = g.indexOf(page->first);
+        if (u < 0)
             continue;
+        for (const int *p = g.begin(u), *e = g.end(u); p != e && *p < u; ++p)
+            json.beginObject().field("source", g.idAt(*p)).field("target", page->first).endObject();
+    }
+    json.endArray();
+    json.field("next", it == userDB.end() ? -1 : prev(it)->first);
+    json.endObject();
+}
 
-        if (dist == 2)
+// Neighbourhood of one user up to `hops` away, nearest first, cut at
+// maxNodes. With sampleByDegree the best-connected users of each hop are
+// kept instead of the lowest ids.
+void NovaGraph::getEgoGraphJSON(JsonWriter &json, int centerId, int hops, size_t maxNodes, bool sampleByDegree)
+{
+    const FriendGraph &g = friendView();
+    vector<int> keep;
+    bool truncated = false;
+    if (userDB.count(centerId))
+    {
+        int start = g.indexOf(centerId);
+        if (start < 0)
+            keep.push_back(-1);
+        else
         {
-            scoreMap[targetId] += 10.0;
-            for (int f : adjList[userId])
+            g.bfs(start, hops, bfsScratch);
+            keep = bfsScratch.order;
+            if (maxNodes && keep.size() > maxNodes)
             {
-                const auto &targetFriends = adjList[targetId];
-                if (find(targetFriends.begin(), targetFriends.end(), f) != targetFriends.end())
-                {
-                    scoreMap[targetId] += 2.0;
-                }
+                truncated = true;
+                if (sampleByDegree)
+                    stable_sort(keep.begin() + 1, keep.end(), [&](int a, int b)
+                                {
+                                    if (bfsScratch.dist[a] != bfsScratch.dist[b])
+                                        return bfsScratch.dist[a] < bfsScratch.dist[b];
+                                    return g.degree(a) > g.degree(b); });
+                keep.resize(maxNodes);
             }
         }
-        else if (dist == 3)
-        {
-            scoreMap[targetId] += 2.0;
-        }
     }
 
-    vector<pair<int, double>> sorted(scoreMap.begin(), scoreMap.end());
-    sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b)
-         { return a.second > b.second; });
-
-    string json = "[";
-    for (size_t i = 0; i < sorted.size() && i < 10; i++)
+    json.beginObject()
+        .field("center", centerId)
+        .field("truncated", truncated)
+        .key("nodes")
+        .beginArray();
+    for (int v : keep)
     {
-        int rid = sorted[i].first;
-        if (userDB.find(rid) == userDB.end())
+        int id = v < 0 ? centerId : g.idAt(v);
+        auto user = userDB.find(id);
+        if (user == userDB.end())
             continue;
-        User &u = userDB[rid];
-        if (i > 0)
-            json += ", ";
-        json += "{ \"id\": " + to_string(u.id) +
-                ", \"name\": \"" + jsonEscape(u.username) + "\"" +
-                ", \"avatar\": \"" + jsonEscape(u.avatarUrl) + "\"" +
-                ", \"degree\": \"" + (distMap[rid] == 2 ? "2nd" : "3rd") + "\"" +
-                ", \"score\": " + to_string((int)sorted[i].second) + " }";
+        writeGraphNodeJSON(json, user->second, v < 0 ? 0 : g.degree(v));
+        json.field("hop", v < 0 ? 0 : bfsScratch.dist[v]).endObject();
     }
-    json += "]";
-    return json;
+    json.endArray().key("links").beginArray();
+    if (!keep.empty() && keep[0] >= 0)
+    {
+        sort(keep.begin(), keep.end());
+        for (int u : keep)
+            for (const int *p = lower_bound(g.begin(u), g.end(u), u + 1), *e = g.end(u); p != e; ++p)
+                if (binary_search(keep.begin(), keep.end(), *p))
+                    json.beginObject().field("source", g.idAt(u)).field("target", g.idAt(*p)).endObject();
+    }
+    json.endArray().endObject();
 }
 
-string NovaGraph::getSmartCommunityRecommendations(int userId)
+int NovaGraph::getRelationDegree(int startNode, int targetNode)
 {
-    map<int, int> distMap = getDistancesBFS(userId);
-    map<int, double> commScores;
-
-    for (auto const &[memberId, dist] : distMap)
-    {
-        if (dist == 0)
-            continue;
+    if (startNode == targetNode)
+        return 0;
+    const FriendGraph &g = friendView();
+    int start = g.indexOf(startNode), target = g.indexOf(targetNode);
+    if (start < 0 || target < 0)
+        return -1;
+    return g.distance(start, target, 3, degreeScratch);
+}
 
-        double weight = (dist == 1) ? 5.0 : (dist == 2 ? 2.0 : 0.5);
+vector<int> NovaGraph::getRelationDegrees(int startNode, const vector<int> &targetNodes)
+{
+    const FriendGraph &g = friendView();
+    vector<int> targets;
+    targets.reserve(targetNodes.size());
+    for (int id : targetNodes)
+        targets.push_back(g.indexOf(id));
+    vector<int> degrees;
+    g.distances(g.indexOf(startNode), targets, 3, degreeScratch, degrees);
+    for (size_t i = 0; i < targetNodes.size(); i++)
+        if (targetNodes[i] == startNode)
+            degrees[i] = 0;
+    return degrees;
+}
 
-        for (auto const &[commId, comm] : communityDB)
+// Queries of three or more bytes only visit users holding every trigram of
+// the query, and a tag filter adds that tag's posting list to the
+// intersection. Shorter untagged queries fall back to a walk over userDB,
+// which `limit` cuts short.
+void NovaGraph::searchUsersJSON(JsonWriter &json, string query, string tagFilter, size_t limit)
+{
+    json.beginArray();
+    query = foldCase(query);
+    vector<const vector<int> *> lists;
+    bool indexed = query.size() >= 3 || tagFilter != "All";
+    if (query.size() >= 3 && !userIndex.postings(query, lists))
+    {
+        json.endArray();
+        return;
+    }
+    if (tagFilter != "All")
+    {
+        const vector<int> *tagged = userIndex.tagged(tagFilter);
+        if (!tagged)
         {
-            if (comm.members.count(userId))
-                continue;
-
-            if (comm.members.count(memberId))
-            {
-                commScores[commId] += weight;
-            }
+            json.endArray();
+            return;
         }
+        lists.push_back(tagged);
     }
 
-    vector<pair<int, double>> sorted(commScores.begin(), commScores.end());
-    sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b)
-         { return a.second > b.second; });
+    size_t found = 0;
+    auto visit = [&](const User &u)
+    {
+        if (containsFolded(u.username, query))
+        {
+            json.beginObject()
+                .field("id", u.id)
+                .field("name", u.username)
+                .field("avatar", u.avatarUrl)
+                .field("karma", u.karma)
+                .endObject();
+            found++;
+        }
+        return !limit || found < limit;
+    };
+    auto visitId = [&](int id)
+    {
+        auto it = userDB.find(id);
+        return it == userDB.end() || visit(it->second);
+    };
+    if (indexed)
+        intersectPostings(lists, visitId);
+    else
+        for (auto const &[id, u] : userDB)
+            if (!visit(u))
+                break;
+    json.endArray();
+}
 
-    string json = "[";
-    for (size_t i = 0; i < sorted.size() && i < 6; i++)
+void NovaGraph::getPopularCommunitiesJSON(JsonWriter &json, const string &order, size_t limit)
+{
+    vector<int> ids;
+    if (order == "influence")
     {
-        Community &c = communityDB[sorted[i].first];
-        if (i > 0)
-            json += ", ";
-        json += "{ \"id\": " + to_string(c.id) +
-                ", \"name\": \"" + jsonEscape(c.name) + "\"" +
-                ", \"score\": " + to_string((int)sorted[i].second) +
-                ", \"desc\": \"" + jsonEscape(c.description.substr(0, 40)) + "...\" }";
+        for (auto const &[id, score] : analyticsView().communityInfluence)
+        {
+            if (ids.size() >= limit)
+                break;
+            if (communityDB.count(id))
+                ids.push_back(id);
+        }
+    }
+    else
+        ids = communityRanking.top(limit, order == "active");
+    json.beginArray();
+    for (int id : ids)
+    {
+        const Community &c = communityDB.at(id);
+        json.beginObject()
+            .field("id", c.id)
+            .field("name", c.name)
+            .field("members", c.members.size())
+            .field("cover", c.coverUrl)
+            .endObject();
     }
-    json += "]";
-    return json;
+    json.endArray();
+}
+
+vector<pair<int, int>> NovaGraph::getDistancesBFS(int startId)
+{
+    const FriendGraph &g = friendView();
+    int start = g.indexOf(startId);
+    if (start < 0)
+        return {{startId, 0}};
+    g.bfs(start, 3, bfsScratch);
+    vector<pair<int, int>> distances;
+    distances.reserve(bfsScratch.order.size());
+    for (int v : bfsScratch.order)
+        distances.push_back({g.idAt(v), bfsScratch.dist[v]});
+    sort(distances.begin(), distances.end());
+    return distances;
 }
 
 map<int, pair<vector<string>, vector<string>>> globalNavHistory;
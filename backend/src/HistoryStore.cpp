@@ -0,0 +1,187 @@
+#include "../include/HistoryStore.hpp"
+#include "../include/Snapshot.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+
+using namespace std;
+
+const char HISTORY_MAGIC[8] = {'N', 'O', 'V', 'A', 'H', 'I', 'S', 'T'};
+const uint32_t HISTORY_VERSION = 1;
+
+string bitmapToHex(const vector<uint8_t> &bits)
+{
+    static const char DIGITS[] = "0123456789abcdef";
+    vector<int> nibbles((bits.size() + 3) / 4, 0);
+    for (size_t i = 0; i < bits.size(); i++)
+        if (bits[i])
+            nibbles[i / 4] |= 1 << (i % 4);
+    string hex;
+    for (int n : nibbles)
+        hex += DIGITS[n];
+    return hex;
+}
+
+bool hexToBitmap(const string &hex, vector<uint8_t> &bits)
+{
+    bits.assign(hex.size() * 4, 0);
+    for (size_t i = 0; i < hex.size(); i++)
+    {
+        char c = hex[i];
+        int nibble = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+        if (nibble < 0)
+            return false;
+        for (int b = 0; b < 4; b++)
+            bits[i * 4 + b] = (nibble >> b) & 1;
+    }
+    return true;
+}
+
+string HistoryStore::segmentPath(const string &log, size_t index) const
+{
+    return dir + "/" + log + "." + to_string(index) + ".seg";
+}
+
+void HistoryStore::open(const string &directory)
+{
+    dir = directory;
+    filesystem::create_directories(dir);
+    manifest.clear();
+    listed.clear();
+    behind = false;
+
+    map<string, map<size_t, SegmentMeta>> rows;
+    ifstream in(dir + "/manifest.txt");
+    string line;
+    while (getline(in, line))
+    {
+        vector<string> parts;
+        stringstream fields(line);
+        string part;
+        while (getline(fields, part, '|'))
+            parts.push_back(part);
+        if (parts.size() < 6)
+            continue;
+        try
+        {
+            SegmentMeta meta;
+            meta.minId = stoi(parts[2]);
+            meta.maxId = stoi(parts[3]);
+            meta.sticky = parts[4] == "1";
+            if (hexToBitmap(parts[5], meta.alive))
+                rows[parts[0]][stoul(parts[1])] = move(meta);
+        }
+        catch (...)
+        {
+        }
+    }
+
+    // Segments are only usable as an unbroken prefix of the log.
+    for (auto &[log, segments] : rows)
+    {
+        vector<SegmentMeta> &list = manifest[log];
+        for (auto &[index, meta] : segments)
+        {
+            if (index != list.size())
+                break;
+            list.push_back(move(meta));
+        }
+        listed[log] = list.size();
+    }
+}
+
+vector<SegmentMeta> HistoryStore::restore(const string &log) const
+{
+    auto it = manifest.find(log);
+    return it == manifest.end() ? vector<SegmentMeta>() : it->second;
+}
+
+vector<string> HistoryStore::logs() const
+{
+    vector<string> names;
+    for (auto const &[log, segments] : manifest)
+        names.push_back(log);
+    return names;
+}
+
+bool HistoryStore::readSegment(const string &log, size_t index, string &payload) const
+{
+    string path = segmentPath(log, index);
+    ifstream in(path, ios::binary);
+    stringstream buffer;
+    buffer << in.rdbuf();
+    string data = buffer.str();
+
+    if (data.size() < SNAPSHOT_HEADER_SIZE || memcmp(data.data(), HISTORY_MAGIC, sizeof(HISTORY_MAGIC)) != 0)
+    {
+        cerr << "[C++ Error] History segment " << path << " is missing" << endl;
+        return false;
+    }
+    SnapshotReader header(data.data() + sizeof(HISTORY_MAGIC), SNAPSHOT_HEADER_SIZE - sizeof(HISTORY_MAGIC));
+    uint32_t version = header.u32();
+    header.u32();
+    uint64_t payloadSize = header.u64();
+    uint64_t checksum = header.u64();
+    const char *body = data.data() + SNAPSHOT_HEADER_SIZE;
+    if (version != HISTORY_VERSION || payloadSize != data.size() - SNAPSHOT_HEADER_SIZE || snapshotChecksum(body, payloadSize) != checksum)
+    {
+        cerr << "[C++ Error] History segment " << path << " is corrupt" << endl;
+        return false;
+    }
+    payload.assign(body, payloadSize);
+    return true;
+}
+
+void HistoryStore::writeSegment(const string &log, size_t index, const string &payload)
+{
+    SnapshotWriter header;
+    header.bytes().append(HISTORY_MAGIC, sizeof(HISTORY_MAGIC));
+    header.u32(HISTORY_VERSION);
+    header.u32(0);
+    header.u64(payload.size());
+    header.u64(snapshotChecksum(payload.data(), payload.size()));
+
+    string path = segmentPath(log, index);
+    {
+        ofstream out(path + ".tmp", ios::binary | ios::trunc);
+        out.write(header.bytes().data(), header.bytes().size());
+        out.write(payload.data(), payload.size());
+    }
+#ifdef _WIN32
+    remove(path.c_str());
+#endif
+    rename((path + ".tmp").c_str(), path.c_str());
+
+    auto it = listed.find(log);
+    if (it == listed.end() || index >= it->second)
+        behind = true;
+}
+
+// Called once every listed segment file is current. The parsed startup
+// manifest is dropped here: every log it named has been attached by now.
+void HistoryStore::commitManifest(const map<string, vector<SegmentMeta>> &logs)
+{
+    string path = dir + "/manifest.txt";
+    {
+        ofstream out(path + ".tmp", ios::trunc);
+        for (auto const &[log, segments] : logs)
+            for (size_t i = 0; i < segments.size(); i++)
+            {
+                const SegmentMeta &meta = segments[i];
+                out << log << "|" << i << "|" << meta.minId << "|" << meta.maxId << "|"
+                    << (meta.sticky ? "1" : "0") << "|" << bitmapToHex(meta.alive) << "\n";
+            }
+    }
+#ifdef _WIN32
+    remove(path.c_str());
+#endif
+    rename((path + ".tmp").c_str(), path.c_str());
+
+    manifest.clear();
+    listed.clear();
+    for (auto const &[log, segments] : logs)
+        listed[log] = segments.size();
+    behind = false;
+}
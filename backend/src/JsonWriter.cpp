@@ -0,0 +1,108 @@
+#include "../include/JsonWriter.hpp"
+#include "../include/TextScan.hpp"
+#include <cstdio>
+
+using namespace std;
+
+void appendJsonEscaped(string &out, const char *s, size_t n)
+{
+    static const char HEX[] = "0123456789abcdef";
+    size_t pos = 0;
+    while (pos < n)
+    {
+        size_t hit = pos + findJsonEscape(s + pos, n - pos);
+        out.append(s + pos, hit - pos);
+        if (hit == n)
+            break;
+        unsigned char c = s[hit];
+        out += '\\';
+        switch (c)
+        {
+        case '"':
+            out += '"';
+            break;
+        case '\\':
+            out += '\\';
+            break;
+        case '\b':
+            out += 'b';
+            break;
+        case '\f':
+            out += 'f';
+            break;
+        case '\n':
+            out += 'n';
+            break;
+        case '\r':
+            out += 'r';
+            break;
+        case '\t':
+            out += 't';
+            break;
+        default:
+            out += "u00";
+            out += HEX[c >> 4];
+            out += HEX[c & 0xF];
+        }
+        pos = hit + 1;
+    }
+}
+
+JsonWriter::~JsonWriter()
+{
+    if (sink && wroteAny)
+        buf += '\n';
+    flush();
+}
+
+JsonWriter &JsonWriter::value(const char *s, size_t n)
+{
+    separator();
+    if (sink && buf.size() + n + n / 8 + 2 > buf.capacity())
+        flush();
+    buf += '"';
+    appendJsonEscaped(buf, s, n);
+    buf += '"';
+    spill();
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(int v)
+{
+    separator();
+    char tmp[16];
+    buf.append(tmp, snprintf(tmp, sizeof(tmp), "%d", v));
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(long long v)
+{
+    separator();
+    char tmp[32];
+    buf.append(tmp, snprintf(tmp, sizeof(tmp), "%lld", v));
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(size_t v)
+{
+    separator();
+    char tmp[32];
+    buf.append(tmp, snprintf(tmp, sizeof(tmp), "%llu", (unsigned long long)v));
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(double v)
+{
+    separator();
+    char tmp[32];
+    buf.append(tmp, snprintf(tmp, sizeof(tmp), "%.6g", v));
+    return *this;
+}
+
+void JsonWriter::flush()
+{
+    if (!sink || buf.empty())
+        return;
+    sink->write(buf.data(), buf.size());
+    buf.clear();
+}
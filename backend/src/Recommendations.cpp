@@ -0,0 +1,331 @@
+#include "../include/Graph.hpp"
+#include <atomic>
+#include <thread>
+
+using namespace std;
+
+template <class T>
+bool ranksAbove(const T &a, const T &b)
+{
+    return a.score != b.score ? a.score > b.score : a.id < b.id;
+}
+
+template <class T>
+void keepTop(vector<T> &items, size_t k)
+{
+    auto better = ranksAbove<T>;
+    if (items.size() > k)
+    {
+        partial_sort(items.begin(), items.begin() + k, items.end(), better);
+        items.resize(k);
+    }
+    else
+        sort(items.begin(), items.end(), better);
+}
+
+const int SAME_CLUSTER_BONUS = 3;
+const int INFLUENCE_BONUS_MAX = 5;
+
+// Extra score from the cached analytics: a candidate in the viewer's own
+// friend cluster, or with above-average influence, ranks higher.
+int analyticsBonus(const GraphAnalytics &a, int mySlot, int slot)
+{
+    int bonus = a.cluster[mySlot] == a.cluster[slot] ? SAME_CLUSTER_BONUS : 0;
+    int influence = (int)(a.pageRank[slot] * a.ids.size());
+    return bonus + min(INFLUENCE_BONUS_MAX, max(0, influence - 1));
+}
+
+void NovaGraph::prepareRecommendations()
+{
+    const FriendGraph &g = friendView();
+    if (!recMembershipsDirty && recMembershipVersion == g.version())
+        return;
+    recCommunityIds.clear();
+    recMemberships.assign(g.size(), {});
+    recKnownUser.assign(g.size(), 0);
+    for (int i = 0; i < g.size(); i++)
+        recKnownUser[i] = userDB.count(g.idAt(i)) ? 1 : 0;
+    for (auto const &[id, c] : communityDB)
+    {
+        int pos = recCommunityIds.size();
+        recCommunityIds.push_back(id);
+        for (int m : c.members)
+        {
+            int index = g.indexOf(m);
+            if (index >= 0)
+                recMemberships[index].push_back(pos);
+        }
+    }
+    recMembershipVersion = g.version();
+    recMembershipsDirty = false;
+}
+
+// Read-only over the graph and the prepared membership table, so batch
+// workers can run it concurrently with their own scratch.
+void NovaGraph::computeRecommendations(int userId, RecommendationScratch &scratch, RecommendationEntry &entry) const
+{
+    entry.users.clear();
+    entry.communities.clear();
+    entry.usersStale = false;
+    entry.communitiesStale = false;
+    scratch.candidates.clear();
+
+    const FriendGraph &g = friendGraph;
+    int me = g.indexOf(userId);
+    if (me < 0)
+        return;
+    int slack = g.sampleCandidates(me, recFanOut, scratch.bfs);
+    // Slots match dense indices unless the graph was rebuilt after the last analytics run.
+    bool aligned = analytics.graphVersion == g.version();
+    auto slotOf = [&](int v)
+    { return aligned ? v : analytics.slotOf(g.idAt(v)); };
+    int mySlot = analytics.computed ? slotOf(me) : -1;
+    int maxBonus = mySlot >= 0 ? SAME_CLUSTER_BONUS + INFLUENCE_BONUS_MAX : 0;
+    if (scratch.communityScore.size() != recCommunityIds.size())
+        scratch.communityScore.assign(recCommunityIds.size(), 0.0);
+
+    for (int v : scratch.bfs.order)
+    {
+        int dist = scratch.bfs.dist[v];
+        if (dist == 0)
+            continue;
+        if (dist >= 2 && recKnownUser[v])
+        {
+            // A sampled walk can miss one mutual friend per friend it cut short.
+            int mutual = min(scratch.bfs.tally[v] + slack, g.degree(v));
+            scratch.candidates.push_back({(dist == 2 ? 10 + 2 * mutual : 2) + maxBonus, v});
+        }
+
+        double weight = (dist == 1) ? 5.0 : (dist == 2 ? 2.0 : 0.5);
+        for (int c : recMemberships[v])
+        {
+            if (scratch.communityScore[c] == 0.0)
+                scratch.touched.push_back(c);
+            scratch.communityScore[c] += weight;
+        }
+    }
+
+    for (int c : scratch.touched)
+    {
+        int commId = recCommunityIds[c];
+        auto it = communityDB.find(commId);
+        if (it != communityDB.end() && !it->second.members.count(userId))
+            entry.communities.push_back({commId, scratch.communityScore[c]});
+        scratch.communityScore[c] = 0.0;
+    }
+    scratch.touched.clear();
+
+    // Pop candidates best bound first and score them into a heap whose front
+    // is the weakest kept entry; once no remaining bound can beat it, stop.
+    vector<pair<int, int>> &pending = scratch.candidates;
+    make_heap(pending.begin(), pending.end());
+    auto heapOrder = ranksAbove<UserRecommendation>;
+    while (!pending.empty())
+    {
+        pop_heap(pending.begin(), pending.end());
+        auto [bound, v] = pending.back();
+        pending.pop_back();
+        if (entry.users.size() == USER_REC_LIMIT && bound < entry.users.front().score)
+            break;
+        int dist = scratch.bfs.dist[v];
+        int score = 2;
+        if (dist == 2)
+            score = 10 + 2 * (slack ? g.commonNeighbors(me, v) : scratch.bfs.tally[v]);
+        int slot = mySlot >= 0 ? slotOf(v) : -1;
+        if (slot >= 0)
+            score += analyticsBonus(analytics, mySlot, slot);
+        UserRecommendation r = {g.idAt(v), score, dist};
+        if (entry.users.size() < USER_REC_LIMIT)
+        {
+            entry.users.push_back(r);
+            push_heap(entry.users.begin(), entry.users.end(), heapOrder);
+        }
+        else if (ranksAbove(r, entry.users.front()))
+        {
+            pop_heap(entry.users.begin(), entry.users.end(), heapOrder);
+            entry.users.back() = r;
+            push_heap(entry.users.begin(), entry.users.end(), heapOrder);
+        }
+    }
+    scratch.candidates.clear();
+
+    keepTop(entry.users, USER_REC_LIMIT);
+    keepTop(entry.communities, COMMUNITY_REC_LIMIT);
+}
+
+// Computes the given users on `threads` workers (0 = all cores) and stores
+// the results in recCache.
+void NovaGraph::computeRecommendationBatch(const vector<int> &ids, int threads)
+{
+    analyticsView();
+    prepareRecommendations();
+    vector<RecommendationEntry> results(ids.size());
+
+    if (threads <= 0)
+        threads = max(1u, thread::hardware_concurrency());
+    const size_t CHUNK = max<size_t>(1, min<size_t>(64, ids.size() / (threads * 4)));
+    atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        RecommendationScratch scratch;
+        for (size_t start = next.fetch_add(CHUNK); start < ids.size(); start = next.fetch_add(CHUNK))
+            for (size_t i = start; i < ids.size() && i < start + CHUNK; i++)
+                computeRecommendations(ids[i], scratch, results[i]);
+    };
+    vector<thread> pool;
+    for (int t = 1; t < threads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for (thread &t : pool)
+        t.join();
+
+    for (size_t i = 0; i < ids.size(); i++)
+        recCache[ids[i]] = move(results[i]);
+}
+
+int NovaGraph::precomputeRecommendations(int threads)
+{
+    vector<int> ids;
+    ids.reserve(userDB.size());
+    for (auto const &[id, u] : userDB)
+        ids.push_back(id);
+    recCache.clear();
+    computeRecommendationBatch(ids, threads);
+    return ids.size();
+}
+
+// One step of the background fill: computes up to `limit` users whose cached
+// results are missing or stale, resuming after the last user the previous
+// step looked at. Returns how many it computed; 0 means every entry is fresh.
+int NovaGraph::warmRecommendations(size_t limit, int threads)
+{
+    vector<int> ids;
+    auto it = userDB.upper_bound(recWarmCursor);
+    for (size_t seen = 0; seen < userDB.size() && ids.size() < limit; seen++, ++it)
+    {
+        if (it == userDB.end())
+            it = userDB.begin();
+        auto cached = recCache.find(it->first);
+        if (cached == recCache.end() || cached->second.usersStale || cached->second.communitiesStale)
+            ids.push_back(it->first);
+        recWarmCursor = it->first;
+    }
+    if (!ids.empty())
+        computeRecommendationBatch(ids, threads);
+    return ids.size();
+}
+
+const RecommendationEntry &NovaGraph::recommendationsFor(int userId, bool communities)
+{
+    static const RecommendationEntry NONE;
+    if (userDB.find(userId) == userDB.end())
+        return NONE;
+    RecommendationEntry &entry = recCache[userId];
+    if (communities ? entry.communitiesStale : entry.usersStale)
+    {
+        analyticsView();
+        prepareRecommendations();
+        computeRecommendations(userId, recScratch, entry);
+    }
+    return entry;
+}
+
+// Marks the cached results of users within `depth` hops of userId: the
+// community half always, the user half too when `users` is set. Runs on the
+// write path, so it never builds the CSR; if that is pending, every entry is
+// marked instead.
+void NovaGraph::invalidateRecommendationsAround(int userId, int depth, bool users)
+{
+    if (recCache.empty())
+        return;
+    auto mark = [&](RecommendationEntry &entry)
+    {
+        entry.communitiesStale = true;
+        entry.usersStale = entry.usersStale || users;
+    };
+    auto self = recCache.find(userId);
+    if (self != recCache.end())
+        mark(self->second);
+    const FriendGraph &g = friendGraph;
+    if (g.isDirty())
+    {
+        for (auto &[id, entry] : recCache)
+            mark(entry);
+        return;
+    }
+    int start = g.indexOf(userId);
+    if (start < 0)
+        return;
+    g.bfs(start, depth, bfsScratch);
+    for (int v : bfsScratch.order)
+    {
+        auto it = recCache.find(g.idAt(v));
+        if (it != recCache.end())
+            mark(it->second);
+    }
+}
+
+// The walk behind a user's results only expands friends and hop-2 nodes and
+// scores nodes up to hop 3, so an edge changes them only if one end is within
+// two hops of that user. Runs before a removal and after an addition, while
+// the edge is in the graph.
+void NovaGraph::friendshipChanged(int u, int v)
+{
+    graphChanges++;
+    invalidateRecommendationsAround(u, 2, true);
+    invalidateRecommendationsAround(v, 2, true);
+}
+
+void NovaGraph::setRecommendationFanOut(const FanOut &fanOut)
+{
+    recFanOut = fanOut;
+    for (auto &[id, entry] : recCache)
+        entry.usersStale = entry.communitiesStale = true;
+}
+
+void NovaGraph::membershipChanged(int userId)
+{
+    recMembershipsDirty = true;
+    graphChanges++;
+    // Community scores add up the memberships of everyone the walk reaches.
+    invalidateRecommendationsAround(userId, 3, false);
+}
+
+void NovaGraph::getSmartUserRecommendations(JsonWriter &json, int userId)
+{
+    json.beginArray();
+    for (const UserRecommendation &r : recommendationsFor(userId, false).users)
+    {
+        auto it = userDB.find(r.id);
+        if (it == userDB.end())
+            continue;
+        const User &u = it->second;
+        json.beginObject()
+            .field("id", u.id)
+            .field("name", u.username)
+            .field("avatar", u.avatarUrl)
+            .field("degree", r.degree == 2 ? "2nd" : "3rd")
+            .field("score", r.score)
+            .endObject();
+    }
+    json.endArray();
+}
+
+void NovaGraph::getSmartCommunityRecommendations(JsonWriter &json, int userId)
+{
+    json.beginArray();
+    for (const CommunityRecommendation &r : recommendationsFor(userId, true).communities)
+    {
+        auto it = communityDB.find(r.id);
+        if (it == communityDB.end())
+            continue;
+        const Community &c = it->second;
+        json.beginObject()
+            .field("id", c.id)
+            .field("name", c.name)
+            .field("score", (int)r.score)
+            .field("desc", c.description.substr(0, 40) + "...")
+            .endObject();
+    }
+    json.endArray();
+}
@@ -0,0 +1,370 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "../include/Graph.hpp"
+#include "../include/Snapshot.hpp"
+#include <fstream>
+#include <cstdio>
+
+using namespace std;
+
+uint64_t snapshotChecksum(const char *data, size_t size)
+{
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+    return hash;
+}
+
+bool MappedFile::open(const string &path)
+{
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mapHandle = mapping;
+    bytes = (const char *)view;
+    length = (size_t)fileSize.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    void *view = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED)
+        return false;
+    madvise(view, st.st_size, MADV_SEQUENTIAL);
+    bytes = (const char *)view;
+    length = st.st_size;
+#endif
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (!bytes)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(bytes);
+    CloseHandle(mapHandle);
+    CloseHandle(fileHandle);
+    mapHandle = fileHandle = nullptr;
+#else
+    munmap((void *)bytes, length);
+#endif
+    bytes = nullptr;
+    length = 0;
+}
+
+void writeRecord(SnapshotWriter &w, const Message &m)
+{
+    w.i32(m.id);
+    w.i32(m.senderId);
+    w.str(m.senderName);
+    w.str(m.content);
+    w.str(m.timestamp);
+    w.ids(m.upvoters);
+    w.u8(m.isPinned);
+    w.i32(m.replyToId);
+    w.str(m.type);
+    w.str(m.mediaUrl);
+    w.str(m.poll.question);
+    w.u8(m.poll.allowMultiple);
+    w.u32(m.poll.options.size());
+    for (const auto &opt : m.poll.options)
+    {
+        w.i32(opt.id);
+        w.str(opt.text);
+        w.ids(opt.voterIds);
+    }
+}
+
+void readRecord(SnapshotReader &r, Message &m)
+{
+    m.id = r.i32();
+    m.senderId = r.i32();
+    m.senderName = r.str();
+    m.content = r.str();
+    m.timestamp = r.str();
+    r.ids(m.upvoters);
+    m.isPinned = r.u8();
+    m.replyToId = r.i32();
+    m.type = r.str();
+    m.mediaUrl = r.str();
+    m.poll.question = r.str();
+    m.poll.allowMultiple = r.u8();
+    uint32_t optCount = r.u32();
+    for (uint32_t i = 0; i < optCount && r.ok(); i++)
+    {
+        PollOption opt;
+        opt.id = r.i32();
+        opt.text = r.str();
+        r.ids(opt.voterIds);
+        m.poll.options.push_back(opt);
+    }
+}
+
+void writeRecord(SnapshotWriter &w, const DirectMessage &m)
+{
+    w.i32(m.id);
+    w.i32(m.senderId);
+    w.str(m.content);
+    w.str(m.timestamp);
+    w.i32(m.replyToMsgId);
+    w.str(m.reaction);
+    w.u8(m.isSeen);
+    w.str(m.type);
+    w.str(m.mediaUrl);
+}
+
+void readRecord(SnapshotReader &r, DirectMessage &m)
+{
+    m.id = r.i32();
+    m.senderId = r.i32();
+    m.content = r.str();
+    m.timestamp = r.str();
+    m.replyToMsgId = r.i32();
+    m.reaction = r.str();
+    m.isSeen = r.u8();
+    m.type = r.str();
+    m.mediaUrl = r.str();
+}
+
+void NovaGraph::saveSnapshot(const string &path)
+{
+    SnapshotWriter w;
+
+    w.u32(userDB.size());
+    for (auto const &[id, u] : userDB)
+    {
+        w.i32(u.id);
+        w.str(u.username);
+        w.str(u.email);
+        w.str(u.password);
+        w.str(u.avatarUrl);
+        w.strs(u.tags);
+        w.i32(u.karma);
+        w.ids(u.pendingRequests);
+    }
+
+    w.u32(adjList.size());
+    for (auto &[id, friends] : adjList)
+    {
+        sort(friends.begin(), friends.end());
+        friends.erase(unique(friends.begin(), friends.end()), friends.end());
+        w.i32(id);
+        w.ids(friends);
+    }
+
+    w.u32(communityDB.size());
+    for (auto const &[id, c] : communityDB)
+    {
+        w.i32(c.id);
+        w.str(c.name);
+        w.str(c.description);
+        w.str(c.coverUrl);
+        w.strs(c.tags);
+        w.ids(c.members);
+        w.ids(c.moderators);
+        w.ids(c.admins);
+        w.ids(c.bannedUsers);
+        w.i32(c.nextMsgId);
+        w.u32(c.chatHistory.tailSize());
+        for (const auto &m : c.chatHistory.tail())
+            writeRecord(w, m);
+    }
+
+    w.u32(dmDB.size());
+    for (auto const &[key, chat] : dmDB)
+    {
+        w.str(key);
+        w.i32(chat.nextMsgId);
+        w.u32(chat.messages.tailSize());
+        for (const auto &m : chat.messages.tail())
+            writeRecord(w, m);
+    }
+
+    const string &payload = w.bytes();
+    SnapshotWriter header;
+    header.bytes().append(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.u32(SNAPSHOT_VERSION);
+    header.u32(0);
+    header.u64(payload.size());
+    header.u64(snapshotChecksum(payload.data(), payload.size()));
+
+    {
+        ofstream out(path + ".tmp", ios::binary | ios::trunc);
+        out.write(header.bytes().data(), header.bytes().size());
+        out.write(payload.data(), payload.size());
+    }
+#ifdef _WIN32
+    remove(path.c_str());
+#endif
+    rename((path + ".tmp").c_str(), path.c_str());
+}
+
+bool NovaGraph::loadSnapshot(const string &path)
+{
+    MappedFile file;
+    if (!file.open(path))
+        return false;
+    if (file.size() < SNAPSHOT_HEADER_SIZE || memcmp(file.data(), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+    {
+        cerr << "[C++ Error] " << path << " is not a NovaCom snapshot" << endl;
+        return false;
+    }
+
+    SnapshotReader header(file.data() + sizeof(SNAPSHOT_MAGIC), SNAPSHOT_HEADER_SIZE - sizeof(SNAPSHOT_MAGIC));
+    uint32_t version = header.u32();
+    header.u32();
+    uint64_t payloadSize = header.u64();
+    uint64_t checksum = header.u64();
+    const char *payload = file.data() + SNAPSHOT_HEADER_SIZE;
+
+    if (version != SNAPSHOT_VERSION)
+    {
+        cerr << "[C++ Error] Unsupported snapshot version " << version << endl;
+        return false;
+    }
+    if (payloadSize != file.size() - SNAPSHOT_HEADER_SIZE || snapshotChecksum(payload, payloadSize) != checksum)
+    {
+        cerr << "[C++ Error] Snapshot checksum mismatch in " << path << endl;
+        return false;
+    }
+
+    SnapshotReader r(payload, payloadSize);
+    map<int, User> users;
+    map<int, vector<int>> adjacency;
+    map<int, Community> communities;
+    map<string, DirectChat> chats;
+
+    uint32_t userCount = r.u32();
+    for (uint32_t i = 0; i < userCount && r.ok(); i++)
+    {
+        User u;
+        u.id = r.i32();
+        u.username = r.str();
+        u.email = r.str();
+        u.password = r.str();
+        u.avatarUrl = r.str();
+        u.tags = r.strs();
+        u.karma = r.i32();
+        r.ids(u.pendingRequests);
+        users.emplace_hint(users.end(), u.id, move(u));
+    }
+
+    uint32_t adjCount = r.u32();
+    for (uint32_t i = 0; i < adjCount && r.ok(); i++)
+    {
+        int id = r.i32();
+        vector<int> friends;
+        r.ids(friends);
+        adjacency.emplace_hint(adjacency.end(), id, move(friends));
+    }
+
+    uint32_t commCount = r.u32();
+    for (uint32_t i = 0; i < commCount && r.ok(); i++)
+    {
+        Community c;
+        c.id = r.i32();
+        c.name = r.str();
+        c.description = r.str();
+        c.coverUrl = r.str();
+        c.tags = r.strs();
+        r.ids(c.members);
+        r.ids(c.moderators);
+        r.ids(c.admins);
+        r.ids(c.bannedUsers);
+        c.nextMsgId = r.i32();
+        attachHistory(c);
+        uint32_t msgCount = r.u32();
+        for (uint32_t k = 0; k < msgCount && r.ok(); k++)
+        {
+            Message m;
+            readRecord(r, m);
+            c.chatHistory.put(move(m));
+        }
+        communities.emplace_hint(communities.end(), c.id, move(c));
+    }
+
+    uint32_t dmCount = r.u32();
+    for (uint32_t i = 0; i < dmCount && r.ok(); i++)
+    {
+        DirectChat chat;
+        chat.chatKey = r.str();
+        chat.nextMsgId = r.i32();
+        attachHistory(chat);
+        uint32_t msgCount = r.u32();
+        for (uint32_t k = 0; k < msgCount && r.ok(); k++)
+        {
+            DirectMessage m;
+            readRecord(r, m);
+            chat.messages.put(move(m));
+        }
+        chats.emplace_hint(chats.end(), chat.chatKey, move(chat));
+    }
+
+    if (!r.ok())
+    {
+        cerr << "[C++ Error] Snapshot " << path << " is truncated" << endl;
+        return false;
+    }
+
+    userDB = move(users);
+    adjList = move(adjacency);
+    friendGraph.markDirty();
+    communityDB = move(communities);
+    dmDB = move(chats);
+    usernameIndex.clear();
+    userIndex.clear();
+    for (auto const &[id, u] : userDB)
+    {
+        usernameIndex[u.username] = id;
+        userIndex.add(u);
+    }
+    for (auto const &[id, c] : communityDB)
+        if (id >= nextCommunityId)
+            nextCommunityId = id + 1;
+    return true;
+}
@@ -0,0 +1,170 @@
+#include "../include/TextIndex.hpp"
+#include <algorithm>
+#include <cstdint>
+
+using namespace std;
+
+const size_t MIN_TERM = 2;
+const size_t MAX_TERM = 40;
+
+bool isIndexedTerm(const string &term)
+{
+    return term.size() >= MIN_TERM && term.size() <= MAX_TERM;
+}
+
+vector<string> splitTerms(const string &text)
+{
+    vector<string> words;
+    string word;
+    auto flush = [&]()
+    {
+        if (!word.empty())
+            words.push_back(word);
+        word.clear();
+    };
+    for (char ch : text)
+    {
+        unsigned char c = ch;
+        if (c >= 'A' && c <= 'Z')
+            word += char(c - 'A' + 'a');
+        else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80)
+            word += ch;
+        else
+            flush();
+    }
+    flush();
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    return words;
+}
+
+bool hasIndexedTerm(const string &query)
+{
+    return !tokenize(query).empty();
+}
+
+vector<string> tokenize(const string &text)
+{
+    vector<string> words = splitTerms(text);
+    words.erase(remove_if(words.begin(), words.end(), [](const string &w)
+                          { return !isIndexedTerm(w); }),
+                words.end());
+    return words;
+}
+
+void putVarint(string &out, uint32_t v)
+{
+    while (v >= 0x80)
+    {
+        out += char((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    out += char(v);
+}
+
+vector<int> decodePosting(const Posting &p)
+{
+    vector<int> ids;
+    int id = 0;
+    uint32_t v = 0;
+    int shift = 0;
+    for (char ch : p.gaps)
+    {
+        unsigned char c = ch;
+        v |= uint32_t(c & 0x7f) << shift;
+        if (c & 0x80)
+        {
+            shift += 7;
+            continue;
+        }
+        id += v;
+        ids.push_back(id);
+        v = 0;
+        shift = 0;
+    }
+    return ids;
+}
+
+void encodePosting(Posting &p, const vector<int> &ids)
+{
+    p.gaps.clear();
+    p.last = 0;
+    for (int id : ids)
+    {
+        putVarint(p.gaps, id - p.last);
+        p.last = id;
+    }
+}
+
+void TextIndex::add(int id, const string &text)
+{
+    if (!built)
+        return;
+    for (const string &term : tokenize(text))
+    {
+        Posting &p = terms[term];
+        if (id > p.last)
+        {
+            putVarint(p.gaps, id - p.last);
+            p.last = id;
+            continue;
+        }
+        // Out-of-order id (rare): splice it into the decoded list.
+        vector<int> ids = decodePosting(p);
+        auto it = lower_bound(ids.begin(), ids.end(), id);
+        if (it == ids.end() || *it != id)
+            ids.insert(it, id);
+        encodePosting(p, ids);
+    }
+}
+
+void TextIndex::remove(int id, const string &text)
+{
+    if (!built)
+        return;
+    for (const string &term : tokenize(text))
+    {
+        auto found = terms.find(term);
+        if (found == terms.end())
+            continue;
+        vector<int> ids = decodePosting(found->second);
+        auto it = lower_bound(ids.begin(), ids.end(), id);
+        if (it == ids.end() || *it != id)
+            continue;
+        ids.erase(it);
+        if (ids.empty())
+            terms.erase(found);
+        else
+            encodePosting(found->second, ids);
+    }
+}
+
+// Decodes the shortest posting list first and filters it against the others.
+vector<int> TextIndex::search(const string &query, size_t limit) const
+{
+    vector<const Posting *> lists;
+    for (const string &term : tokenize(query))
+    {
+        auto it = terms.find(term);
+        if (it == terms.end())
+            return {};
+        lists.push_back(&it->second);
+    }
+    if (lists.empty())
+        return {};
+    sort(lists.begin(), lists.end(), [](const Posting *a, const Posting *b)
+         { return a->gaps.size() < b->gaps.size(); });
+
+    vector<int> hits = decodePosting(*lists[0]);
+    for (size_t i = 1; i < lists.size() && !hits.empty(); i++)
+    {
+        vector<int> other = decodePosting(*lists[i]);
+        vector<int> both;
+        set_intersection(hits.begin(), hits.end(), other.begin(), other.end(), back_inserter(both));
+        hits.swap(both);
+    }
+    reverse(hits.begin(), hits.end());
+    if (limit && hits.size() > limit)
+        hits.resize(limit);
+    return hits;
+}
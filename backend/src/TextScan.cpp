@@ -0,0 +1,143 @@
+#include "../include/TextScan.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NOVA_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+static size_t findJsonEscapeScalar(const char *s, size_t n, size_t i)
+{
+    for (; i < n; i++)
+    {
+        unsigned char c = s[i];
+        if (c < 0x20 || c == '"' || c == '\\')
+            return i;
+    }
+    return n;
+}
+
+static void replaceSeparatorsScalar(char *s, size_t n, size_t i)
+{
+    for (; i < n; i++)
+        if (s[i] == '\n' || s[i] == '\r' || s[i] == '|')
+            s[i] = ' ';
+}
+
+static size_t findJsonEscapePlain(const char *s, size_t n)
+{
+    return findJsonEscapeScalar(s, n, 0);
+}
+
+static void replaceSeparatorsPlain(char *s, size_t n)
+{
+    replaceSeparatorsScalar(s, n, 0);
+}
+
+#ifdef NOVA_X86_SIMD
+__attribute__((target("sse2"))) static size_t findJsonEscapeSSE2(const char *s, size_t n)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i ctrl = _mm_set1_epi8(0x1F);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        // max_epu8(v, 0x1F) == 0x1F  <=>  v <= 0x1F as an unsigned byte
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                   _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl));
+        unsigned mask = _mm_movemask_epi8(hit);
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return findJsonEscapeScalar(s, n, i);
+}
+
+__attribute__((target("avx2"))) static size_t findJsonEscapeAVX2(const char *s, size_t n)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i ctrl = _mm256_set1_epi8(0x1F);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+                                      _mm256_cmpeq_epi8(_mm256_max_epu8(v, ctrl), ctrl));
+        unsigned mask = _mm256_movemask_epi8(hit);
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return findJsonEscapeScalar(s, n, i);
+}
+
+__attribute__((target("sse2"))) static void replaceSeparatorsSSE2(char *s, size_t n)
+{
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i bar = _mm_set1_epi8('|');
+    const __m128i space = _mm_set1_epi8(' ');
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)), _mm_cmpeq_epi8(v, bar));
+        if (_mm_movemask_epi8(hit))
+            _mm_storeu_si128((__m128i *)(s + i), _mm_or_si128(_mm_andnot_si128(hit, v), _mm_and_si128(hit, space)));
+    }
+    replaceSeparatorsScalar(s, n, i);
+}
+
+__attribute__((target("avx2"))) static void replaceSeparatorsAVX2(char *s, size_t n)
+{
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i bar = _mm256_set1_epi8('|');
+    const __m256i space = _mm256_set1_epi8(' ');
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, lf), _mm256_cmpeq_epi8(v, cr)), _mm256_cmpeq_epi8(v, bar));
+        if (_mm256_movemask_epi8(hit))
+            _mm256_storeu_si256((__m256i *)(s + i), _mm256_blendv_epi8(v, space, hit));
+    }
+    replaceSeparatorsScalar(s, n, i);
+}
+#endif
+
+struct TextScanKernels
+{
+    const char *name;
+    size_t (*findEscape)(const char *, size_t);
+    void (*replaceSeparators)(char *, size_t);
+};
+
+static TextScanKernels pickKernels()
+{
+#ifdef NOVA_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return {"avx2", findJsonEscapeAVX2, replaceSeparatorsAVX2};
+    if (__builtin_cpu_supports("sse2"))
+        return {"sse2", findJsonEscapeSSE2, replaceSeparatorsSSE2};
+#endif
+    return {"scalar", findJsonEscapePlain, replaceSeparatorsPlain};
+}
+
+static const TextScanKernels KERNELS = pickKernels();
+
+size_t findJsonEscape(const char *s, size_t n)
+{
+    return KERNELS.findEscape(s, n);
+}
+
+void replaceSeparators(char *s, size_t n)
+{
+    KERNELS.replaceSeparators(s, n);
+}
+
+const char *textScanKernel()
+{
+    return KERNELS.name;
+}
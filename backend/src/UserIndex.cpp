@@ -0,0 +1,126 @@
+#include "../include/UserIndex.hpp"
+#include <algorithm>
+
+using namespace std;
+
+char foldChar(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+string foldCase(string s)
+{
+    for (char &c : s)
+        c = foldChar(c);
+    return s;
+}
+
+bool containsFolded(const string &text, const string &folded)
+{
+    if (folded.size() > text.size())
+        return false;
+    size_t last = text.size() - folded.size();
+    for (size_t i = 0; i <= last; i++)
+    {
+        size_t j = 0;
+        while (j < folded.size() && foldChar(text[i + j]) == folded[j])
+            j++;
+        if (j == folded.size())
+            return true;
+    }
+    return false;
+}
+
+vector<uint32_t> trigramsOf(const string &folded)
+{
+    vector<uint32_t> keys;
+    for (size_t i = 0; i + 3 <= folded.size(); i++)
+        keys.push_back((uint32_t)(unsigned char)folded[i] << 16 |
+                       (uint32_t)(unsigned char)folded[i + 1] << 8 |
+                       (uint32_t)(unsigned char)folded[i + 2]);
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+vector<string> distinctTags(const User &u)
+{
+    vector<string> list = u.tags;
+    sort(list.begin(), list.end());
+    list.erase(unique(list.begin(), list.end()), list.end());
+    return list;
+}
+
+// New IDs are almost always the largest, so this is usually a push_back.
+void insertSorted(vector<int> &list, int id)
+{
+    if (list.empty() || list.back() < id)
+    {
+        list.push_back(id);
+        return;
+    }
+    auto it = lower_bound(list.begin(), list.end(), id);
+    if (*it != id)
+        list.insert(it, id);
+}
+
+void eraseSorted(vector<int> &list, int id)
+{
+    auto it = lower_bound(list.begin(), list.end(), id);
+    if (it != list.end() && *it == id)
+        list.erase(it);
+}
+
+void UserIndex::add(const User &u)
+{
+    for (uint32_t key : trigramsOf(foldCase(u.username)))
+        insertSorted(grams[key], u.id);
+    for (const string &tag : distinctTags(u))
+        insertSorted(tags[tag], u.id);
+}
+
+void UserIndex::remove(const User &u)
+{
+    for (uint32_t key : trigramsOf(foldCase(u.username)))
+    {
+        auto it = grams.find(key);
+        if (it == grams.end())
+            continue;
+        eraseSorted(it->second, u.id);
+        if (it->second.empty())
+            grams.erase(it);
+    }
+    for (const string &tag : distinctTags(u))
+    {
+        auto it = tags.find(tag);
+        if (it == tags.end())
+            continue;
+        eraseSorted(it->second, u.id);
+        if (it->second.empty())
+            tags.erase(it);
+    }
+}
+
+void UserIndex::clear()
+{
+    grams.clear();
+    tags.clear();
+}
+
+bool UserIndex::postings(const string &folded, vector<const vector<int> *> &lists) const
+{
+    for (uint32_t key : trigramsOf(folded))
+    {
+        auto it = grams.find(key);
+        if (it == grams.end())
+            return false;
+        lists.push_back(&it->second);
+    }
+    return true;
+}
+
+const vector<int> *UserIndex::tagged(const string &tag) const
+{
+    auto it = tags.find(tag);
+    return it == tags.end() ? nullptr : &it->second;
+}
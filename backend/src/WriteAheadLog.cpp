@@ -0,0 +1,60 @@
+#include "../include/WriteAheadLog.hpp"
+#include <sstream>
+
+using namespace std;
+
+void WriteAheadLog::open(const string &logPath)
+{
+    path = logPath;
+    if (file.is_open())
+        file.close();
+    file.open(path, ios::binary | ios::app);
+    file.seekp(0, ios::end);
+    bytes = file.tellp();
+}
+
+vector<LogRecord> WriteAheadLog::readAll()
+{
+    vector<LogRecord> records;
+    ifstream in(path, ios::binary);
+    if (!in.is_open())
+        return records;
+
+    stringstream buffer;
+    buffer << in.rdbuf();
+    string data = buffer.str();
+
+    size_t pos = 0;
+    while (pos < data.size())
+    {
+        size_t end = data.find('\n', pos);
+        // A record without its newline was torn by a crash mid-append; drop it.
+        if (end == string::npos)
+            break;
+        string line = data.substr(pos, end - pos);
+        pos = end + 1;
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        size_t bar = line.find('|');
+        if (bar == string::npos)
+            continue;
+        records.push_back({line.substr(0, bar), line.substr(bar + 1)});
+    }
+    return records;
+}
+
+void WriteAheadLog::append(const string &type, const string &row)
+{
+    string line = type + "|" + row + "\n";
+    file.write(line.data(), line.size());
+    file.flush();
+    bytes += line.size();
+}
+
+void WriteAheadLog::reset()
+{
+    if (file.is_open())
+        file.close();
+    file.open(path, ios::binary | ios::trunc);
+    bytes = 0;
+}
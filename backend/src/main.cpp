@@ -1,366 +1,181 @@
 #include "../include/Graph.hpp"
+#include "../include/Commands.hpp"
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
-#include <string>
-#include <fstream>
+#include <mutex>
 #include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
 
 using namespace std;
 
-string resolveArg(string arg)
+// Request frame on stdin:  <argc>\n  then per arg  <byteLength>\n<bytes>\n
+// Response frame on stdout: command output, then a line "#END <exitCode>"
+// Push lines on stdout:    "#EVENT <topic>" after the #END of the command
+//                           that changed the topic (community:<id>,
+//                           dm:<key>, inbox:<userId>)
+bool readFrame(istream &in, vector<string> &args)
 {
-    if (arg.rfind("FILE:", 0) == 0)
-    {
-        string path = arg.substr(5);
-        ifstream file(path, ios::binary);
-        if (file.is_open())
-        {
-            stringstream buffer;
-            buffer << file.rdbuf();
-            return buffer.str();
-        }
-        else
-        {
-            cerr << "[C++ Error] Failed to open temp file: " << path << endl;
-        }
-    }
-    return arg;
+    string line;
+    if (!getline(in, line))
+        return false;
+    if (line.empty())
+        return readFrame(in, args);
+    int count = stoi(line);
+    args.assign(1, "serve");
+    for (int i = 0; i < count; i++)
+    {
+        if (!getline(in, line))
+            return false;
+        size_t len = stoul(line);
+        string arg(len, '\0');
+        if (len > 0 && !in.read(&arg[0], len))
+            return false;
+        in.ignore(1);
+        args.push_back(arg);
+    }
+    return true;
 }
 
-int main(int argc, char *argv[])
+// Work serve mode does between requests on its own thread. Whole-graph
+// analytics are rerun whenever NovaGraph::analyticsDue says so, on a copy
+// of their input so the graph lock is only held to take it and to install
+// the result. The recommendation cache is then filled for every user and
+// refilled as changes mark entries stale, one small batch per lock hold, so
+// requests wait at most one batch and reads find it warm.
+class BackgroundJobs
 {
-    NovaGraph graph;
-    graph.loadData();
+private:
+    static const size_t WARM_BATCH = 32;
+    NovaGraph &graph;
+    mutex &graphLock;
+    condition_variable wake;
+    bool stopping = false;
+    thread worker;
 
-    if (argc < 2)
+    void run()
     {
-        cout << "{ \"error\": \"No command provided\" }" << endl;
-        return 1;
+        unique_lock<mutex> lock(graphLock);
+        while (!stopping)
+        {
+            if (graph.analyticsDue())
+            {
+                AnalyticsInput input = graph.analyticsInput();
+                lock.unlock();
+                GraphAnalytics result;
+                computeAnalytics(input.graph, input.memberships, input.communityIds, 0, result);
+                lock.lock();
+                graph.installAnalytics(result, input);
+                continue;
+            }
+            if (graph.warmRecommendations(WARM_BATCH) > 0)
+            {
+                // Let a waiting request take the lock before the next batch.
+                lock.unlock();
+                this_thread::sleep_for(chrono::milliseconds(1));
+                lock.lock();
+                continue;
+            }
+            wake.wait_for(lock, chrono::seconds(1));
+        }
     }
-    string command = argv[1];
 
-    if (command == "register")
+public:
+    BackgroundJobs(NovaGraph &g, mutex &lock) : graph(g), graphLock(lock)
     {
-        if (argc < 7)
-        {
-            cout << "{ \"error\": \"Missing args\" }" << endl;
-            return 1;
-        }
-        int newId = graph.registerUser(argv[2], argv[3], argv[4], argv[5], argv[6]);
-        if (newId == -1)
-            cout << "{ \"error\": \"Username taken\" }" << endl;
-        else
-            cout << "{ \"id\": " << newId << ", \"status\": \"success\" }" << endl;
+        graph.runAnalyticsInBackground();
+        worker = thread(&BackgroundJobs::run, this);
     }
-    else if (command == "login")
+
+    ~BackgroundJobs()
     {
-        if (argc < 4)
         {
-            cout << "{ \"error\": \"Missing args\" }" << endl;
-            return 1;
+            lock_guard<mutex> lock(graphLock);
+            stopping = true;
         }
-        int id = graph.loginUser(argv[2], argv[3]);
-        if (id == -1)
-            cout << "{ \"error\": \"Invalid credentials\" }" << endl;
-        else
-            cout << "{ \"id\": " << id << ", \"status\": \"success\" }" << endl;
-    }
-    else if (command == "get_user")
-    {
-        if (argc < 3)
-            return 1;
-        cout << graph.getUserJSON(stoi(argv[2])) << endl;
-    }
-    else if (command == "update_profile")
-    {
-        if (argc < 6)
-            return 1;
-        graph.updateUserProfile(stoi(argv[2]), argv[3], argv[4], argv[5]);
-        cout << "{ \"status\": \"updated\" }" << endl;
-    }
-    else if (command == "delete_user")
-    {
-        if (argc < 3)
-            return 1;
-        graph.deleteUser(stoi(argv[2]));
-        cout << "{ \"status\": \"deleted\" }" << endl;
-    }
-    else if (command == "send_request")
-    {
-        if (argc < 4)
-            return 1;
-        string status = graph.sendConnectionRequest(stoi(argv[2]), stoi(argv[3]));
-        cout << "{ \"status\": \"" << status << "\" }" << endl;
-    }
-    else if (command == "accept_request")
-    {
-        if (argc < 4)
-            return 1;
-        graph.acceptConnectionRequest(stoi(argv[2]), stoi(argv[3]));
-        cout << "{ \"status\": \"accepted\" }" << endl;
-    }
-    else if (command == "decline_request")
-    {
-        if (argc < 4)
-            return 1;
-        graph.declineConnectionRequest(stoi(argv[2]), stoi(argv[3]));
-        cout << "{ \"status\": \"declined\" }" << endl;
-    }
-    else if (command == "get_pending_requests")
-    {
-        if (argc < 3)
-            return 1;
-        cout << graph.getPendingRequestsJSON(stoi(argv[2])) << endl;
+        wake.notify_all();
+        worker.join();
     }
-    else if (command == "get_relationship")
-    {
-        if (argc < 4)
-            return 1;
-        cout << "{ \"status\": \"" << graph.getRelationshipStatus(stoi(argv[2]), stoi(argv[3])) << "\" }" << endl;
-    }
-    else if (command == "get_friends")
-    {
-        if (argc < 3)
-            return 1;
-        cout << graph.getFriendListJSON(stoi(argv[2])) << endl;
-    }
-    else if (command == "create_community")
-    {
-        if (argc < 7)
-            return 1;
-        graph.createCommunity(argv[2], argv[3], argv[4], stoi(argv[5]), argv[6]);
-        graph.saveData();
-        cout << "{ \"status\": \"success\" }" << endl;
-    }
-    else if (command == "get_all_communities")
-    {
-        cout << graph.getAllCommunitiesJSON() << endl;
-    }
-    else if (command == "join_community")
-    {
-        if (argc < 4)
-            return 1;
-        graph.joinCommunity(stoi(argv[2]), stoi(argv[3]));
-        graph.saveData();
-        cout << "{ \"status\": \"joined\" }" << endl;
-    }
-    else if (command == "leave_community")
-    {
-        if (argc < 4)
-            return 1;
-        graph.leaveCommunity(stoi(argv[2]), stoi(argv[3]));
-        graph.saveData();
-        cout << "{ \"status\": \"left\" }" << endl;
-    }
-    else if (command == "get_community")
-    {
-        int offset = (argc > 4) ? stoi(argv[4]) : 0;
-        int limit = (argc > 5) ? stoi(argv[5]) : 50;
-        cout << graph.getCommunityDetailsJSON(stoi(argv[2]), stoi(argv[3]), offset, limit) << endl;
-    }
-    else if (command == "get_community_members")
-    {
-        if (argc < 3)
-            return 1;
-        cout << graph.getCommunityMembersJSON(stoi(argv[2])) << endl;
-    }
-    else if (command == "send_message")
-    {
-        if (argc < 8)
-            return 1;
-
-        int replyId = stoi(argv[4]);
-        string type = argv[5];
-        string mediaUrl = resolveArg(argv[6]);
-        string content = argv[7];
+};
 
-        for (int i = 8; i < argc; ++i)
-            content += " " + string(argv[i]);
+int serve(NovaGraph &graph)
+{
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    ios::sync_with_stdio(false);
+    cout << "#READY" << endl;
+    mutex graphLock;
+    BackgroundJobs jobs(graph, graphLock);
 
-        graph.addMessage(stoi(argv[2]), stoi(argv[3]), content, type, mediaUrl, replyId);
-        cout << "{ \"status\": \"sent\" }" << endl;
-    }
-    else if (command == "search_users")
-    {
-        string q = (argc > 2) ? argv[2] : "";
-        string t = (argc > 3) ? argv[3] : "All";
-        cout << graph.searchUsersJSON(q, t) << endl;
-    }
-    else if (command == "remove_friend")
-    {
-        if (argc < 4)
-            return 1;
-        graph.removeFriendship(stoi(argv[2]), stoi(argv[3]));
-        cout << "{ \"status\": \"removed\" }" << endl;
-    }
-    else if (command == "get_popular")
-    {
-        cout << graph.getPopularCommunitiesJSON() << endl;
-    }
-    else if (command == "get_visual_graph")
-    {
-        cout << graph.getGraphVisualJSON() << endl;
-    }
-    else if (command == "vote_message")
-    {
-        if (argc < 5)
-            return 1;
-        graph.upvoteMessage(stoi(argv[2]), stoi(argv[3]), stoi(argv[4]));
-        cout << "{ \"status\": \"voted\" }" << endl;
-    }
-    else if (command == "mod_ban")
+    vector<string> args;
+    while (true)
     {
-        if (argc < 5)
-            return 1;
-        graph.banUser(stoi(argv[2]), stoi(argv[3]), stoi(argv[4]));
-        cout << "{ \"status\": \"banned\" }" << endl;
-    }
-    else if (command == "mod_unban")
-    {
-        if (argc < 5)
-            return 1;
-        graph.unbanUser(stoi(argv[2]), stoi(argv[3]), stoi(argv[4]));
-        cout << "{ \"status\": \"unbanned\" }" << endl;
-    }
-    else if (command == "mod_delete")
-    {
-        if (argc < 5)
-            return 1;
-        graph.deleteMessage(stoi(argv[2]), stoi(argv[3]), stoi(argv[4]));
-        cout << "{ \"status\": \"deleted\" }" << endl;
-    }
-    else if (command == "mod_pin")
-    {
-        if (argc < 5)
-            return 1;
-        graph.pinMessage(stoi(argv[2]), stoi(argv[3]), stoi(argv[4]));
-        cout << "{ \"status\": \"pinned\" }" << endl;
-    }
-    else if (command == "mod_promote_admin")
-    {
-        if (argc < 5)
-            return 1;
-        graph.promoteToAdmin(stoi(argv[2]), stoi(argv[3]), stoi(argv[4]));
-        cout << "{ \"status\": \"promoted\" }" << endl;
-    }
-    else if (command == "mod_demote_admin")
-    {
-        if (argc < 5)
-            return 1;
-        graph.demoteAdmin(stoi(argv[2]), stoi(argv[3]), stoi(argv[4]));
-        cout << "{ \"status\": \"demoted\" }" << endl;
-    }
-    else if (command == "mod_transfer")
-    {
-        if (argc < 5)
-            return 1;
-        graph.transferOwnership(stoi(argv[2]), stoi(argv[3]), stoi(argv[4]));
-        cout << "{ \"status\": \"transferred\" }" << endl;
-    }
-    else if (command == "send_dm")
-    {
-        if (argc < 8)
+        int code;
+        try
+        {
+            if (!readFrame(cin, args))
+                break;
+        }
+        catch (...)
+        {
+            // The rest of the frame can't be told apart from the next one,
+            // so answer this request and exit; the bridge starts a fresh process.
+            cout << "{ \"error\": \"Malformed request\" }\n#END 1" << endl;
             return 1;
+        }
 
-        int replyId = stoi(argv[4]);
-        string type = argv[5];
-
-        string mediaUrl = resolveArg(argv[6]);
-
-        string content = argv[7];
-        for (int i = 8; i < argc; ++i)
-            content += " " + string(argv[i]);
-
-        graph.sendDirectMessage(stoi(argv[2]), stoi(argv[3]), content, replyId, type, mediaUrl);
-        cout << "{ \"status\": \"sent\" }" << endl;
-    }
-    else if (command == "get_dm")
-    {
-        if (argc < 4)
-            return 1;
-        int offset = (argc > 4) ? stoi(argv[4]) : 0;
-        int limit = (argc > 5) ? stoi(argv[5]) : 50;
-        cout << graph.getDirectChatJSON(stoi(argv[2]), stoi(argv[3]), offset, limit) << endl;
-    }
-    else if (command == "delete_dm")
-    {
-        if (argc < 5)
-            return 1;
-        graph.deleteDirectMessage(stoi(argv[2]), stoi(argv[3]), stoi(argv[4]));
-        cout << "{ \"status\": \"deleted\" }" << endl;
-    }
-    else if (command == "react_dm")
-    {
-        if (argc < 6)
-            return 1;
-        graph.reactToDirectMessage(stoi(argv[2]), stoi(argv[3]), stoi(argv[4]), argv[5]);
-        cout << "{ \"status\": \"reacted\" }" << endl;
-    }
-    else if (command == "get_my_dms")
-    {
-        if (argc < 3)
-            return 1;
-        cout << graph.getActiveDMsJSON(stoi(argv[2])) << endl;
-    }
-    else if (command == "create_poll")
-    {
-        if (argc < 6)
-            return 1;
-        string question = argv[4];
-        bool multi = (string(argv[5]) == "1");
-        vector<string> options;
-        for (int i = 6; i < argc; i++)
-            options.push_back(argv[i]);
-        graph.createPoll(stoi(argv[2]), stoi(argv[3]), question, multi, options);
-        cout << "{ \"status\": \"poll_created\" }" << endl;
-    }
-    else if (command == "vote_poll")
-    {
-        if (argc < 6)
-            return 1;
-        graph.togglePollVote(stoi(argv[2]), stoi(argv[3]), stoi(argv[4]), stoi(argv[5]));
-        cout << "{ \"status\": \"voted\" }" << endl;
-    }
-    else if (command == "get_my_communities")
-    {
-        if (argc < 3)
-            return 1;
-        cout << graph.getJoinedCommunitiesJSON(stoi(argv[2])) << endl;
-    }
-    else if (command == "get_user_recs")
-    {
-        if (argc < 3)
-            return 1;
-        cout << graph.getSmartUserRecommendations(stoi(argv[2])) << endl;
-    }
-    else if (command == "get_recommendations")
-    {
-        if (argc < 3)
-            return 1;
-        cout << graph.getSmartUserRecommendations(stoi(argv[2])) << endl;
-    }
-    else if (command == "get_comm_recs")
-    {
-        if (argc < 3)
-            return 1;
-        cout << graph.getSmartCommunityRecommendations(stoi(argv[2])) << endl;
-    }
-    else if (command == "nav_push")
-    {
-        graph.navPush(stoi(argv[2]), argv[3]);
-        cout << "{ \"status\": \"pushed\" }" << endl;
-    }
-    else if (command == "nav_back")
-    {
-        cout << "{ \"tab\": \"" << graph.navBack(stoi(argv[2])) << "\" }" << endl;
+        lock_guard<mutex> lock(graphLock);
+        // Buffered so a command that throws midway never leaves half a
+        // JSON document in front of the error.
+        ostringstream response;
+        try
+        {
+            code = runCommand(graph, args, response);
+            cout << response.str();
+        }
+        catch (const exception &e)
+        {
+            cout << "{ \"error\": \"Bad arguments\" }" << endl;
+            cerr << "[C++ Error] " << (args.size() > 1 ? args[1] : "") << ": " << e.what() << endl;
+            code = 1;
+        }
+        catch (...)
+        {
+            cout << "{ \"error\": \"Bad arguments\" }" << endl;
+            code = 1;
+        }
+        cout << "#END " << code << "\n";
+        for (const string &topic : graph.takeEvents())
+            cout << "#EVENT " << topic << "\n";
+        cout.flush();
     }
-    else if (command == "nav_forward")
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    NovaGraph graph;
+    try
     {
-        cout << "{ \"tab\": \"" << graph.navForward(stoi(argv[2])) << "\" }" << endl;
+        graph.loadData();
     }
-    else
+    catch (const exception &e)
     {
-        cout << "{ \"error\": \"Unknown command\" }" << endl;
+        cerr << "[C++ Error] " << e.what() << endl;
+        return 1;
     }
 
-    return 0;
-}
\ No newline at end of file
+    if (argc >= 2 && string(argv[1]) == "serve")
+        return serve(graph);
+
+    vector<string> args(argv, argv + argc);
+    return runCommand(graph, args, cout);
+}
@@ -97,7 +97,7 @@ function App() {
 
         {activeTab === 'explore_users' && <div className="animate-fade-in"><FriendsPage currentUserId={currentUserId} onNavigate={handleNavigate} /></div>}
 
-        {activeTab === 'map' && <div className="h-full animate-fade-in"><NetworkMap /></div>}
+        {activeTab === 'map' && <div className="h-full animate-fade-in"><NetworkMap currentUserId={currentUserId} /></div>}
 
         {/* UPDATED: Pass onLogout to ProfileView */}
         {activeTab.startsWith('profile_') && (
@@ -1,6 +1,26 @@
 import axios from 'axios';
 
 const BRIDGE_URL = "http://localhost:4000/api";
+const BLOB_PREFIX = "blobref:";
+
+// Media is stored once on the backend and referenced as "blobref:<key>".
+export const mediaSrc = (url) => (url && url.startsWith(BLOB_PREFIX) ? `${BRIDGE_URL}/blob/${url.slice(BLOB_PREFIX.length)}` : url);
+
+// Same key the backend uses for a DM conversation.
+export const dmTopic = (a, b) => {
+    const [low, high] = [parseInt(a), parseInt(b)].sort((x, y) => x - y);
+    return `dm:${low}_${high}`;
+};
+
+// Calls onChange(topic) whenever the backend reports a change to one of the
+// topics, and onChange(null) on every (re)connect since events may have been
+// missed while disconnected. Returns the unsubscribe function.
+export const subscribe = (topics, onChange) => {
+    const source = new EventSource(`${BRIDGE_URL}/events?topics=${encodeURIComponent(topics.join(','))}`);
+    source.onopen = () => onChange(null);
+    source.onmessage = (e) => onChange(e.data);
+    return () => source.close();
+};
 
 export const callBackend = async (action, params = []) => {
     try {
@@ -13,4 +33,20 @@ export const callBackend = async (action, params = []) => {
         console.error("API Error:", error);
         return null;
     }
-};
\ No newline at end of file
+};
+
+// Applies a sync_community / sync_dm delta to a loaded message list: drops
+// deleted ids, replaces edited messages in place and appends new ones.
+export const mergeDelta = (messages, delta) => {
+    const deleted = new Set(delta.deleted);
+    const merged = messages
+        .filter(m => !deleted.has(m.id))
+        .map(m => (deleted.has(m.replyTo) ? { ...m, replyPreview: "" } : m));
+    const index = new Map(merged.map((m, i) => [m.id, i]));
+    let lastId = merged.length > 0 ? merged[merged.length - 1].id : 0;
+    for (const m of delta.messages) {
+        if (index.has(m.id)) merged[index.get(m.id)] = m;
+        else if (m.id > lastId) { merged.push(m); lastId = m.id; }
+    }
+    return merged;
+};
@@ -1,5 +1,5 @@
 import React, { useEffect, useState } from 'react';
-import { callBackend } from '../api';
+import { callBackend, mediaSrc } from '../api';
 import GlassCard from './GlassCard';
 
 const CommunityAbout = ({ commId, currentUserId, onNavigate, onViewUserProfile }) => {
@@ -44,7 +44,7 @@ const CommunityAbout = ({ commId, currentUserId, onNavigate, onViewUserProfile }
       <div className="relative h-48 w-full shrink-0">
          <div className="absolute inset-0 bg-gradient-to-r from-void-black to-nebula-blue"></div>
          {details.cover && details.cover !== "NULL" && details.cover !== "none" && (
-             <img src={details.cover} className="absolute inset-0 w-full h-full object-cover opacity-50" alt="cover"/>
+             <img src={mediaSrc(details.cover)} className="absolute inset-0 w-full h-full object-cover opacity-50" alt="cover"/>
          )}
          <div className="absolute inset-0 bg-black/40"></div>
          
@@ -86,7 +86,7 @@ const CommunityAbout = ({ commId, currentUserId, onNavigate, onViewUserProfile }
                         {/* Profile Click Area - USES NEW PROP */}
                         <div className="flex items-center gap-4 cursor-pointer" onClick={() => onViewUserProfile(m.id)}>
                             <div className="w-12 h-12 rounded-full border border-white/20 overflow-hidden bg-black flex-shrink-0">
-                                {m.avatar && m.avatar !== "NULL" && m.avatar !== "none" ? <img src={m.avatar} className="w-full h-full object-cover" alt="p"/> : <div className="w-full h-full flex items-center justify-center text-gray-500">{m.name[0]}</div>}
+                                {m.avatar && m.avatar !== "NULL" && m.avatar !== "none" ? <img src={mediaSrc(m.avatar)} className="w-full h-full object-cover" alt="p"/> : <div className="w-full h-full flex items-center justify-center text-gray-500">{m.name[0]}</div>}
                             </div>
                             <div className="flex-1">
                                 <div className="flex items-center gap-2">
@@ -1,7 +1,8 @@
 import React, { useState, useEffect, useRef, useLayoutEffect } from 'react';
-import { callBackend } from '../api';
+import { callBackend, mediaSrc, mergeDelta, subscribe } from '../api';
 import PollMessage from './PollMessage';
 import CreatePollModal from './CreatePollModal';
+import MessageSearch from './MessageSearch';
 
 const CommunityChat = ({ commId, currentUserId, onLeave, onAbout }) => {
   const [details, setDetails] = useState(null);
@@ -31,24 +32,43 @@ const CommunityChat = ({ commId, currentUserId, onLeave, onAbout }) => {
   const isAtBottom = useRef(true);
   const loadingHistory = useRef(false);
   const fileInputRef = useRef(null);
+  const syncToken = useRef(null);
+  const lastId = useRef(0);
 
-  // 1. Fetch Latest
+  // 1. Fetch Latest (only what changed since the last sync token)
   const fetchLatest = async () => {
     if (loadingHistory.current) return;
 
+    if (syncToken.current) {
+        const delta = await callBackend('sync_community', [commId, currentUserId, syncToken.current, lastId.current]);
+        if (delta && delta.status === 'not_modified') return;
+        if (delta && delta.status === 'delta') {
+            syncToken.current = delta.token;
+            if (delta.messages.length > 0) lastId.current = Math.max(lastId.current, delta.messages[delta.messages.length - 1].id);
+            const { status, token, messages: changed, deleted, ...fields } = delta;
+            setDetails(prev => ({ ...prev, ...fields }));
+            setTotalMsgs(delta.total_msgs);
+            setPinnedMessages(delta.pinned_msgs);
+            setMessages(prev => mergeDelta(prev, delta));
+            return;
+        }
+    }
+
     const data = await callBackend('get_community', [commId, currentUserId, 0, MSG_LIMIT]);
     if (data && data.id) {
         setDetails(data);
         setTotalMsgs(data.total_msgs);
-        setPinnedMessages(data.messages.filter(m => m.pinned)); 
+        setPinnedMessages(data.pinned_msgs || []);
         if (offset === 0) setMessages(data.messages);
+        syncToken.current = data.sync_token || null;
+        lastId.current = data.messages.length > 0 ? data.messages[data.messages.length - 1].id : 0;
     }
   };
 
   useEffect(() => {
+    syncToken.current = null; lastId.current = 0;
     setOffset(0); isAtBottom.current = true; fetchLatest();
-    const interval = setInterval(() => { if (offset === 0) fetchLatest(); }, 2000);
-    return () => clearInterval(interval);
+    return subscribe([`community:${commId}`], () => fetchLatest());
   }, [commId]);
 
   useLayoutEffect(() => {
@@ -78,10 +98,10 @@ const CommunityChat = ({ commId, currentUserId, onLeave, onAbout }) => {
   // --- ACTIONS ---
 
   const sendMessage = async (content, type = "text", mediaUrl = "NONE") => {
-    const replyId = replyTarget ? replyTarget.index : -1;
+    const replyId = replyTarget ? replyTarget.id : -1;
     // send_message <comm> <sender> <replyTo> <type> <mediaUrl> <content>
     await callBackend('send_message', [commId, currentUserId, replyId, type, mediaUrl, content]);
-    setMsgInput(""); setReplyTarget(null); setOffset(0); isAtBottom.current = true; fetchLatest();
+    setMsgInput(""); setReplyTarget(null); setOffset(0); isAtBottom.current = true; syncToken.current = null; fetchLatest();
   };
 
   const handleSendText = async (e) => {
@@ -143,9 +163,9 @@ const CommunityChat = ({ commId, currentUserId, onLeave, onAbout }) => {
   const handleLeaveCommunity = async () => {
     if (window.confirm(`Leave ${details.name}?`)) { await callBackend('leave_community', [currentUserId, commId]); onLeave(); }
   };
-  const handleVote = async (index) => { await callBackend('vote_message', [commId, currentUserId, index]); fetchLatest(); };
-  const handlePin = async (index) => { await callBackend('mod_pin', [commId, currentUserId, index]); fetchLatest(); };
-  const handleDelete = async (index) => { if(window.confirm("Delete?")) { await callBackend('mod_delete', [commId, currentUserId, index]); fetchLatest(); }};
+  const handleVote = async (msgId) => { await callBackend('vote_message', [commId, currentUserId, msgId]); fetchLatest(); };
+  const handlePin = async (msgId) => { await callBackend('mod_pin', [commId, currentUserId, msgId]); fetchLatest(); };
+  const handleDelete = async (msgId) => { if(window.confirm("Delete?")) { await callBackend('mod_delete', [commId, currentUserId, msgId]); fetchLatest(); }};
   const handleBan = async (targetId) => { if(window.confirm(`Ban User ${targetId}?`)) { await callBackend('mod_ban', [commId, currentUserId, targetId]); fetchLatest(); }};
   const handleUnban = async () => { const t = prompt("User ID to Unban:"); if (t) { await callBackend('mod_unban', [commId, currentUserId, t]); alert("Done."); }};
 
@@ -164,6 +184,7 @@ const CommunityChat = ({ commId, currentUserId, onLeave, onAbout }) => {
           <p className="text-xs text-gray-400">{details.desc}</p>
         </div>
         <div className="flex items-center gap-3">
+            {details.is_member && <MessageSearch action="search_messages" params={[commId, currentUserId]} nameOf={(m) => m.sender} />}
             <button onClick={onAbout} className="bg-white/10 hover:bg-white/20 text-white text-xs px-3 py-1 rounded border border-white/10">About</button>
             {details.is_mod && <button onClick={handleUnban} className="bg-gray-700 hover:bg-gray-600 text-xs text-white px-3 py-1 rounded border border-white/10">Bans</button>}
             {details.is_member && <button onClick={handleLeaveCommunity} className="bg-red-500/10 hover:bg-red-500/30 text-red-400 hover:text-red-200 text-xs px-3 py-1 rounded border border-red-500/30 transition">Leave</button>}
@@ -179,7 +200,7 @@ const CommunityChat = ({ commId, currentUserId, onLeave, onAbout }) => {
                 {pinnedMessages.map((m, i) => (
                     <div key={i} className="text-sm text-white truncate flex justify-between items-center bg-white/5 p-1 rounded">
                          <span className="truncate w-11/12"><span className="font-bold text-gray-400 mr-2">{m.sender}:</span> {m.content}</span>
-                         {details.is_mod && <button onClick={() => handlePin(m.index)} className="text-[10px] text-red-400 hover:text-white ml-2">Unpin</button>}
+                         {details.is_mod && <button onClick={() => handlePin(m.id)} className="text-[10px] text-red-400 hover:text-white ml-2">Unpin</button>}
                     </div>
                 ))}
              </div>
@@ -201,7 +222,7 @@ const CommunityChat = ({ commId, currentUserId, onLeave, onAbout }) => {
                     {/* AVATAR */}
                     <div className="w-8 h-8 rounded-full bg-black border border-white/10 overflow-hidden flex-shrink-0">
                         {m.senderAvatar && m.senderAvatar !== "NULL" ? (
-                            <img src={m.senderAvatar} className="w-full h-full object-cover" alt="p" />
+                            <img src={mediaSrc(m.senderAvatar)} className="w-full h-full object-cover" alt="p" />
                         ) : (
                             <div className="w-full h-full flex items-center justify-center text-[10px] text-gray-500 font-bold">{m.sender[0]}</div>
                         )}
@@ -228,7 +249,7 @@ const CommunityChat = ({ commId, currentUserId, onLeave, onAbout }) => {
                         ) : m.type === "image" ? (
                             <div className={`p-1 shadow-lg backdrop-blur-sm rounded-xl overflow-hidden cursor-pointer ${isMe ? "bg-cyan-supernova/10 border border-cyan-supernova/30" : "bg-white/5 border border-white/10"}`}>
                                 <img 
-                                    src={m.mediaUrl} 
+                                    src={mediaSrc(m.mediaUrl)} 
                                     alt="shared" 
                                     className="max-w-[250px] max-h-[300px] rounded-lg object-cover hover:opacity-90 transition"
                                     onClick={() => setExpandedImage(m.mediaUrl)}
@@ -238,7 +259,7 @@ const CommunityChat = ({ commId, currentUserId, onLeave, onAbout }) => {
                             <div className={`p-2 shadow-lg backdrop-blur-sm rounded-xl min-w-[260px] flex items-center justify-center ${isMe ? "bg-cyan-supernova/10 border border-cyan-supernova/30" : "bg-white/5 border border-white/10"}`}>
                                 <audio 
                                     controls 
-                                    src={m.mediaUrl} 
+                                    src={mediaSrc(m.mediaUrl)} 
                                     className="w-full h-10 rounded-md focus:outline-none" 
                                     style={{ filter: isMe ? "invert(1) hue-rotate(180deg)" : "invert(0.9)" }} 
                                 />
@@ -260,14 +281,14 @@ const CommunityChat = ({ commId, currentUserId, onLeave, onAbout }) => {
 
                     {/* HOVER TOOLS */}
                     <div className={`flex items-center gap-1 opacity-0 group-hover:opacity-100 transition-opacity mb-2 bg-black/40 backdrop-blur rounded-lg p-1 border border-white/5 ${isMe ? "flex-row-reverse" : "flex-row"}`}>
-                         <button onClick={() => setReplyTarget({ index: m.id, content: m.type==='image'?'[Image]':m.type==='audio'?'[Audio]':m.content })} className="p-1.5 text-gray-500 hover:text-cyan-supernova hover:bg-white/10 rounded" title="Reply">
+                         <button onClick={() => setReplyTarget({ id: m.id, content: m.type==='image'?'[Image]':m.type==='audio'?'[Audio]':m.content })} className="p-1.5 text-gray-500 hover:text-cyan-supernova hover:bg-white/10 rounded" title="Reply">
                             <svg xmlns="http://www.w3.org/2000/svg" width="14" height="14" viewBox="0 0 24 24" fill="none" stroke="currentColor" strokeWidth="2" strokeLinecap="round" strokeLinejoin="round"><path d="M9 14L4 9l5-5"/><path d="M4 9h10.5a5.5 5.5 0 0 1 5.5 5.5v0a5.5 5.5 0 0 1-5.5 5.5H11"/></svg>
                          </button>
-                         <button onClick={() => handleVote(m.index)} className={`p-1.5 rounded text-xs ${m.has_voted ? "text-cyan-supernova font-bold" : "text-gray-400 hover:text-white hover:bg-white/10"}`}>▲</button>
+                         <button onClick={() => handleVote(m.id)} className={`p-1.5 rounded text-xs ${m.has_voted ? "text-cyan-supernova font-bold" : "text-gray-400 hover:text-white hover:bg-white/10"}`}>▲</button>
                          {(details.is_mod || isMe) && (
                             <>
-                                {details.is_mod && <button onClick={() => handlePin(m.index)} className={`p-1.5 text-xs rounded hover:bg-white/10 ${m.pinned ? "text-yellow-400" : "text-gray-400 hover:text-yellow-400"}`}>📌</button>}
-                                <button onClick={() => handleDelete(m.index)} className="p-1.5 text-xs text-gray-400 hover:text-red-500 hover:bg-white/10 rounded">🗑️</button>
+                                {details.is_mod && <button onClick={() => handlePin(m.id)} className={`p-1.5 text-xs rounded hover:bg-white/10 ${m.pinned ? "text-yellow-400" : "text-gray-400 hover:text-yellow-400"}`}>📌</button>}
+                                <button onClick={() => handleDelete(m.id)} className="p-1.5 text-xs text-gray-400 hover:text-red-500 hover:bg-white/10 rounded">🗑️</button>
                                 {details.is_mod && !isMe && <button onClick={() => handleBan(m.senderId)} className="px-1.5 py-0.5 text-[9px] text-red-500 font-bold border border-red-500/30 rounded hover:bg-red-500/10 ml-1">BAN</button>}
                             </>
                          )}
@@ -340,7 +361,7 @@ const CommunityChat = ({ commId, currentUserId, onLeave, onAbout }) => {
       {expandedImage && (
           <div className="fixed inset-0 z-50 flex items-center justify-center bg-black/95 backdrop-blur-md p-4 animate-fade-in" onClick={() => setExpandedImage(null)}>
               <button onClick={() => setExpandedImage(null)} className="absolute top-6 right-6 text-white hover:text-red-500 bg-white/10 hover:bg-white/20 p-2 rounded-full transition">✕</button>
-              <img src={expandedImage} className="max-w-full max-h-[90vh] rounded-lg shadow-2xl object-contain cursor-default" onClick={(e) => e.stopPropagation()} alt="Enlarged"/>
+              <img src={mediaSrc(expandedImage)} className="max-w-full max-h-[90vh] rounded-lg shadow-2xl object-contain cursor-default" onClick={(e) => e.stopPropagation()} alt="Enlarged"/>
           </div>
       )}
 
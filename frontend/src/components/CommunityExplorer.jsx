@@ -1,5 +1,5 @@
 import React, { useState, useEffect } from 'react';
-import { callBackend } from '../api';
+import { callBackend, mediaSrc } from '../api';
 import GlassCard from './GlassCard';
 import TagSelector from './TagSelector';
 
@@ -122,7 +122,7 @@ const CommunityExplorer = ({ currentUserId, onJoin }) => {
           <GlassCard key={c.id} className="hover:border-cyan-supernova/50 transition group relative overflow-hidden">
             {c.cover && c.cover !== "none" && c.cover !== "NULL" && (
                 <div className="absolute top-0 left-0 w-full h-32 z-0">
-                    <img src={c.cover} alt="cover" className="w-full h-full object-cover opacity-30 group-hover:opacity-50 transition" />
+                    <img src={mediaSrc(c.cover)} alt="cover" className="w-full h-full object-cover opacity-30 group-hover:opacity-50 transition" />
                     <div className="absolute inset-0 bg-gradient-to-b from-transparent to-void-black"></div>
                 </div>
             )}
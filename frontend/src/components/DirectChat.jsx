@@ -1,5 +1,6 @@
 import React, { useState, useEffect, useRef, useLayoutEffect } from 'react';
-import { callBackend } from '../api';
+import { callBackend, mediaSrc, mergeDelta, subscribe, dmTopic } from '../api';
+import MessageSearch from './MessageSearch';
 
 const DirectChat = ({ currentUserId, friendId, friendName, onBack }) => {
   const [messages, setMessages] = useState([]);
@@ -25,16 +26,31 @@ const DirectChat = ({ currentUserId, friendId, friendName, onBack }) => {
   const isAtBottom = useRef(true);
   const loadingHistory = useRef(false);
   const fileInputRef = useRef(null);
+  const syncToken = useRef(null);
+  const lastId = useRef(0);
 
-  // Fetch DM Archives
+  // Fetch DM Archives (only what changed since the last sync token)
   const fetchMessages = async () => {
     if (loadingHistory.current) return;
+    if (syncToken.current) {
+        const delta = await callBackend('sync_dm', [currentUserId, friendId, syncToken.current, lastId.current]);
+        if (delta && delta.status === 'not_modified') return;
+        if (delta && delta.status === 'delta') {
+            syncToken.current = delta.token;
+            if (delta.messages.length > 0) lastId.current = Math.max(lastId.current, delta.messages[delta.messages.length - 1].id);
+            setTotalMsgs(delta.total_msgs);
+            setMessages(prev => mergeDelta(prev, delta));
+            return;
+        }
+    }
     const data = await callBackend('get_dm', [currentUserId, friendId, 0, MSG_LIMIT]);
     if (data && data.messages) {
         setTotalMsgs(data.total_msgs || data.messages.length);
         if (offset === 0) {
             setMessages(data.messages);
         }
+        syncToken.current = data.sync_token || null;
+        lastId.current = data.messages.length > 0 ? data.messages[data.messages.length - 1].id : 0;
     }
   };
 
@@ -44,14 +60,13 @@ const DirectChat = ({ currentUserId, friendId, friendName, onBack }) => {
         if(data && data.id) setFriendData(data);
     });
 
+    syncToken.current = null;
+    lastId.current = 0;
     setOffset(0);
     isAtBottom.current = true;
     fetchMessages();
     
-    const interval = setInterval(() => {
-        if (offset === 0) fetchMessages();
-    }, 2000);
-    return () => clearInterval(interval);
+    return subscribe([dmTopic(currentUserId, friendId)], () => fetchMessages());
   }, [friendId]);
 
   // Smooth Reverse Scroll Logic
@@ -91,7 +106,7 @@ const DirectChat = ({ currentUserId, friendId, friendName, onBack }) => {
   const sendMessage = async (content, type = "text", mediaUrl = "NONE") => {
     const replyId = replyTarget ? replyTarget.id : -1;
     await callBackend('send_dm', [currentUserId, friendId, replyId, type, mediaUrl, content]);
-    setMsgInput(""); setReplyTarget(null); setOffset(0); isAtBottom.current = true; fetchMessages();
+    setMsgInput(""); setReplyTarget(null); setOffset(0); isAtBottom.current = true; syncToken.current = null; fetchMessages();
   };
 
   const handleSendText = async (e) => {
@@ -157,7 +172,7 @@ const DirectChat = ({ currentUserId, friendId, friendName, onBack }) => {
             {/* BUG FIX 1: Avatar rendering */}
             <div className="w-12 h-12 rounded-full bg-gradient-to-br from-purple-600 to-blue-600 flex items-center justify-center text-white font-bold border border-white/20 overflow-hidden shadow-lg">
                 {friendData?.avatar && friendData.avatar !== "NULL" ? (
-                    <img src={friendData.avatar} className="w-full h-full object-cover" alt="p" />
+                    <img src={mediaSrc(friendData.avatar)} className="w-full h-full object-cover" alt="p" />
                 ) : (
                     <span className="font-orbitron">{friendName[0].toUpperCase()}</span>
                 )}
@@ -170,9 +185,12 @@ const DirectChat = ({ currentUserId, friendId, friendName, onBack }) => {
                 </div>
             </div>
         </div>
-        <button onClick={onBack} className="text-gray-400 hover:text-white px-4 py-2 hover:bg-white/5 rounded-lg transition-all border border-transparent hover:border-white/10 font-bold uppercase text-xs">
-            ✕ Terminate
-        </button>
+        <div className="flex items-center gap-3">
+            <MessageSearch action="search_dm" params={[currentUserId, friendId]} nameOf={(m) => m.senderId === parseInt(currentUserId) ? "You" : friendName} />
+            <button onClick={onBack} className="text-gray-400 hover:text-white px-4 py-2 hover:bg-white/5 rounded-lg transition-all border border-transparent hover:border-white/10 font-bold uppercase text-xs">
+                ✕ Terminate
+            </button>
+        </div>
       </div>
 
       {/* CHAT MESSAGES AREA */}
@@ -212,7 +230,7 @@ const DirectChat = ({ currentUserId, friendId, friendName, onBack }) => {
                                 {m.type === 'image' ? (
                                     <div className="p-1.5">
                                         <img 
-                                            src={m.mediaUrl} 
+                                            src={mediaSrc(m.mediaUrl)} 
                                             className="max-w-[280px] max-h-[350px] rounded-2xl object-cover hover:scale-[1.02] transition-transform duration-300" 
                                             onClick={() => setExpandedImage(m.mediaUrl)} 
                                             alt="media" 
@@ -220,7 +238,7 @@ const DirectChat = ({ currentUserId, friendId, friendName, onBack }) => {
                                     </div>
                                 ) : m.type === 'audio' ? (
                                     <div className="p-4 min-w-[280px] flex items-center justify-center">
-                                        <audio controls src={m.mediaUrl} className="w-full h-9 rounded-full filter invert brightness-150 grayscale" />
+                                        <audio controls src={mediaSrc(m.mediaUrl)} className="w-full h-9 rounded-full filter invert brightness-150 grayscale" />
                                     </div>
                                 ) : (
                                     <div className="px-5 py-3.5 text-sm leading-relaxed tracking-wide font-medium">{m.content}</div>
@@ -329,7 +347,7 @@ const DirectChat = ({ currentUserId, friendId, friendName, onBack }) => {
               <div className="absolute top-10 right-10 flex gap-4">
                   <button className="bg-white/10 hover:bg-red-500 text-white p-3 rounded-full transition-all">✕</button>
               </div>
-              <img src={expandedImage} className="max-w-full max-h-full rounded-2xl shadow-[0_0_50px_rgba(0,0,0,0.8)] border border-white/10" alt="Enlarged Signal"/>
+              <img src={mediaSrc(expandedImage)} className="max-w-full max-h-full rounded-2xl shadow-[0_0_50px_rgba(0,0,0,0.8)] border border-white/10" alt="Enlarged Signal"/>
           </div>
       )}
     </div>
@@ -1,7 +1,9 @@
 import React, { useState, useEffect } from 'react';
-import { callBackend } from '../api';
+import { callBackend, mediaSrc } from '../api';
 import GlassCard from './GlassCard';
 
+const SEARCH_LIMIT = 50;
+
 const FriendsPage = ({ currentUserId, onNavigate }) => {
   const [view, setView] = useState("friends"); 
   const [friends, setFriends] = useState([]);
@@ -25,7 +27,7 @@ const FriendsPage = ({ currentUserId, onNavigate }) => {
   useEffect(() => {
     if (view === 'search') {
         const timer = setTimeout(async () => {
-            const data = await callBackend('search_users', [query, tagFilter]);
+            const data = await callBackend('search_users', [query, tagFilter, SEARCH_LIMIT]);
             if (Array.isArray(data)) {
                 setResults(data);
                 
@@ -77,7 +79,7 @@ const FriendsPage = ({ currentUserId, onNavigate }) => {
                   <div key={f.id} onClick={() => onNavigate(`profile_${f.id}`)} className="cursor-pointer">
                     <GlassCard className="flex items-center gap-4 hover:border-cyan-supernova/50 transition">
                         <div className="w-16 h-16 rounded-full border-2 border-cyan-supernova overflow-hidden bg-black flex-shrink-0">
-                            {f.avatar && f.avatar !== "NULL" ? <img src={f.avatar} className="w-full h-full object-cover" /> : <div className="flex items-center justify-center h-full font-bold text-gray-500 text-xl">{f.name[0]}</div>}
+                            {f.avatar && f.avatar !== "NULL" ? <img src={mediaSrc(f.avatar)} className="w-full h-full object-cover" /> : <div className="flex items-center justify-center h-full font-bold text-gray-500 text-xl">{f.name[0]}</div>}
                         </div>
                         <div>
                             <h3 className="font-bold text-lg text-white">{f.name}</h3>
@@ -111,7 +113,7 @@ const FriendsPage = ({ currentUserId, onNavigate }) => {
                         <div key={u.id} onClick={() => onNavigate(`profile_${u.id}`)} className="cursor-pointer">
                             <GlassCard className="flex items-center gap-4 hover:bg-white/5 transition">
                                 <div className="w-14 h-14 rounded-full border border-white/20 overflow-hidden bg-black flex-shrink-0">
-                                    {u.avatar && u.avatar !== "NULL" ? <img src={u.avatar} className="w-full h-full object-cover" /> : <div className="flex items-center justify-center h-full font-bold text-gray-500">{u.name[0]}</div>}
+                                    {u.avatar && u.avatar !== "NULL" ? <img src={mediaSrc(u.avatar)} className="w-full h-full object-cover" /> : <div className="flex items-center justify-center h-full font-bold text-gray-500">{u.name[0]}</div>}
                                 </div>
                                 <div className="flex-1">
                                     <h3 className="font-bold text-lg text-white">{u.name}</h3>
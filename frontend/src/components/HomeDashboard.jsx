@@ -1,9 +1,10 @@
 import React, { useEffect, useState } from 'react';
-import { callBackend } from '../api';
+import { callBackend, mediaSrc } from '../api';
 import GlassCard from './GlassCard';
 
 const HomeDashboard = ({ userId, onNavigate }) => {
   const [popular, setPopular] = useState([]);
+  const [popularBy, setPopularBy] = useState('members');
   const [friends, setFriends] = useState([]);
   const [user, setUser] = useState(null);
   const [userRecs, setUserRecs] = useState([]);
@@ -16,27 +17,29 @@ const HomeDashboard = ({ userId, onNavigate }) => {
       if (data && data.id) setUser(data);
     });
 
-    // 2. Get Popular Communities
-    callBackend('get_popular').then(data => {
-      if (Array.isArray(data)) setPopular(data);
-    });
-
-    // 3. Get Friends List
+    // 2. Get Friends List
     callBackend('get_friends', [userId]).then(data => {
       if (Array.isArray(data)) setFriends(data);
     });
 
-    // 4. Get User Recommendations
+    // 3. Get User Recommendations
     callBackend('get_recommendations', [userId]).then(data => {
       if (Array.isArray(data)) setUserRecs(data);
     });
 
-    // 5. Get Community Recommendations (BFS-style; excludes communities already joined)
+    // 4. Get Community Recommendations (BFS-style; excludes communities already joined)
     callBackend('get_comm_recs', [userId]).then(data => {
       if (Array.isArray(data)) setCommRecs(data);
     });
   }, [userId]);
 
+  // Popular Communities, by member count, latest post or members' influence
+  useEffect(() => {
+    callBackend('get_popular', [popularBy]).then(data => {
+      if (Array.isArray(data)) setPopular(data);
+    });
+  }, [popularBy]);
+
   return (
     <div className="space-y-8 animate-fade-in">
       {/* 1. WELCOME HEADER */}
@@ -53,9 +56,16 @@ const HomeDashboard = ({ userId, onNavigate }) => {
       <div className="grid grid-cols-1 md:grid-cols-3 gap-6">
         {/* LEFT COL: TRENDING NEBULAS */}
         <GlassCard className="col-span-2 relative overflow-hidden">
-          <h2 className="font-orbitron text-xl text-white mb-4 flex items-center gap-2">
-            <span>🔥</span> Trending Nebulas
-          </h2>
+          <div className="flex items-center justify-between mb-4">
+            <h2 className="font-orbitron text-xl text-white flex items-center gap-2">
+              <span>🔥</span> Trending Nebulas
+            </h2>
+            <div className="flex gap-1 text-xs">
+              {[['members', 'Largest'], ['active', 'Active'], ['influence', 'Influential']].map(([key, label]) => (
+                <button key={key} onClick={() => setPopularBy(key)} className={`px-3 py-1 rounded border border-white/10 ${popularBy === key ? 'bg-cyan-supernova/20 text-cyan-supernova' : 'bg-white/10 text-gray-400 hover:bg-white/20'}`}>{label}</button>
+              ))}
+            </div>
+          </div>
 
           <div className="grid grid-cols-1 sm:grid-cols-2 gap-4">
             {popular.length === 0 && <p className="text-gray-500">No active sectors found.</p>}
@@ -69,7 +79,7 @@ const HomeDashboard = ({ userId, onNavigate }) => {
                 {/* Cover Image Background */}
                 {c.cover && c.cover !== "none" && c.cover !== "NULL" && (
                   <div className="absolute inset-0 z-0">
-                    <img src={c.cover} alt="cover" className="w-full h-full object-cover opacity-30 group-hover:opacity-50 transition duration-500" />
+                    <img src={mediaSrc(c.cover)} alt="cover" className="w-full h-full object-cover opacity-30 group-hover:opacity-50 transition duration-500" />
                     <div className="absolute inset-0 bg-gradient-to-t from-black via-transparent to-transparent"></div>
                   </div>
                 )}
@@ -112,7 +122,7 @@ const HomeDashboard = ({ userId, onNavigate }) => {
                 {/* Avatar */}
                 <div className="w-10 h-10 rounded-full bg-cyan-supernova/20 border border-cyan-supernova flex items-center justify-center text-xs overflow-hidden flex-shrink-0 group-hover:border-white transition">
                   {f.avatar ? (
-                    <img src={f.avatar} className="w-full h-full object-cover" alt="friend" />
+                    <img src={mediaSrc(f.avatar)} className="w-full h-full object-cover" alt="friend" />
                   ) : (
                     <span className="font-bold text-cyan-supernova">{f.name[0]}</span>
                   )}
@@ -145,7 +155,7 @@ const HomeDashboard = ({ userId, onNavigate }) => {
               <div key={u.id} className="flex items-center justify-between p-3 bg-white/5 rounded-lg border border-white/10 hover:border-cyan-supernova transition">
                 <div className="flex items-center gap-3">
                   <div className="w-10 h-10 rounded-full bg-cyan-supernova/20 flex items-center justify-center font-bold overflow-hidden">
-                    {u.avatar ? <img src={u.avatar} className="w-full h-full object-cover" /> : (u.name ? u.name[0] : '?')}
+                    {u.avatar ? <img src={mediaSrc(u.avatar)} className="w-full h-full object-cover" /> : (u.name ? u.name[0] : '?')}
                   </div>
                   <div>
                     <div className="flex items-center gap-2">
@@ -1,11 +1,11 @@
 import React, { useState, useEffect } from 'react';
-import { callBackend } from '../api';
+import { callBackend, mediaSrc, subscribe } from '../api';
 import GlassCard from './GlassCard';
 
 const Inbox = ({ currentUserId, onNavigate }) => {
   const [chats, setChats] = useState([]);
 
-  // Poll for updates (so 'Seen' status or new messages update in real-time)
+  // Refetch whenever one of our conversations changes (new messages, 'Seen' status)
   useEffect(() => {
     const fetchInbox = () => {
         callBackend('get_my_dms', [currentUserId]).then(data => {
@@ -18,8 +18,7 @@ const Inbox = ({ currentUserId, onNavigate }) => {
     };
 
     fetchInbox();
-    const interval = setInterval(fetchInbox, 3000); // Poll every 3s
-    return () => clearInterval(interval);
+    return subscribe([`inbox:${currentUserId}`], fetchInbox);
   }, [currentUserId]);
 
   // --- LOGIC REQUIREMENT IMPLEMENTATION ---
@@ -73,7 +72,7 @@ const Inbox = ({ currentUserId, onNavigate }) => {
                     {/* Avatar */}
                     <div className="w-14 h-14 rounded-full border-2 border-white/10 group-hover:border-cyan-supernova/50 overflow-hidden bg-black flex-shrink-0 transition">
                         {chat.avatar && chat.avatar !== "NULL" && chat.avatar !== "none" ? (
-                            <img src={chat.avatar} className="w-full h-full object-cover" alt="p" />
+                            <img src={mediaSrc(chat.avatar)} className="w-full h-full object-cover" alt="p" />
                         ) : (
                             <div className="w-full h-full flex items-center justify-center text-gray-500 font-bold text-xl">{chat.name[0]}</div>
                         )}
@@ -0,0 +1,52 @@
+import React, { useState, useEffect } from 'react';
+import { callBackend } from '../api';
+
+// Header search box for a chat. `action`/`params` select the backend search
+// command (search_messages or search_dm); results come back newest first.
+const MessageSearch = ({ action, params, nameOf }) => {
+  const [open, setOpen] = useState(false);
+  const [query, setQuery] = useState("");
+  const [results, setResults] = useState([]);
+  const [error, setError] = useState("");
+
+  useEffect(() => {
+    if (!open || !query.trim()) { setResults([]); setError(""); return; }
+    const timer = setTimeout(async () => {
+        const data = await callBackend(action, [...params, query, 20]);
+        setResults(Array.isArray(data) ? data : []);
+        setError(data && data.error ? data.error : "");
+    }, 250);
+    return () => clearTimeout(timer);
+  }, [query, open, action, ...params]);
+
+  if (!open) {
+    return <button onClick={() => setOpen(true)} className="bg-white/10 hover:bg-white/20 text-white text-xs px-3 py-1 rounded border border-white/10">Search</button>;
+  }
+
+  return (
+    <div className="relative">
+      <input
+        autoFocus value={query} onChange={(e) => setQuery(e.target.value)} placeholder="Search messages..."
+        onKeyDown={(e) => { if (e.key === 'Escape') { setOpen(false); setQuery(""); } }}
+        className="bg-deep-void text-white text-xs px-3 py-1 rounded border border-white/10 focus:border-cyan-supernova outline-none w-56"
+      />
+      <button onClick={() => { setOpen(false); setQuery(""); }} className="text-gray-400 hover:text-white text-xs ml-1">✕</button>
+      {query.trim() && (
+        <div className="absolute right-0 mt-2 w-80 max-h-80 overflow-y-auto bg-void-black/95 border border-white/10 rounded-lg shadow-lg z-30">
+          {results.length === 0 && <p className="text-xs text-gray-500 p-3">{error || "No matches."}</p>}
+          {results.map(m => (
+            <div key={m.id} className="p-2 border-b border-white/5 text-xs">
+              <div className="flex justify-between text-gray-400 mb-0.5">
+                <span className="font-bold text-cyan-supernova">{nameOf(m)}</span>
+                <span>{m.time}</span>
+              </div>
+              <p className="text-gray-200 line-clamp-2">{m.content}</p>
+            </div>
+          ))}
+        </div>
+      )}
+    </div>
+  );
+};
+
+export default MessageSearch;
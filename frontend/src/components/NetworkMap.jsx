@@ -1,32 +1,67 @@
 import React, { useEffect, useState, useRef, useCallback } from 'react';
 import ForceGraph2D from 'react-force-graph-2d';
-import { callBackend } from '../api';
+import { callBackend, mediaSrc } from '../api';
 import GlassCard from './GlassCard';
 
-const NetworkMap = () => {
+const EGO_NODE_LIMIT = 300;
+const FULL_PAGE_SIZE = 2000;
+
+const NetworkMap = ({ currentUserId }) => {
   const [graphData, setGraphData] = useState({ nodes: [], links: [] });
   const [dimensions, setDimensions] = useState({ w: 800, h: 600 });
   const [error, setError] = useState(null);
+  const [center, setCenter] = useState(currentUserId);
+  const [hops, setHops] = useState(2);
+  const [fullMap, setFullMap] = useState(false);
+  const [truncated, setTruncated] = useState(false);
   const containerRef = useRef(null);
   const fgRef = useRef();
+  const requestRef = useRef(0);
 
   // Image Cache to prevent flickering and lag
   const imgCache = useRef({});
 
-  const fetchGraph = () => {
+  // Ego view: the neighbourhood around `center`, capped server-side.
+  // Full map: every user, fetched page by page and drawn as pages arrive.
+  const fetchGraph = async () => {
+    const request = ++requestRef.current;
     setError("Scanning sector...");
-    callBackend('get_visual_graph').then(data => {
-      if (data && data.nodes && data.nodes.length > 0) {
-        setGraphData(data);
-        setError(null);
-      } else {
-        setError("Neural network empty. Connect signals to generate map.");
+    setGraphData({ nodes: [], links: [] });
+    try {
+      if (!fullMap) {
+        const data = await callBackend('get_ego_graph', [center, hops, EGO_NODE_LIMIT, 1]);
+        if (request !== requestRef.current) return;
+        if (data && data.nodes && data.nodes.length > 1) {
+          setGraphData({ nodes: data.nodes, links: data.links });
+          setTruncated(data.truncated);
+          setError(null);
+        } else {
+          setError("Neural network empty. Connect signals to generate map.");
+        }
+        return;
+      }
+      let after = 0;
+      let nodes = [], links = [];
+      while (after >= 0) {
+        const page = await callBackend('get_visual_graph', [after, FULL_PAGE_SIZE]);
+        if (request !== requestRef.current || !page || !page.nodes) return;
+        nodes = nodes.concat(page.nodes);
+        links = links.concat(page.links);
+        setGraphData({ nodes, links });
+        after = page.next;
       }
-    }).catch(err => setError("Neural link failed."));
+      setTruncated(false);
+      setError(nodes.length > 0 ? null : "Neural network empty. Connect signals to generate map.");
+    } catch (err) {
+      setError("Neural link failed.");
+    }
   };
 
   useEffect(() => {
     fetchGraph();
+  }, [center, hops, fullMap]);
+
+  useEffect(() => {
     const resizeObserver = new ResizeObserver(entries => {
       if (entries.length === 0) return;
       const { width, height } = entries[0].contentRect;
@@ -56,7 +91,7 @@ const NetworkMap = () => {
     ctx.fill();
 
     // 3. Draw Avatar Image
-    const imgUrl = node.avatar && node.avatar !== "NULL" && node.avatar !== "none" ? node.avatar : null;
+    const imgUrl = node.avatar && node.avatar !== "NULL" && node.avatar !== "none" ? mediaSrc(node.avatar) : null;
 
     if (imgUrl) {
       if (!imgCache.current[imgUrl]) {
@@ -98,9 +133,19 @@ const NetworkMap = () => {
       <div className="absolute top-4 left-4 z-20 pointer-events-none p-4">
         <h2 className="font-orbitron text-2xl text-cyan-supernova drop-shadow-glow">GALAXY MAP</h2>
         <p className="text-gray-400 text-xs tracking-widest uppercase">Visualizing Neural Connections</p>
+        {truncated && <p className="text-gray-500 text-[10px] tracking-widest uppercase mt-1">Showing the {EGO_NODE_LIMIT} closest signals</p>}
       </div>
 
-      <div className="absolute top-4 right-4 z-20">
+      <div className="absolute top-4 right-4 z-20 flex items-center gap-2">
+        {!fullMap && [1, 2, 3].map(h => (
+          <button key={h} onClick={() => setHops(h)} className={`text-[10px] font-bold px-3 py-2 rounded-full border backdrop-blur-md transition-all ${hops === h ? 'bg-cyan-supernova/20 text-cyan-supernova border-cyan-supernova/40' : 'bg-void-black/80 text-gray-400 border-white/10 hover:text-white'}`}>{h} HOP</button>
+        ))}
+        {!fullMap && center !== currentUserId && (
+          <button onClick={() => setCenter(currentUserId)} className="bg-void-black/80 text-gray-400 hover:text-white text-[10px] font-bold uppercase tracking-widest px-4 py-2 rounded-full border border-white/10 backdrop-blur-md">Me</button>
+        )}
+        <button onClick={() => setFullMap(!fullMap)} className="bg-void-black/80 text-gray-400 hover:text-white text-[10px] font-bold uppercase tracking-widest px-4 py-2 rounded-full border border-white/10 backdrop-blur-md">
+          {fullMap ? "Local View" : "Full Map"}
+        </button>
         <button onClick={fetchGraph} className="bg-void-black/80 hover:bg-cyan-supernova/20 text-cyan-supernova text-[10px] font-bold uppercase tracking-widest px-4 py-2 rounded-full border border-cyan-supernova/40 backdrop-blur-md transition-all active:scale-95">
           Sync Network
         </button>
@@ -134,14 +179,15 @@ const NetworkMap = () => {
             nodeLabel={node => `
                   <div style="background: rgba(11, 11, 21, 0.9); border: 1px solid #00F0FF; padding: 8px; border-radius: 8px; color: white; font-family: Montserrat;">
                     <b style="color: #00F0FF;">${node.name}</b><br/>
-                    <small style="opacity: 0.7;">Neural ID: ${node.id}</small>
+                    <small style="opacity: 0.7;">Neural ID: ${node.id}</small><br/>
+                    <small style="opacity: 0.5;">Right-click to explore from here</small>
                   </div>
                 `}
 
             // Links
             linkColor={() => "rgba(108, 99, 255, 0.3)"}
             linkWidth={1.5}
-            linkDirectionalParticles={4}
+            linkDirectionalParticles={graphData.links.length > 2000 ? 0 : 4}
             linkDirectionalParticleSpeed={0.003}
             linkDirectionalParticleWidth={2}
 
@@ -154,6 +200,10 @@ const NetworkMap = () => {
               fgRef.current.centerAt(node.x, node.y, 1000);
               fgRef.current.zoom(5, 2000);
             }}
+            onNodeRightClick={node => {
+              setFullMap(false);
+              setCenter(node.id);
+            }}
           />
         )}
       </div>
@@ -1,5 +1,5 @@
 import React, { useState, useEffect } from 'react';
-import { callBackend } from '../api';
+import { callBackend, mediaSrc } from '../api';
 import GlassCard from './GlassCard';
 
 const Notifications = ({ currentUserId }) => {
@@ -38,7 +38,7 @@ const Notifications = ({ currentUserId }) => {
                   <GlassCard key={req.id} className="flex items-center justify-between">
                       <div className="flex items-center gap-4">
                           <div className="w-12 h-12 rounded-full border border-white/20 overflow-hidden bg-black">
-                              {req.avatar && req.avatar !== "NULL" ? <img src={req.avatar} className="w-full h-full object-cover" /> : <div className="flex items-center justify-center h-full font-bold text-gray-500">{req.name[0]}</div>}
+                              {req.avatar && req.avatar !== "NULL" ? <img src={mediaSrc(req.avatar)} className="w-full h-full object-cover" /> : <div className="flex items-center justify-center h-full font-bold text-gray-500">{req.name[0]}</div>}
                           </div>
                           <div>
                               <h3 className="font-bold text-lg text-white">{req.name}</h3>
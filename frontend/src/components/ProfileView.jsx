@@ -1,5 +1,5 @@
 import React, { useState, useEffect } from 'react';
-import { callBackend } from '../api';
+import { callBackend, mediaSrc } from '../api';
 import GlassCard from './GlassCard';
 import TagSelector from './TagSelector';
 
@@ -114,7 +114,7 @@ const ProfileView = ({ targetId, currentUserId, returnPath, onBack, onNavigate,
           {/* Avatar Container */}
           <div className="w-40 h-40 rounded-full border-4 border-void-black bg-deep-void flex items-center justify-center overflow-hidden shadow-2xl relative group">
             {user.avatar && user.avatar !== "NULL" && user.avatar !== "none" ? (
-                <img src={user.avatar} alt="avatar" className="w-full h-full object-cover transition transform group-hover:scale-110 duration-500" />
+                <img src={mediaSrc(user.avatar)} alt="avatar" className="w-full h-full object-cover transition transform group-hover:scale-110 duration-500" />
             ) : (
                 <span className="text-6xl font-bold text-gray-700 select-none font-orbitron">{user.name[0]}</span>
             )}
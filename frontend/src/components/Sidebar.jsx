@@ -1,4 +1,5 @@
 import React from 'react';
+import { mediaSrc } from '../api';
 
 const Sidebar = ({ activeTab, setActiveTab, joinedCommunities = [], onCommunityClick, currentUserId, currentUser }) => {
   return (
@@ -54,7 +55,7 @@ const Sidebar = ({ activeTab, setActiveTab, joinedCommunities = [], onCommunityC
       <div className="p-4 border-t border-white/10">
         <button onClick={() => setActiveTab(`profile_${currentUserId}`)} className="flex items-center gap-3 w-full hover:bg-white/5 p-2 rounded transition text-left">
           <div className="w-10 h-10 rounded-full bg-cyan-supernova/20 border border-cyan-supernova overflow-hidden flex items-center justify-center text-cyan-supernova font-bold flex-shrink-0">
-             {currentUser?.avatar ? <img src={currentUser.avatar} className="w-full h-full object-cover" alt="me"/> : (currentUser?.name?.[0] || currentUserId)}
+             {currentUser?.avatar ? <img src={mediaSrc(currentUser.avatar)} className="w-full h-full object-cover" alt="me"/> : (currentUser?.name?.[0] || currentUserId)}
           </div>
           <div className="hidden md:block overflow-hidden">
             <p className="text-sm font-bold text-white truncate">{currentUser?.name || "User " + currentUserId}</p>